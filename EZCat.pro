@@ -17,6 +17,7 @@ QMAKE_CXXFLAGS += -Werror=return-type -Wextra -Wshadow -Wmissing-declarations -W
 # -Wconversion
 
 LIBS += -lblkid
+LIBS += -lsqlite3 -lz
 
 # The following define makes your compiler emit warnings if you use
 # any feature of Qt which has been marked as deprecated (the exact warnings
@@ -60,7 +61,35 @@ SOURCES += \
     dlgdirproperties.cpp \
     dlgabout.cpp \
     dlgaccessdenieds.cpp \
-    utils.cpp
+    utils.cpp \
+    reclaimer.cpp \
+    childloader.cpp \
+    reachabilitymonitor.cpp \
+    hasher.cpp \
+    dupfinder.cpp \
+    dupmodel.cpp \
+    dlgduplicates.cpp \
+    snapshot.cpp \
+    disktransfer.cpp \
+    catimage.cpp \
+    compactor.cpp \
+    backup.cpp \
+    progressestimator.cpp \
+    excluderules.cpp \
+    mounttable.cpp \
+    ratelimiter.cpp \
+    scanpriority.cpp \
+    dlgscanprogress.cpp \
+    sqlstatement.cpp \
+    dbpool.cpp \
+    taskscheduler.cpp \
+    jobspanel.cpp \
+    dbwriter.cpp \
+    diskstats.cpp \
+    statsbuilder.cpp \
+    largestfinder.cpp \
+    largestmodel.cpp \
+    dlglargest.cpp
 
 HEADERS += \
         mainwindow.h \
@@ -90,7 +119,36 @@ HEADERS += \
     dlgdirproperties.h \
     dlgabout.h \
     dlgaccessdenieds.h \
-    utils.h
+    utils.h \
+    reclaimer.h \
+    childloader.h \
+    reachabilitymonitor.h \
+    hasher.h \
+    dupfinder.h \
+    dupmodel.h \
+    dlgduplicates.h \
+    snapshot.h \
+    disktransfer.h \
+    catimage.h \
+    compactor.h \
+    backup.h \
+    progressestimator.h \
+    excluderules.h \
+    mounttable.h \
+    ratelimiter.h \
+    scanpriority.h \
+    dlgscanprogress.h \
+    sqlstatement.h \
+    dbtable.h \
+    dbpool.h \
+    taskscheduler.h \
+    jobspanel.h \
+    dbwriter.h \
+    diskstats.h \
+    statsbuilder.h \
+    largestfinder.h \
+    largestmodel.h \
+    dlglargest.h
 
 FORMS += \
         mainwindow.ui \
@@ -102,11 +160,15 @@ FORMS += \
     dlgdbinfo.ui \
     dlgdirproperties.ui \
     dlgabout.ui \
-    dlgaccessdenieds.ui
+    dlgaccessdenieds.ui \
+    dlgduplicates.ui \
+    dlgscanprogress.ui \
+    dlglargest.ui
 
 DISTFILES += \
     info.txt \
     db-schema.txt \
+    db-upgrade.txt \
     LICENCE.txt \
     ezcat.desktop \
     README.md
@@ -0,0 +1,196 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <sqlite3.h>
+#include <zlib.h>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+
+#include "backup.h"
+
+Backup::Backup(const QString& t_sourceFileName, const QString& t_destFileName)
+    : sourceFileName(t_sourceFileName), destFileName(t_destFileName)
+{
+}
+
+QString Backup::snapshotFileName(const QString& snapshotDir, const QString& dbFileName)
+{
+    return QDir(snapshotDir).filePath(QFileInfo(dbFileName).completeBaseName() + "-" +
+                                      QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + ".db.gz");
+}
+
+void Backup::pruneSnapshots(const QString& snapshotDir, const QString& dbFileName, int keep)
+{
+    // The time stamp in the name sorts oldest first
+    QStringList snapshots = QDir(snapshotDir).entryList(QStringList(QFileInfo(dbFileName).completeBaseName() + "-????????-??????.db.gz"),
+                                                        QDir::Files, QDir::Name);
+    for (int i = 0; i < (snapshots.size() - keep); i++)
+    {
+        QFile::remove(QDir(snapshotDir).filePath(snapshots[i]));
+    }
+}
+
+void Backup::abort()
+{
+    abortNow = true;
+}
+
+void Backup::go()
+{
+    emit finished(run());
+}
+
+bool Backup::run()
+{
+    // Writing the copy over the database itself would destroy it
+    QFileInfo sourceInfo(sourceFileName);
+    QFileInfo destInfo(destFileName);
+    if ((destInfo.absoluteFilePath() == sourceInfo.absoluteFilePath()) ||
+        (destInfo.exists() && (destInfo.canonicalFilePath() == sourceInfo.canonicalFilePath())))
+    {
+        qDebug() << "Backup: the destination" << destFileName << "is the database itself";
+        return false;
+    }
+
+    bool compressed = destFileName.endsWith(".gz");
+    QString pagesFileName = destFileName + ".part";
+    QString gzFileName = destFileName + ".gzpart";
+
+    QFile::remove(pagesFileName); // Left over from a backup that didn't finish
+    QFile::remove(gzFileName);
+
+    // Compressing takes the second half of the progress bar
+    bool ok = copyPages(pagesFileName, compressed ? 50 : 99);
+
+    if (ok && compressed)
+    {
+        ok = compress(pagesFileName, gzFileName);
+        QFile::remove(pagesFileName);
+        pagesFileName = gzFileName;
+    }
+
+    // Replaces an older backup of the same name only once this one is complete
+    if (ok) ok = (std::rename(QFile::encodeName(pagesFileName).constData(), QFile::encodeName(destFileName).constData()) == 0);
+    if (!ok) QFile::remove(pagesFileName);
+
+    if (!ok && !abortNow) qDebug() << "Backup: failed to back up" << sourceFileName << "to" << destFileName;
+    return ok;
+}
+
+bool Backup::copyPages(const QString& toFileName, int progressSpan)
+{
+    sqlite3* source = NULL;
+    sqlite3* dest = NULL;
+
+    // A failed open can still hand back a connection, which has to be closed. Closing NULL is fine
+    if (sqlite3_open_v2(QFile::encodeName(sourceFileName).constData(), &source, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+        sqlite3_close(source);
+        return false;
+    }
+
+    if (sqlite3_open_v2(QFile::encodeName(toFileName).constData(), &dest, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK)
+    {
+        sqlite3_close(source);
+        sqlite3_close(dest);
+        return false;
+    }
+
+    sqlite3_backup* backup = sqlite3_backup_init(dest, "main", source, "main");
+    if (!backup)
+    {
+        qDebug() << "Backup: init failed:" << sqlite3_errmsg(dest);
+        sqlite3_close(source);
+        sqlite3_close(dest);
+        return false;
+    }
+
+    // The read transaction is held on the source connection across all the steps, so every step
+    // copies from the same state of the database. In WAL mode that doesn't hold up writers, and
+    // their commits can't make the copy start again as they could if each step took its own
+    int rc = SQLITE_OK;
+    if ((sqlite3_exec(source, "begin", NULL, NULL, NULL) != SQLITE_OK) ||
+        (sqlite3_exec(source, "select count(*) from sqlite_master", NULL, NULL, NULL) != SQLITE_OK))
+    {
+        qDebug() << "Backup: could not start a read on the source:" << sqlite3_errmsg(source);
+        rc = SQLITE_ERROR;
+    }
+
+    emit progress(0);
+    while((rc == SQLITE_OK) && !abortNow)
+    {
+        rc = sqlite3_backup_step(backup, PAGES_PER_STEP);
+        if ((rc == SQLITE_BUSY) || (rc == SQLITE_LOCKED)) // The destination is in use, try again
+        {
+            QThread::msleep(BUSY_PAUSE_MS);
+            rc = SQLITE_OK;
+            continue;
+        }
+        if (rc != SQLITE_OK) break; // Done or failed
+
+        int pageCount = sqlite3_backup_pagecount(backup);
+        if (pageCount > 0) emit progress(static_cast<int>(static_cast<qint64>(pageCount - sqlite3_backup_remaining(backup)) * progressSpan / pageCount));
+        QThread::msleep(STEP_PAUSE_MS); // Leaves the disk to the rest of the app for a moment
+    }
+
+    if (sqlite3_backup_finish(backup) != SQLITE_OK) rc = SQLITE_ERROR;
+
+    // The copy keeps the source's journal mode. Make it a single file that can be opened read-only anywhere
+    if (rc == SQLITE_DONE)
+    {
+        if (sqlite3_exec(dest, "pragma journal_mode = delete", NULL, NULL, NULL) != SQLITE_OK) rc = SQLITE_ERROR;
+    }
+    else if (!abortNow)
+    {
+        qDebug() << "Backup: step failed:" << sqlite3_errstr(rc);
+    }
+
+    sqlite3_exec(source, "rollback", NULL, NULL, NULL);
+    sqlite3_close(source);
+    sqlite3_close(dest);
+    return (rc == SQLITE_DONE) && !abortNow;
+}
+
+bool Backup::compress(const QString& fromFileName, const QString& toFileName)
+{
+    QFile from(fromFileName);
+    if (!from.open(QIODevice::ReadOnly)) return false;
+
+    gzFile to = gzopen(QFile::encodeName(toFileName).constData(), "wb6");
+    if (!to) return false;
+
+    // The copy is the first half of the progress bar, this is the second
+    QByteArray buffer;
+    bool ok = true;
+    qint64 fromSize = from.size();
+    while(ok && !abortNow && !from.atEnd())
+    {
+        buffer = from.read(COMPRESS_CHUNK);
+        if (buffer.isEmpty()) { ok = false; break; }
+        ok = (gzwrite(to, buffer.constData(), static_cast<unsigned>(buffer.size())) == buffer.size());
+        if (fromSize > 0) emit progress(static_cast<int>(qMin(static_cast<qint64>(99), 50 + (from.pos() * 49 / fromSize))));
+    }
+
+    if (gzclose(to) != Z_OK) ok = false;
+    return ok && !abortNow;
+}
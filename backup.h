@@ -0,0 +1,77 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BACKUP_H
+#define BACKUP_H
+
+#include <QObject>
+#include <QString>
+
+/* Copies a live database with the SQLite online backup API, so it is safe to
+ * run while the app (or a Cataloguer) is writing. It opens its own read-only
+ * connection to the source and holds one read transaction on it while the pages
+ * are copied a few at a time, so the result is one consistent state of the
+ * database. The database is in WAL mode, so that read doesn't hold up writers,
+ * and nothing they commit meanwhile restarts the copy. An abort is seen between
+ * steps, and each step is followed by a short pause.
+ *
+ * The copy is finished as a standalone file (journal_mode = delete, so no WAL
+ * alongside). A destination ending in ".gz" is gzip compressed. Nothing is left
+ * at the destination unless the whole backup succeeds.
+ *
+ * Used from a worker thread by MainWindow (backups and scheduled snapshots) and
+ * directly by the --backup command line option.
+ */
+
+class Backup : public QObject
+{
+    Q_OBJECT
+
+public:
+    Backup(const QString& sourceFileName, const QString& destFileName);
+
+    static QString snapshotFileName(const QString& snapshotDir, const QString& dbFileName);
+    static void pruneSnapshots(const QString& snapshotDir, const QString& dbFileName, int keep);
+
+    const QString& getSourceFileName() const { return sourceFileName; }
+    const QString& getDestFileName() const { return destFileName; }
+    bool wasAborted() const { return abortNow; }
+    void abort();
+    bool run();
+
+public slots:
+    void go();
+
+signals:
+    void progress(int percent);
+    void finished(bool ok);
+
+private:
+    bool copyPages(const QString& toFileName, int progressSpan);
+    bool compress(const QString& fromFileName, const QString& toFileName);
+
+    QString sourceFileName;
+    QString destFileName;
+    bool abortNow = false;
+
+    const static int BUSY_PAUSE_MS = 250;
+    const static int PAGES_PER_STEP = 256;
+    const static int STEP_PAUSE_MS = 5;
+    const static int COMPRESS_CHUNK = 1024 * 1024;
+};
+
+#endif // BACKUP_H
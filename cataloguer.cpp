@@ -16,17 +16,64 @@
  */
 
 #include <blkid/blkid.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <algorithm>
 
+#include <QCryptographicHash>
 #include <QDateTime>
 #include <QDebug>
-#include <QDir>
+#include <QFile>
+#include <QHash>
 #include <QSqlQuery>
 
 #include "globals.h"
+#include "dbtable.h"
+#include "dbpool.h"
 #include "nodedisk.h"
+#include "hasher.h"
+#include "scanpriority.h"
+#include "dbwriter.h"
+#include "diskstats.h"
 
 #include "cataloguer.h"
 
+namespace
+{
+    // One child's contribution to its directory's digest
+    struct DigestEntry
+    {
+        QString name;
+        char kind;
+        qint64 size;
+        QByteArray digest; // Empty for files
+    };
+
+    /* A directory's digest is an MD5 over its children sorted by name. Each
+     * child contributes its name, kind and size, and a subdirectory its own
+     * digest as well, so two directories share a digest exactly when their
+     * subtrees have the same shape, names and file sizes. Timestamps and owners
+     * are left out so that copies of a tree still match.
+     */
+    QByteArray digestOf(QVector<DigestEntry>& entries)
+    {
+        std::sort(entries.begin(), entries.end(),
+                  [] (const DigestEntry& a, const DigestEntry& b) { return a.name < b.name; });
+
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        for (const DigestEntry& entry : entries)
+        {
+            hash.addData(entry.name.toUtf8());
+            hash.addData("\0", 1);
+            hash.addData(&entry.kind, 1);
+            hash.addData(QByteArray::number(entry.size));
+            hash.addData("\0", 1);
+            hash.addData(entry.digest);
+        }
+        return hash.result();
+    }
+}
+
 Cataloguer::Cataloguer(qint64 t_catID, const QString& t_newDiskName, const QString& t_newPath)
     : catID(t_catID), newDiskName(t_newDiskName), newPath(t_newPath), disk(NULL)
 {
@@ -39,6 +86,38 @@ Cataloguer::~Cataloguer()
 void Cataloguer::updateMode(NodeDisk* _disk)
 {
     disk = _disk;
+    updating = true;
+}
+
+void Cataloguer::hashMode(bool t_hashContents)
+{
+    hashContents = t_hashContents;
+}
+
+void Cataloguer::scanRules(const QString& t_excludes, int t_mountPolicy)
+{
+    excludesText = t_excludes;
+    mountPolicy = t_mountPolicy;
+}
+
+void Cataloguer::resumeMode(NodeDisk* t_disk)
+{
+    // Carry on from the disk's last checkpoint. The caller sets the same location and rules as before
+    disk = t_disk;
+    resuming = true;
+    updating = (disk->getUpdateID() != 0);
+}
+
+void Cataloguer::throttleMode(int t_priority, qint64 maxObjectsPerSec, qint64 maxBytesPerSec)
+{
+    priority = t_priority;
+    setLimits(maxObjectsPerSec, maxBytesPerSec);
+}
+
+void Cataloguer::setLimits(qint64 maxObjectsPerSec, qint64 maxBytesPerSec)
+{
+    objectLimiter.setRate(maxObjectsPerSec);
+    byteLimiter.setRate(maxBytesPerSec);
 }
 
 void Cataloguer::abort()
@@ -46,45 +125,74 @@ void Cataloguer::abort()
     abortNow = true;
 }
 
+/* The scan commits a checkpoint every CHECKPOINT_SECS, so stopping part way
+ * (cancel, an error, the device going away, a crash) only loses the work since
+ * the last one. Every directory recorded is either fully listed or still has
+ * its row in scanfrontier, and both change in the same transaction, so any
+ * committed state can be carried on from. The disk is marked partial until the
+ * scan completes. The indexes stay in place and are kept up as rows go in, so
+ * that other connections can go on using them between checkpoints. Directory
+ * sizes and digests need the whole subtree, so they are filled in at the end by
+ * finishDirectories().
+ *
+ * An update scans into a disks row of its own, marked deleted = 2 so that
+ * nothing else sees it, and checkpoints and resumes like a new disk. The disk
+ * keeps its old contents meanwhile, with updateid pointing at the new row. The
+ * last transaction swaps the two sets of directories over and tombstones the
+ * new row, which now holds the old contents, for the Reclaimer. The disk keeps
+ * its ID, so whatever refers to it, the remembered file hashes for one, stays
+ * valid. The disk object only takes the new details once that has committed.
+ */
 void Cataloguer::go()
 {
     try
     {
-        // Get a secondary database connection
-        cdb = new DB();
-        if (!cdb->initLib("cataloguer")) throw 5;
-        if (!cdb->openDB()) throw 6;
+        ScanPriority::applyToThisThread(priority); // The scheduler retires the thread after the scan, so no need to put it back
+
+        // This thread's own connection, it is closed when the thread ends
+        cdb = DBPool::connection();
+        if (!cdb) throw 6;
+
+        // The per entry statements go straight to sqlite3, the rest are few enough for QtSql
+        sqlite3* handle = cdb->getSQLiteHandle();
+        if (!handle) throw 7;
 
         QSqlQuery updateDiskQuery(cdb->getqdb());
         if (!updateDiskQuery.prepare("update disks set catid = :catid, name = :name, catpath = :catpath, cattime = :cattime, "
                                      "devname = :devname, fslabel = :fslabel, fstype = :fstype, fssize = :fssize, "
-                                     "fsfree = :fsfree, isroot = :isroot, uuid = :uuid where id = :id")) throw 10;
+                                     "fsfree = :fsfree, isroot = :isroot, uuid = :uuid, excludes = :excludes, "
+                                     "mountpolicy = :mountpolicy where id = :id")) throw 10;
 
-        numItemsQuery = new QSqlQuery(cdb->getqdb());
-        if (!numItemsQuery->prepare("update directories set numitems = :numitems where id = :dirid")) throw 20;
+        QSqlQuery scanStateQuery(cdb->getqdb());
+        if (!scanStateQuery.prepare("update disks set excludes = :excludes, mountpolicy = :mountpolicy, hashcontents = :hashcontents, "
+                                    "numdirs = 0, numfiles = 0, totalsize = 0, partial = 1, scanlast = null where id = :id")) throw 15;
 
-        dirQuery = new QSqlQuery(cdb->getqdb());
-        if (!dirQuery->prepare("insert into directories (diskid, parent, name, modtime, fowner, fgroup, qpermissions, accessdenied) "
-                                      "values (:diskid, :parent, :name, :modtime, :fowner, :fgroup, :qpermissions, :accessdenied)")) throw 30;
+        numItemsQuery = new SqlStatement();
+        if (!numItemsQuery->prepare(handle, "update directories set numitems = ?, digest = ?, totalsize = ? where id = ?")) throw 20;
 
-        fileQuery = new QSqlQuery(cdb->getqdb());
-        if (!fileQuery->prepare("insert into files (dirid, name, size, type, modtime, fowner, fgroup, qpermissions) "
-                                      "values (:dirid, :name, :size, :type, :modtime, :fowner, :fgroup, :qpermissions)")) throw 40;
+        dirQuery = new SqlStatement();
+        if (!dirQuery->prepare(handle, DBTable::insertSQL<DirectoriesTable>())) throw 30;
 
-        QSqlQuery otherQueries(cdb->getqdb());
+        fileQuery = new SqlStatement();
+        if (!fileQuery->prepare(handle, DBTable::insertSQL<FilesTable>())) throw 40;
 
-        if (!cdb->startTransaction())                                      throw 50;
+        frontierAddQuery = new SqlStatement();
+        if (!frontierAddQuery->prepare(handle, "insert into scanfrontier (dirid, diskid, relpath) values (?, ?, ?)")) throw 42;
 
-        if (!otherQueries.exec("drop index directories_diskid_idx"))       throw 60;
-        if (!otherQueries.exec("drop index directories_parent_idx"))       throw 70;
-        if (!otherQueries.exec("drop index files_dirid_idx"))              throw 80;
-        if (!otherQueries.exec("drop index directories_names_idx"))        throw 90;
+        frontierDoneQuery = new SqlStatement();
+        if (!frontierDoneQuery->prepare(handle, "delete from scanfrontier where dirid = ?")) throw 44;
 
-        QDir root(newPath);
-        rootStorageInfo = QStorageInfo(root);
+        QSqlQuery otherQueries(cdb->getqdb());
+
+        dbWriter.beginBulk(); // GUI edits are let in between checkpoints, see DBWriter
+        if (!cdb->startTransaction()) throw 50;
+
+        rootDir = QDir(newPath);
+        rootStorageInfo = QStorageInfo(rootDir);
 
         int isRoot = 0;
         if (newPath == rootStorageInfo.rootPath()) isRoot = 1;
+        qint64 timeNow = QDateTime::currentDateTime().toSecsSinceEpoch();
 
         QString blkid;
         blkid_cache bc;
@@ -98,11 +206,132 @@ void Cataloguer::go()
             qDebug() << "libblkid: blkid_get_cache fail";
         }
 
-        if (disk) // Updating a disk
+        // Compiled once here, then applied to every entry. The dialog has already checked the rules
+        excludes.compile(excludesText);
+        mounts.load(newPath);
+        canonicalRoot = rootDir.canonicalPath();
+        if (canonicalRoot == "/") canonicalRoot.clear(); // Paths below are built as canonicalRoot + "/" + relPath
+
+        struct stat rootStat;
+        if (::stat(QFile::encodeName(newPath).constData(), &rootStat) != 0) throw 135;
+
+        if (resuming)
+        {
+            // The scan's row and everything up to the last checkpoint are already in place
+            scanDiskID = updating ? disk->getUpdateID() : disk->getID();
+            if (!otherQueries.exec(QString("select numdirs, numfiles, totalsize, scanlast from disks where id = %1").arg(scanDiskID))
+                || !otherQueries.next()) throw 143;
+            totalDirs = otherQueries.value(0).toLongLong();
+            totalFiles = otherQueries.value(1).toLongLong();
+            totalSize = otherQueries.value(2).toLongLong();
+            numObjects = totalDirs + totalFiles;
+            lastDone = otherQueries.value(3).toString();
+            otherQueries.finish();
+            checkpointed = true;
+
+            if (!otherQueries.exec(QString("select id from directories where diskid = %1 and parent = 0").arg(scanDiskID))
+                || !otherQueries.next()) throw 140;
+            scanRootDirID = otherQueries.value(0).toLongLong();
+            otherQueries.finish();
+
+            // Devices are looked up again as each directory comes off the stack, the numbers can change between runs
+            if (!otherQueries.exec(QString("select dirid, relpath from scanfrontier where diskid = %1 order by dirid").arg(scanDiskID))) throw 145;
+            while (otherQueries.next()) pending.append({ otherQueries.value(0).toLongLong(), otherQueries.value(1).toString(), 0 });
+            otherQueries.finish();
+
+            emitEstimate(isRoot);
+        }
+        else
+        {
+            emitEstimate(isRoot);
+
+            if (updating)
+            {
+                // An earlier update that was never finished is given up
+                if (disk->getUpdateID() && !otherQueries.exec(QString("update disks set deleted = 1 where id = %1").arg(disk->getUpdateID()))) throw 100;
+
+                // The filesystem details are read again when the update finishes, only what a resume needs is kept here
+                QSqlQuery shadowQuery(cdb->getqdb());
+                if (!shadowQuery.prepare("insert into disks (catid, name, catpath, cattime, fssize, fsfree, deleted) "
+                                         "values (:catid, :name, :catpath, :cattime, 0, 0, 2)")) throw 105;
+                shadowQuery.bindValue(":catid", catID);
+                shadowQuery.bindValue(":name", newDiskName);
+                shadowQuery.bindValue(":catpath", newPath);
+                shadowQuery.bindValue(":cattime", timeNow);
+                if (!shadowQuery.exec()) throw 105;
+                scanDiskID = shadowQuery.lastInsertId().toLongLong();
+
+                if (!otherQueries.exec(QString("update disks set updateid = %1 where id = %2").arg(scanDiskID).arg(disk->getID()))) throw 110;
+            }
+            else
+            {
+                disk = NodeDisk::createDisk(otherQueries, catID, newDiskName, newPath, rootStorageInfo.device(), rootStorageInfo.name(),
+                                            rootStorageInfo.fileSystemType(), rootStorageInfo.bytesTotal(), rootStorageInfo.bytesFree(), isRoot, blkid);
+                if (!disk) throw 120;
+                scanDiskID = disk->getID();
+            }
+
+            // Saved at the start so that a resumed scan carries on with the same settings
+            scanStateQuery.bindValue(":excludes", excludesText.isEmpty() ? QVariant() : QVariant(excludesText));
+            scanStateQuery.bindValue(":mountpolicy", mountPolicy);
+            scanStateQuery.bindValue(":hashcontents", hashContents ? 1 : 0);
+            scanStateQuery.bindValue(":id", scanDiskID);
+            if (!scanStateQuery.exec()) throw 125;
+            if (!updating)
+            {
+                disk->setScanRules(excludesText, mountPolicy);
+                disk->setHashContents(hashContents);
+            }
+
+            // Make a root directory
+            QFileInfo rootDirInfo(newPath);
+            DirRecord rootRecord = { 0, 0, scanDiskID, 0, QString(), rootDirInfo.lastModified().toSecsSinceEpoch(),
+                                     rootDirInfo.owner(), rootDirInfo.group(), static_cast<int>(rootDirInfo.permissions()), 0 };
+            DBTable::bindRow<DirectoriesTable>(*dirQuery, rootRecord);
+            if (!dirQuery->exec()) throw 130;
+            scanRootDirID = dirQuery->lastInsertId();
+            if (!updating) disk->setRootDirID(scanRootDirID);
+            ++numObjects;
+            totalDirs = 1;
+
+            frontierAddQuery->bind(1, scanRootDirID);
+            frontierAddQuery->bind(2, scanDiskID);
+            frontierAddQuery->bind(3, QString("")); // Empty, not null, relpath is not null
+            if (!frontierAddQuery->exec()) throw 150;
+            pending.append({ scanRootDirID, QString(), static_cast<quint64>(rootStat.st_dev) });
+        }
+
+        // Depth first, the newest directory is taken next, which keeps the stack short
+        sinceCheckpoint.start();
+        while (!pending.isEmpty())
         {
-            if (!disk->removeContentsFromDBNT(otherQueries)) throw 100;
+            if (abortNow)
+            {
+                checkpoint();
+                throw 210;
+            }
+
+            ScanFrame frame = pending.takeLast();
+            scanDirectory(frame);
+
+            if (sinceCheckpoint.elapsed() >= (CHECKPOINT_SECS * 1000)) checkpoint();
+        }
+        emit numObjectsFound(numObjects, totalSize);
 
-            qint64 timeNow = QDateTime::currentDateTime().toSecsSinceEpoch();
+        // Finishing the directories reads the disk's rows once more
+        qint64 rowsDone = 0;
+        emit reindexing(totalDirs + totalFiles);
+        finishDirectories(rowsDone);
+
+        if (updating)
+        {
+            // The new directories (and so their files) go over to the disk, its old ones to the row the scan used.
+            // The statistics are swapped the same way, in two steps as a single update would collide on the key
+            QString swap = QString("case diskid when %1 then %2 else %1 end where diskid in (%1, %2)").arg(scanDiskID).arg(disk->getID());
+            if (!otherQueries.exec("update directories set diskid = " + swap))                                                 throw 246;
+            if (!otherQueries.exec(QString("delete from diskstats where diskid = %1").arg(disk->getID())))                     throw 246;
+            if (!otherQueries.exec(QString("update diskstats set diskid = %1 where diskid = %2").arg(disk->getID()).arg(scanDiskID))) throw 246;
+            if (!otherQueries.exec(QString("update scanfrontier set diskid = %1 where diskid = %2").arg(scanDiskID).arg(disk->getID()))) throw 246;
 
             updateDiskQuery.bindValue(":catid", catID);
             updateDiskQuery.bindValue(":name", newDiskName);
@@ -115,50 +344,52 @@ void Cataloguer::go()
             updateDiskQuery.bindValue(":fsfree", rootStorageInfo.bytesFree());
             updateDiskQuery.bindValue(":isroot", isRoot);
             updateDiskQuery.bindValue(":uuid", blkid);
+            updateDiskQuery.bindValue(":excludes", excludesText.isEmpty() ? QVariant() : QVariant(excludesText));
+            updateDiskQuery.bindValue(":mountpolicy", mountPolicy);
             updateDiskQuery.bindValue(":id", disk->getID());
-            if (!updateDiskQuery.exec()) throw 110;
+            if (!updateDiskQuery.exec())                                                                                       throw 247;
+
+            // Now holding the old contents
+            if (!otherQueries.exec(QString("update disks set deleted = 1 where id = %1").arg(scanDiskID)))                     throw 248;
+        }
+
+        // Keep the per-disk counters in step so that statistics never need to count the big tables
+        if (!otherQueries.exec(QString("update disks set numdirs = %1, numfiles = %2, totalsize = %3, hashcontents = %4, "
+                                       "partial = 0, scanlast = null, updateid = 0 where id = %5")
+                               .arg(totalDirs).arg(totalFiles).arg(totalSize).arg(hashContents ? 1 : 0).arg(disk->getID())))  throw 245;
+
+        if (!cdb->commitTransaction()) throw 290;
+        dbWriter.endBulk();
 
+        if (updating)
+        {
             disk->update(catID, newDiskName, newPath, timeNow, rootStorageInfo.device(), rootStorageInfo.name(),
                          rootStorageInfo.fileSystemType(), rootStorageInfo.bytesTotal(), rootStorageInfo.bytesFree(), isRoot, blkid);
+            disk->setScanRules(excludesText, mountPolicy);
+            disk->setRootDirID(scanRootDirID);
+            disk->setUpdateID(0);
         }
-        else
+        disk->setCounts(totalDirs, totalFiles, totalSize);
+        disk->setHashContents(hashContents);
+        disk->setPartial(false, QString());
+
+        // The catalogue is complete at this point. Hashing is extra, so failing or aborting it keeps the disk
+        if (hashContents && !abortNow)
         {
-            disk = NodeDisk::createDisk(otherQueries, catID, newDiskName, newPath, rootStorageInfo.device(), rootStorageInfo.name(),
-                                        rootStorageInfo.fileSystemType(), rootStorageInfo.bytesTotal(), rootStorageInfo.bytesFree(), isRoot, blkid);
-            if (!disk) throw 120;
+            Hasher hasher(cdb, disk->getID(), newPath, rootStorageInfo.device(), abortNow);
+            hasher.throttle(priority, &byteLimiter);
+            if (!hasher.run([&] (qint64 bytesDone, qint64 bytesTotal, qint64 bytesPerSec)
+                            { emit hashing(bytesDone, bytesTotal, bytesPerSec); }))
+            {
+                qDebug() << "Cataloguer: content hashing failed";
+            }
         }
 
-        // Make a root directory
-        QFileInfo rootDirInfo(newPath);
-        dirQuery->bindValue(":diskid", disk->getID());
-        dirQuery->bindValue(":parent", 0);
-        dirQuery->bindValue(":name", QVariant());
-        dirQuery->bindValue(":modtime", rootDirInfo.lastModified().toSecsSinceEpoch());
-        dirQuery->bindValue(":fowner", rootDirInfo.owner());
-        dirQuery->bindValue(":fgroup", rootDirInfo.group());
-        dirQuery->bindValue(":qpermissions", static_cast<int>(rootDirInfo.permissions()));
-        dirQuery->bindValue(":accessdenied", 0);
-        if (!dirQuery->exec()) throw 130;
-        if (!disk->loadRootDirID(otherQueries)) throw 140;
-        ++numObjects;
-
-        recurse(root, disk->getRootDirID());
-        emit numObjectsFound(numObjects);
-
-        emit reindexing();
-
-        if (!otherQueries.exec("create index directories_diskid_idx on directories(diskid)"))               throw 250;
-        if (!otherQueries.exec("create index directories_parent_idx on directories(parent)"))               throw 260;
-        if (!otherQueries.exec("create index files_dirid_idx on files(dirid)"))                             throw 270;
-        if (!otherQueries.exec("create index directories_names_idx on directories(name collate nocase)"))   throw 280;
-
-        if (!cdb->commitTransaction()) throw 290;
-        cdb->closeDB();
-
+        delete frontierDoneQuery;
+        delete frontierAddQuery;
         delete fileQuery;
         delete dirQuery;
         delete numItemsQuery;
-        delete cdb;
 
         emit finished(disk);
     }
@@ -166,59 +397,95 @@ void Cataloguer::go()
     {
         savedError = e;
         qDebug() << "Cataloguer error: " << e;
-        if      (e == 5) qDebug() << "Failed to get private DB connection";
-        else if (e == 6) qDebug() << "Open DB failed";
+        if      (e == 6) qDebug() << "Failed to get a DB connection";
+        else if (e == 7) qDebug() << "No SQLite handle for the connection";
         else if (e == 10) qDebug() << "Update disk query prepare failed";
+        else if (e == 15) qDebug() << "Scan state query prepare failed";
         else if (e == 20) qDebug() << "NumItems query prepare failed";
         else if (e == 30) qDebug() << "Directories query prepare failed";
         else if (e == 40) qDebug() << "Files query prepare failed";
+        else if (e == 42) qDebug() << "Frontier add query prepare failed";
+        else if (e == 44) qDebug() << "Frontier done query prepare failed";
         else if (e == 50) qDebug() << "Failed to start transaction";
-        else if (e == 60) qDebug() << "Drop index query A failed";
-        else if (e == 70) qDebug() << "Drop index query B failed";
-        else if (e == 80) qDebug() << "Drop index query C failed";
-        else if (e == 90) qDebug() << "Drop index query D failed";
-        else if (e == 100) qDebug() << "removeContentsFromDBNT failed";
-        else if (e == 110) qDebug() << "Update disk query exec failed";
+        else if (e == 100) qDebug() << "Give up earlier update query failed";
+        else if (e == 105) qDebug() << "Update scan disk query failed";
+        else if (e == 110) qDebug() << "Set update ID query failed";
         else if (e == 120) qDebug() << "NodeDisk::createDisk failed";
+        else if (e == 125) qDebug() << "Scan state query exec failed";
         else if (e == 130) qDebug() << "Root directory query exec failed";
-        else if (e == 140) qDebug() << "Disk::loadRootDirID failed";
-        else if (e == 200) qDebug() << "Recurse: NumItems query exec failed";
-        else if (e == 210) qDebug() << "Recurse: Cataloguing aborted";
-        else if (e == 220) qDebug() << "Recurse: Files query exec failed";
-        else if (e == 230) qDebug() << "Recurse: Directories query exec failed";
-        else if (e == 240) qDebug() << "Recurse: Files query (other) exec failed";
-        else if (e == 250) qDebug() << "Reindexing query A failed";
-        else if (e == 260) qDebug() << "Reindexing query B failed";
-        else if (e == 270) qDebug() << "Reindexing query C failed";
-        else if (e == 280) qDebug() << "Reindexing query D failed";
+        else if (e == 135) qDebug() << "Stat of the location failed";
+        else if (e == 140) qDebug() << "Load root directory query failed";
+        else if (e == 143) qDebug() << "Load scan state query failed";
+        else if (e == 145) qDebug() << "Load frontier query failed";
+        else if (e == 150) qDebug() << "Frontier add query (root) exec failed";
+        else if (e == 200) qDebug() << "Finish directories: NumItems query exec failed";
+        else if (e == 210) qDebug() << "Scan: Cataloguing aborted";
+        else if (e == 215) qDebug() << "Scan: Directory has gone away";
+        else if (e == 220) qDebug() << "Scan: Files query exec failed";
+        else if (e == 230) qDebug() << "Scan: Directories query exec failed";
+        else if (e == 240) qDebug() << "Scan: Files query (other) exec failed";
+        else if (e == 242) qDebug() << "Scan: Frontier add query exec failed";
+        else if (e == 244) qDebug() << "Scan: Frontier done query exec failed";
+        else if (e == 245) qDebug() << "Update disk counts query failed";
+        else if (e == 246) qDebug() << "Update swap query failed";
+        else if (e == 247) qDebug() << "Update disk query exec failed";
+        else if (e == 248) qDebug() << "Update tombstone query failed";
         else if (e == 290) qDebug() << "Commit transaction failed";
+        else if (e == 292) qDebug() << "Finish directories: directories query failed";
+        else if (e == 294) qDebug() << "Finish directories: files query failed";
+        else if (e == 296) qDebug() << "Finish directories: storing disk statistics failed";
+        else if (e == 300) qDebug() << "Checkpoint: disk query failed";
+        else if (e == 310) qDebug() << "Checkpoint: commit failed";
+        else if (e == 320) qDebug() << "Checkpoint: start transaction failed";
+
+        bool keepDisk = updating || resuming; // Neither loses what was committed before this run
 
         switch(e)
         {
+        case 320:
+        case 310:
+        case 300:
+        case 296:
+        case 294:
+        case 292:
         case 290:
-        case 280:
-        case 270:
-        case 260:
-        case 250:
+        case 248:
+        case 247:
+        case 246:
+        case 245:
+        case 244:
+        case 242:
         case 240:
         case 230:
         case 220:
+        case 215:
         case 210:
         case 200:
-            emit numObjectsFound(numObjects);
+            emit numObjectsFound(numObjects, totalSize);
             [[fallthrough]];
+        case 150:
+        case 145:
+        case 143:
         case 140:
+        case 135:
         case 130:
+        case 125:
         case 120:
         case 110:
+        case 105:
         case 100:
-        case 90:
-        case 80:
-        case 70:
-        case 60:
             cdb->rollbackTransaction();
+            if (checkpointed) keepDisk = true; // Back to the last checkpoint, what it saved is kept as a partial disk (or update)
             [[fallthrough]];
         case 50:
+            dbWriter.endBulk();
+            [[fallthrough]];
+        case 44:
+            delete frontierDoneQuery;
+            [[fallthrough]];
+        case 42:
+            delete frontierAddQuery;
+            [[fallthrough]];
         case 40:
             delete fileQuery;
             [[fallthrough]];
@@ -228,49 +495,106 @@ void Cataloguer::go()
         case 20:
             delete numItemsQuery;
             [[fallthrough]];
+        case 15:
         case 10:
-            cdb->closeDB();
-            [[fallthrough]];
+        case 7:
         case 6:
-        case 5:
-            delete cdb;
-            emit finished(NULL);
+            emit finished(keepDisk ? disk : NULL);
         }
     }
 }
 
-void Cataloguer::recurse(const QDir& dir, qint64 dirid) // throws int
+/* A rough size for the scan, so the progress dialog can show percent done and
+ * time left. Scanning a whole filesystem, the used inode and block counts are
+ * a good guess (the scan doesn't cross into other filesystems). Otherwise an
+ * update can go by what the disk held last time. Either may be 0 (unknown);
+ * btrfs and FAT, for example, report no inode counts. A resumed scan starts
+ * from what was found before.
+ */
+void Cataloguer::emitEstimate(int isRoot)
 {
-    subCheckStorageInfo.setPath(dir.absolutePath());
-    if (subCheckStorageInfo.device() != rootStorageInfo.device())
+    qint64 estObjects = 0;
+    qint64 estBytes = 0;
+
+    struct statvfs sv;
+    if (isRoot && (statvfs(QFile::encodeName(newPath).constData(), &sv) == 0))
     {
-        qDebug() << "DIFFERENT STORAGE INFO, SKIPPING";
-        qDebug() << subCheckStorageInfo.bytesTotal();
-        qDebug() << subCheckStorageInfo.bytesFree();
-        qDebug() << subCheckStorageInfo.device();
-        qDebug() << subCheckStorageInfo.displayName();
-        qDebug() << subCheckStorageInfo.fileSystemType();
-        qDebug() << subCheckStorageInfo.name();
-        qDebug() << subCheckStorageInfo.rootPath();
-        qDebug() << "return";
-        return;
+        if (sv.f_files > sv.f_ffree) estObjects = static_cast<qint64>(sv.f_files - sv.f_ffree);
+        estBytes = static_cast<qint64>((sv.f_blocks - sv.f_bfree) * sv.f_frsize);
     }
+    else if (disk && !resuming) // A partial disk's counts are no guide
+    {
+        estObjects = disk->getNumDirs() + disk->getNumFiles();
+        estBytes = disk->getTotalSize();
+    }
+
+    emit estimate(estObjects, estBytes, numObjects, totalSize);
+}
 
-    // get all entries in dir - insert all these into db. Foreach child dir, recurse
+void Cataloguer::checkpoint() // throws int
+{
+    QSqlQuery query(cdb->getqdb());
+    query.prepare("update disks set numdirs = :numdirs, numfiles = :numfiles, totalsize = :totalsize, scanlast = :scanlast where id = :id");
+    query.bindValue(":numdirs", totalDirs);
+    query.bindValue(":numfiles", totalFiles);
+    query.bindValue(":totalsize", totalSize);
+    query.bindValue(":scanlast", lastDone);
+    query.bindValue(":id", scanDiskID);
+    if (!query.exec()) throw 300;
+
+    if (!cdb->commitTransaction()) throw 310;
+    checkpointed = true;
+    if (updating)
+    {
+        disk->setUpdateID(scanDiskID); // Still showing its old contents, with an update to resume
+    }
+    else
+    {
+        disk->setCounts(totalDirs, totalFiles, totalSize);
+        disk->setPartial(true, lastDone);
+    }
 
-    QFileInfoList ql = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
-    totalDirs += ql.size();
+    // Any edits the GUI has queued are written here, between transactions
+    dbWriter.endBulk();
+    dbWriter.beginBulk();
 
-    numItemsQuery->bindValue(":numitems", ql.size());
-    numItemsQuery->bindValue(":dirid", dirid);
-    if (!numItemsQuery->exec()) throw 200;
+    if (!cdb->startTransaction()) throw 320;
+    sinceCheckpoint.restart();
+}
+
+/* Lists one directory: records its files, and its subdirectories, which go on
+ * the stack if the mount policy lets the scan into them. Excluded entries are
+ * left out altogether. Cancelling part way through a directory goes back to the
+ * last checkpoint, so a directory is always recorded whole.
+ */
+void Cataloguer::scanDirectory(ScanFrame& frame) // throws int
+{
+    QString dirPath = frame.relPath.isEmpty() ? newPath : rootDir.filePath(frame.relPath);
+    QFileInfoList ql = QDir(dirPath).entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+
+    // An empty listing may be a device that has been pulled out or unmounted,
+    // which mustn't be recorded as a run of empty directories
+    if (ql.isEmpty() || !frame.dev)
+    {
+        struct stat dirStat;
+        if (::stat(QFile::encodeName(dirPath).constData(), &dirStat) != 0) throw 215;
+        if (frame.dev && (frame.dev != static_cast<quint64>(dirStat.st_dev))) throw 215;
+        frame.dev = static_cast<quint64>(dirStat.st_dev);
+    }
 
     foreach(QFileInfo info, ql)
     {
         if (abortNow) throw 210;
+        objectLimiter.take(1);
+
+        QString childRelPath = frame.relPath.isEmpty() ? info.fileName() : (frame.relPath + "/" + info.fileName());
 
         if (info.isSymLink() || info.isFile())
         {
+            if (!excludes.isEmpty() && excludes.excludesFile(info.fileName(), childRelPath,
+                                                             info.isSymLink() ? 0 : info.size(),
+                                                             info.lastModified().toSecsSinceEpoch())) continue;
+
             char type;
             if (info.isSymLink()) type = TYPE_SYMLINK;
             else type = TYPE_FILE;
@@ -279,20 +603,18 @@ void Cataloguer::recurse(const QDir& dir, qint64 dirid) // throws int
             if (info.isSymLink()) size = 0;
             else size = info.size();
 
-            fileQuery->bindValue(":dirid", dirid);
-            fileQuery->bindValue(":name", info.fileName());
-            fileQuery->bindValue(":size", size);
-            fileQuery->bindValue(":type", type);
-            fileQuery->bindValue(":modtime", info.lastModified().toSecsSinceEpoch());
-            fileQuery->bindValue(":fowner", info.owner());
-            fileQuery->bindValue(":fgroup", info.group());
-            fileQuery->bindValue(":qpermissions", static_cast<int>(info.permissions()));
-
+            FileRecord record = { 0, frame.dirID, info.fileName(), size, type, info.lastModified().toSecsSinceEpoch(),
+                                  info.owner(), info.group(), static_cast<int>(info.permissions()) };
+            DBTable::bindRow<FilesTable>(*fileQuery, record);
             if (!fileQuery->exec()) throw 220;
-            if (++numObjects % 1000 == 0) emit numObjectsFound(numObjects);
+            ++totalFiles;
+            totalSize += size;
+            if (++numObjects % 1000 == 0) emit numObjectsFound(numObjects, totalSize);
         }
         else if (info.isDir())
         {
+            if (!excludes.isEmpty() && excludes.excludesDir(info.fileName(), childRelPath)) continue;
+
             int accessDenied = 0;
             if (!info.isReadable())
             {
@@ -300,35 +622,103 @@ void Cataloguer::recurse(const QDir& dir, qint64 dirid) // throws int
                 accessDeniedPaths.append(info.absoluteFilePath());
             }
 
-            dirQuery->bindValue(":diskid", disk->getID());
-            dirQuery->bindValue(":parent", dirid);
-            dirQuery->bindValue(":name", info.fileName());
-            dirQuery->bindValue(":modtime", info.lastModified().toSecsSinceEpoch());
-            dirQuery->bindValue(":fowner", info.owner());
-            dirQuery->bindValue(":fgroup", info.group());
-            dirQuery->bindValue(":qpermissions", static_cast<int>(info.permissions()));
-            dirQuery->bindValue(":accessdenied", accessDenied);
-
+            DirRecord record = { 0, 0, scanDiskID, frame.dirID, info.fileName(), info.lastModified().toSecsSinceEpoch(),
+                                 info.owner(), info.group(), static_cast<int>(info.permissions()), accessDenied };
+            DBTable::bindRow<DirectoriesTable>(*dirQuery, record);
             if (!dirQuery->exec()) throw 230;
-            if (++numObjects % 1000 == 0) emit numObjectsFound(numObjects);
+            ++totalDirs;
+            if (++numObjects % 1000 == 0) emit numObjectsFound(numObjects, totalSize);
 
-            qint64 newDirID = dirQuery->lastInsertId().toLongLong();
-            QDir childDir(info.absoluteFilePath());
-            recurse(childDir, newDirID);
+            // Directories on mounts the policy doesn't allow are recorded, but not entered
+            struct stat childStat;
+            if (    (::lstat(QFile::encodeName(info.absoluteFilePath()).constData(), &childStat) == 0)
+                 && mounts.mayEnter(canonicalRoot + "/" + childRelPath, static_cast<quint64>(childStat.st_dev), frame.dev, mountPolicy))
+            {
+                qint64 newDirID = dirQuery->lastInsertId();
+                frontierAddQuery->bind(1, newDirID);
+                frontierAddQuery->bind(2, scanDiskID);
+                frontierAddQuery->bind(3, childRelPath);
+                if (!frontierAddQuery->exec()) throw 242;
+                pending.append({ newDirID, childRelPath, static_cast<quint64>(childStat.st_dev) });
+            }
         }
         else // pipes, devices ...
         {
-            fileQuery->bindValue(":dirid", dirid);
-            fileQuery->bindValue(":name", info.fileName());
-            fileQuery->bindValue(":size", info.size());
-            fileQuery->bindValue(":type", TYPE_OTHERFILEUNKNOWN);
-            fileQuery->bindValue(":modtime", info.lastModified().toSecsSinceEpoch());
-            fileQuery->bindValue(":fowner", info.owner());
-            fileQuery->bindValue(":fgroup", info.group());
-            fileQuery->bindValue(":qpermissions", static_cast<int>(info.permissions()));
+            if (!excludes.isEmpty() && excludes.excludesFile(info.fileName(), childRelPath, info.size(),
+                                                             info.lastModified().toSecsSinceEpoch())) continue;
 
+            FileRecord record = { 0, frame.dirID, info.fileName(), info.size(), TYPE_OTHERFILEUNKNOWN, info.lastModified().toSecsSinceEpoch(),
+                                  info.owner(), info.group(), static_cast<int>(info.permissions()) };
+            DBTable::bindRow<FilesTable>(*fileQuery, record);
             if (!fileQuery->exec()) throw 240;
-            if (++numObjects % 1000 == 0) emit numObjectsFound(numObjects);
+            ++totalFiles;
+            totalSize += info.size();
+            if (++numObjects % 1000 == 0) emit numObjectsFound(numObjects, totalSize);
+        }
+    }
+
+    frontierDoneQuery->bind(1, frame.dirID);
+    if (!frontierDoneQuery->exec()) throw 244;
+    lastDone = frame.relPath;
+}
+
+/* Item counts, subtree sizes and digests all depend on everything below a
+ * directory, so they are filled in once the walk is over. A directory always
+ * gets a higher ID than its parent, so going through the disk's directories
+ * from the highest ID down reaches every child before its parent. The files
+ * are read in the same order alongside, one pass over each. The disk's
+ * statistics (see DiskStats) are tallied in the same pass.
+ */
+void Cataloguer::finishDirectories(qint64& rowsDone) // throws int
+{
+    SqlStatement dirs;
+    if (!dirs.prepare(cdb->getSQLiteHandle(), "select id, parent, name from directories where diskid = ? order by id desc")) throw 292;
+    dirs.bind(1, scanDiskID);
+
+    SqlStatement files;
+    if (!files.prepare(cdb->getSQLiteHandle(), "select f.dirid, f.name, f.type, f.size from directories d cross join files f on f.dirid = d.id "
+                                               "where d.diskid = ? order by d.id desc")) throw 294;
+    files.bind(1, scanDiskID);
+    bool haveFile = files.next();
+
+    QHash<qint64, QVector<DigestEntry>> waiting; // Finished subdirectories, by parent
+    DiskStats stats;
+    qint64 numDone = 0;
+    qint64 dirsDone = 0;
+
+    while (dirs.next())
+    {
+        qint64 dirID = dirs.int64(0);
+        QVector<DigestEntry> entries = waiting.take(dirID);
+
+        while (haveFile && (files.int64(0) == dirID))
+        {
+            entries.append({ files.text(1), static_cast<char>(files.integer(2)), files.int64(3), QByteArray() });
+            stats.addFile(entries.last().name, entries.last().kind, entries.last().size);
+            haveFile = files.next();
+            ++numDone;
         }
+
+        qint64 subtreeSize = 0;
+        for (const DigestEntry& entry : entries) subtreeSize += entry.size;
+        QByteArray digest = digestOf(entries);
+
+        numItemsQuery->bind(1, entries.size());
+        numItemsQuery->bind(2, digest);
+        numItemsQuery->bind(3, subtreeSize);
+        numItemsQuery->bind(4, dirID);
+        if (!numItemsQuery->exec()) throw 200;
+
+        qint64 parent = dirs.int64(1);
+        if (parent) waiting[parent].append({ dirs.text(2), TYPE_DIR, subtreeSize, digest });
+
+        ++numDone;
+        if (++dirsDone % 1000 == 0) emit reindexProgress(rowsDone + numDone);
     }
+    if (dirs.failed()) throw 292;
+    if (files.failed()) throw 294;
+    if (!stats.store(cdb->getSQLiteHandle(), scanDiskID)) throw 296;
+
+    rowsDone += numDone;
+    emit reindexProgress(rowsDone);
 }
@@ -18,15 +18,21 @@
 #ifndef CATALOGUER_H
 #define CATALOGUER_H
 
+#include <QDir>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QSqlQuery>
 #include <QStorageInfo>
+#include <QVector>
 
-class QDir;
 class QString;
 class NodeDisk;
+class SqlStatement;
 
 #include "db.h"
+#include "excluderules.h"
+#include "mounttable.h"
+#include "ratelimiter.h"
 
 class Cataloguer: public QObject
 {
@@ -37,17 +43,26 @@ public:
     ~Cataloguer();
 
     int getError() const { return savedError; }
+    bool isUpdate() const { return updating; }
     const QStringList& getAccessDeniedPaths() const { return accessDeniedPaths; }
 
     void updateMode(NodeDisk* disk);
+    void hashMode(bool hashContents);
+    void scanRules(const QString& excludes, int mountPolicy);
+    void resumeMode(NodeDisk* disk); // A partial disk, or one with an unfinished update
+    void throttleMode(int priority, qint64 maxObjectsPerSec, qint64 maxBytesPerSec); // 0 for no limit
+    void setLimits(qint64 maxObjectsPerSec, qint64 maxBytesPerSec); // Can be called while running
     void abort();
 
 public slots:
     void go();
 
 signals:
-    void numObjectsFound(qint64 numObjects);
-    void reindexing();
+    void estimate(qint64 numObjects, qint64 numBytes, qint64 objectsDone, qint64 bytesDone); // Either total may be 0, unknown
+    void numObjectsFound(qint64 numObjects, qint64 numBytes);
+    void reindexing(qint64 rowsToIndex);
+    void reindexProgress(qint64 rowsIndexed);
+    void hashing(qint64 bytesDone, qint64 bytesTotal, qint64 bytesPerSec);
     void finished(NodeDisk* disk);
 
 private:
@@ -55,20 +70,53 @@ private:
     QString newDiskName;
     QString newPath;
 
-    void recurse(const QDir& dir, qint64 dirID); // throws int
+    // A directory that has been recorded but not yet listed. Each one also has a row in scanfrontier
+    struct ScanFrame
+    {
+        qint64 dirID;
+        QString relPath;
+        quint64 dev; // 0 if not known yet
+    };
+
+    void scanDirectory(ScanFrame& frame); // throws int
+    void checkpoint(); // throws int
+    void finishDirectories(qint64& rowsDone); // throws int
+    void emitEstimate(int isRoot);
     DB* cdb;
     NodeDisk* disk;
+    qint64 scanDiskID = 0;  // The disks row the scan writes into. For an update, a hidden one of its own
+    qint64 scanRootDirID = 0;
+    bool updating = false;
+    bool resuming = false;
     qint64 totalDirs = 0;
     qint64 totalFiles = 0;
-    QSqlQuery* dirQuery;
-    QSqlQuery* fileQuery;
-    QSqlQuery* numItemsQuery;
+    qint64 totalSize = 0;
+    bool hashContents = false;
+    int priority = 0; // ScanPriority
+    RateLimiter objectLimiter;
+    RateLimiter byteLimiter; // Hashing
+    QString excludesText;
+    int mountPolicy = MountTable::POLICY_SAME_DEVICE;
+    ExcludeRules excludes;
+    MountTable mounts;
+    QDir rootDir;
+    QString canonicalRoot;
+    QVector<ScanFrame> pending;
+    QString lastDone;
+    QElapsedTimer sinceCheckpoint;
+    bool checkpointed = false;
+    SqlStatement* dirQuery;
+    SqlStatement* fileQuery;
+    SqlStatement* numItemsQuery;
+    SqlStatement* frontierAddQuery;
+    SqlStatement* frontierDoneQuery;
     QStorageInfo rootStorageInfo;
-    QStorageInfo subCheckStorageInfo;
     bool abortNow = false;
     qint64 numObjects = 0;
     int savedError = 0;
     QStringList accessDeniedPaths;
+
+    const static int CHECKPOINT_SECS = 30;
 };
 
 #endif // CATALOGUER_H
@@ -0,0 +1,402 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QHash>
+#include <QSaveFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryFile>
+#include <QVariant>
+#include <algorithm>
+#include <cstring>
+
+#include "globals.h"
+#include "db.h"
+#include "dbtable.h"
+#include "nodedir.h"
+
+#include "catimage.h"
+
+namespace
+{
+    const char IMAGE_MAGIC[8] = { 'E', 'Z', 'C', 'A', 'T', 'I', 'M', 'G' };
+    const quint32 IMAGE_VERSION = 2;
+
+    struct Header
+    {
+        char magic[8];
+        quint32 version;
+        quint32 reserved;
+        qint64 generation;
+        quint64 numDisks;
+        quint64 numDirs;
+        quint64 numFiles;
+        quint64 poolSize;       // QChars
+        quint64 disksOffset;
+        quint64 dirsOffset;
+        quint64 childrenOffset; // numDirs entries, so the section is padded to 8 bytes
+        quint64 filesOffset;
+        quint64 poolOffset;
+    };
+
+    // Appends strings to a temporary file that becomes the pool, sharing repeats such as owners
+    class PoolWriter
+    {
+    public:
+        bool open() { return temp.open(); }
+        QIODevice& device() { return temp; }
+        quint64 size() const { return numChars; }
+        bool overflowed() const { return numChars > 0xFFFFFFFF; } // Offsets past this don't fit a Str
+
+        CatImage::Str add(const QString& value)
+        {
+            CatImage::Str s { static_cast<quint32>(numChars), static_cast<quint32>(value.size()) };
+            if (value.size()) temp.write(reinterpret_cast<const char*>(value.constData()), value.size() * 2);
+            numChars += static_cast<quint64>(value.size());
+            return s;
+        }
+
+        CatImage::Str addShared(const QString& value)
+        {
+            auto i = shared.constFind(value);
+            if (i != shared.constEnd()) return i.value();
+            CatImage::Str s = add(value);
+            shared.insert(value, s);
+            return s;
+        }
+
+    private:
+        QTemporaryFile temp;
+        quint64 numChars = 0;
+        QHash<QString, CatImage::Str> shared;
+    };
+
+    template<typename T> bool writeArray(QIODevice& out, const QVector<T>& array)
+    {
+        qint64 bytes = static_cast<qint64>(array.size()) * static_cast<qint64>(sizeof(T));
+        return out.write(reinterpret_cast<const char*>(array.constData()), bytes) == bytes;
+    }
+
+    template<typename T> int findByID(const T* base, quint64 count, qint64 id)
+    {
+        const T* end = base + count;
+        const T* found = std::lower_bound(base, end, id, [] (const T& item, qint64 value) { return item.id < value; });
+        if ((found == end) || (found->id != id)) return -1;
+        return static_cast<int>(found - base);
+    }
+}
+
+QSharedPointer<const CatImage> CatImage::attached;
+qint64 CatImage::checkedAt = -1;
+
+CatImage::CatImage()
+{
+}
+
+CatImage::~CatImage()
+{
+    file.close(); // Unmaps
+}
+
+QString CatImage::fileNameFor(const QString& dbFileName)
+{
+    return dbFileName + ".img";
+}
+
+bool CatImage::open(const QString& fileName)
+{
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    quint64 size = static_cast<quint64>(file.size());
+    if (size < sizeof(Header)) return false;
+
+    uchar* map = file.map(0, file.size());
+    if (!map) return false;
+
+    const Header* header = reinterpret_cast<const Header*>(map);
+    if (memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) || (header->version != IMAGE_VERSION)) return false;
+
+    if ((header->disksOffset + header->numDisks * sizeof(Disk) > size) ||
+        (header->dirsOffset + header->numDirs * sizeof(Dir) > size) ||
+        (header->childrenOffset + header->numDirs * sizeof(quint32) > size) ||
+        (header->filesOffset + header->numFiles * sizeof(File) > size) ||
+        (header->poolOffset + header->poolSize * sizeof(QChar) > size) ||
+        (header->numDirs >= NO_PARENT) || (header->numFiles >= NO_PARENT))
+    {
+        qDebug() << "CatImage: image is truncated";
+        return false;
+    }
+
+    generation = header->generation;
+    numDisks = header->numDisks;
+    numDirs = header->numDirs;
+    disks = reinterpret_cast<const Disk*>(map + header->disksOffset);
+    dirs = reinterpret_cast<const Dir*>(map + header->dirsOffset);
+    children = reinterpret_cast<const quint32*>(map + header->childrenOffset);
+    files = reinterpret_cast<const File*>(map + header->filesOffset);
+    pool = reinterpret_cast<const QChar*>(map + header->poolOffset);
+    return true;
+}
+
+bool CatImage::build(DB& idb, const QString& imageFileName)
+{
+    QSqlDatabase& qdb = idb.getqdb();
+    QSaveFile out(imageFileName);
+    PoolWriter poolWriter;
+    if (!out.open(QIODevice::WriteOnly) || !poolWriter.open()) return false;
+
+    // One read transaction, so the rows match the generation read first
+    if (!qdb.transaction()) return false;
+    auto fail = [&] (const char* what) { qDebug() << "CatImage build:" << what; qdb.rollback(); return false; };
+
+    QSqlQuery query(qdb);
+    query.setForwardOnly(true);
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version = IMAGE_VERSION;
+
+    if (!query.exec("select gen from imagegen") || !query.next()) return fail("generation query");
+    header.generation = query.value(0).toLongLong();
+
+    QVector<Disk> disks;
+    if (!query.exec("select d.id, d.catid, d.name, d.catpath, ifnull(c.name, '') from disks as d "
+                    "left join catalogues as c on d.catid = c.id where d.deleted = 0 order by d.id")) return fail("disks query");
+    while (query.next())
+    {
+        disks.append({ query.value(0).toLongLong(), query.value(1).toLongLong(), poolWriter.add(query.value(2).toString()),
+                       poolWriter.add(query.value(3).toString()), poolWriter.addShared(query.value(4).toString()) });
+    }
+
+    // Directories and files are every row in the database, so they are read straight from sqlite3
+    SqlStatement rows;
+    QVector<Dir> dirs;
+    QVector<qint64> parentIDs;
+    if (!rows.prepare(idb.getSQLiteHandle(), "select d.id, d.numitems, " + DBTable::columnList<DirectoriesTable>("d.") +
+                                             " from directories as d join disks as k on d.diskid = k.id where k.deleted = 0 order by d.id"))
+        return fail("directories query");
+    DirRecord dirRecord;
+    while (rows.next())
+    {
+        dirRecord.id = rows.int64(0);
+        dirRecord.numItems = rows.int64(1);
+        DBTable::readRow<DirectoriesTable>(rows, dirRecord, 2);
+
+        Dir dir;
+        memset(&dir, 0, sizeof(dir));
+        dir.id = dirRecord.id;
+        dir.diskID = dirRecord.diskID;
+        dir.numItems = dirRecord.numItems;
+        dir.name = poolWriter.add(dirRecord.name);
+        dir.modTime = dirRecord.modTime;
+        dir.owner = poolWriter.addShared(dirRecord.owner);
+        dir.group = poolWriter.addShared(dirRecord.group);
+        dir.qPermissions = static_cast<quint32>(dirRecord.qPermissions);
+        dir.accessDenied = static_cast<quint32>(dirRecord.accessDenied);
+        dirs.append(dir);
+        parentIDs.append(dirRecord.parent);
+    }
+    if (rows.failed()) return fail("directories query");
+    if (static_cast<quint64>(dirs.size()) >= NO_PARENT) return fail("too many directories");
+
+    // Resolve parents to indexes
+    for (int i = 0; i < dirs.size(); i++)
+    {
+        dirs[i].parent = NO_PARENT;
+        if (parentIDs[i] == 0) continue;
+        int parentIndex = findByID(dirs.constData(), static_cast<quint64>(dirs.size()), parentIDs[i]);
+        if (parentIndex < 0) continue; // Orphan, leave it unreachable
+        dirs[i].parent = static_cast<quint32>(parentIndex);
+    }
+    parentIDs.clear();
+    parentIDs.squeeze();
+
+    // Group children by parent in name order, the same order the tree gets from the database.
+    // This walks directories_parent_idx alone, parents come out in id order so the groups follow the dirs array
+    QVector<quint32> children;
+    children.reserve(dirs.size());
+    if (!rows.prepare(idb.getSQLiteHandle(), "select id from directories indexed by directories_parent_idx "
+                                             "where parent > 0 order by parent, name collate nocase"))
+        return fail("directory order query");
+    while (rows.next())
+    {
+        int index = findByID(dirs.constData(), static_cast<quint64>(dirs.size()), rows.int64(0));
+        if ((index < 0) || (dirs[index].parent == NO_PARENT)) continue; // Deleted disk or orphan
+        children.append(static_cast<quint32>(index));
+    }
+    if (rows.failed()) return fail("directory order query");
+
+    for (int i = 0; i < children.size(); i++)
+    {
+        Dir& parent = dirs[dirs[children[i]].parent];
+        if (parent.numChildren == 0) parent.firstChild = static_cast<quint32>(i);
+        ++parent.numChildren;
+    }
+    while (children.size() % 2) children.append(0); // Keep the next section 8 byte aligned
+
+    // Files stream straight out, only the directories' ranges are kept
+    header.filesOffset = sizeof(Header);
+    if (!out.seek(static_cast<qint64>(header.filesOffset))) return fail("seek");
+
+    if (!rows.prepare(idb.getSQLiteHandle(), "select f.id, " + DBTable::columnList<FilesTable>("f.") +
+                                             " from files as f join directories as d on f.dirid = d.id join disks as k on d.diskid = k.id "
+                                             "where k.deleted = 0 order by f.dirid, f.id")) return fail("files query");
+
+    qint64 lastDirID = -1;
+    int dirIndex = -1;
+    FileRecord fileRecord;
+    while (rows.next())
+    {
+        fileRecord.id = rows.int64(0);
+        DBTable::readRow<FilesTable>(rows, fileRecord, 1);
+
+        qint64 dirID = fileRecord.dirID;
+        if (dirID != lastDirID)
+        {
+            dirIndex = findByID(dirs.constData(), static_cast<quint64>(dirs.size()), dirID);
+            lastDirID = dirID;
+            if (dirIndex >= 0) dirs[dirIndex].firstFile = static_cast<quint32>(header.numFiles);
+        }
+        if (dirIndex < 0) continue;
+        if (header.numFiles + 1 >= NO_PARENT) return fail("too many files");
+
+        File f;
+        memset(&f, 0, sizeof(f));
+        f.id = fileRecord.id;
+        f.dir = static_cast<quint32>(dirIndex);
+        f.name = poolWriter.add(fileRecord.name);
+        f.size = fileRecord.size;
+        f.type = fileRecord.type;
+        f.modTime = fileRecord.modTime;
+        f.owner = poolWriter.addShared(fileRecord.owner);
+        f.group = poolWriter.addShared(fileRecord.group);
+        f.qPermissions = static_cast<quint32>(fileRecord.qPermissions);
+        if (out.write(reinterpret_cast<const char*>(&f), sizeof(f)) != sizeof(f)) return fail("write");
+
+        ++dirs[dirIndex].numFiles;
+        ++header.numFiles;
+    }
+    if (rows.failed()) return fail("files query");
+    rows.finalize();
+    if (poolWriter.overflowed()) return fail("string pool too big");
+
+    qdb.commit();
+
+    header.numDisks = static_cast<quint64>(disks.size());
+    header.numDirs = static_cast<quint64>(dirs.size());
+    header.dirsOffset = header.filesOffset + header.numFiles * sizeof(File);
+    header.childrenOffset = header.dirsOffset + header.numDirs * sizeof(Dir);
+    header.disksOffset = header.childrenOffset + static_cast<quint64>(children.size()) * sizeof(quint32);
+    header.poolOffset = header.disksOffset + header.numDisks * sizeof(Disk);
+    header.poolSize = poolWriter.size();
+
+    if (!writeArray(out, dirs) || !writeArray(out, children) || !writeArray(out, disks)) return false;
+
+    QIODevice& poolDevice = poolWriter.device();
+    if (!poolDevice.seek(0)) return false;
+    while (!poolDevice.atEnd())
+    {
+        QByteArray chunk = poolDevice.read(1024 * 1024);
+        if (chunk.isEmpty() || (out.write(chunk) != chunk.size())) return false;
+    }
+
+    if (!out.seek(0)) return false;
+    if (out.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header)) return false;
+    return out.commit();
+}
+
+void CatImage::attach()
+{
+    detach();
+
+    CatImage* image = new CatImage();
+    if (!image->open(fileNameFor(DB::getFileName())))
+    {
+        delete image;
+        return;
+    }
+
+    attached = QSharedPointer<const CatImage>(image);
+    checkedAt = -1;
+    if (!current()) qDebug() << "CatImage: image is out of date, not using it";
+}
+
+void CatImage::detach()
+{
+    attached.clear();
+}
+
+QSharedPointer<const CatImage> CatImage::current()
+{
+    if (!attached) return attached;
+
+    // Nothing can have moved the generation on without a commit. Read the count first, a commit after it is seen next time
+    qint64 commits = DB::getCommitCount();
+    if ((commits >= 0) && (commits == checkedAt)) return attached;
+
+    QSqlQuery query;
+    if (!query.exec("select gen from imagegen") || !query.next() || (query.value(0).toLongLong() != attached->generation))
+        attached.clear(); // Holders of the old image keep it mapped until they let go
+    checkedAt = commits;
+
+    return attached;
+}
+
+int CatImage::findDir(qint64 dirID) const
+{
+    return findByID(dirs, numDirs, dirID);
+}
+
+const CatImage::Disk* CatImage::findDisk(qint64 diskID) const
+{
+    int index = findByID(disks, numDisks, diskID);
+    if (index < 0) return NULL;
+    return disks + index;
+}
+
+QString CatImage::diskPath(int dirIndex) const
+{
+    QVector<quint32> chain;
+    for (quint32 i = static_cast<quint32>(dirIndex); dirs[i].parent != NO_PARENT; i = dirs[i].parent) chain.append(i);
+
+    QString path;
+    path.reserve(1024);
+    for (auto i = chain.crbegin(); i != chain.crend(); ++i)
+    {
+        path.append("/");
+        path.append(pool + dirs[*i].name.offset, static_cast<int>(dirs[*i].name.length));
+    }
+    return path;
+}
+
+bool CatImage::dirChildren(qint64 parentDirID, QVector<DirRow>& rows) const
+{
+    int index = findDir(parentDirID);
+    if (index < 0) return false;
+
+    const Dir& parent = dirs[index];
+    rows.reserve(static_cast<int>(parent.numChildren));
+    for (quint32 i = 0; i < parent.numChildren; i++)
+    {
+        const Dir& child = dirs[children[parent.firstChild + i]];
+        rows.append({ child.id, string(child.name), child.accessDenied > 0, child.numChildren > 0 });
+    }
+    return true;
+}
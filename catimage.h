@@ -0,0 +1,138 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CATIMAGE_H
+#define CATIMAGE_H
+
+#include <QFile>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+struct DirRow;
+class DB;
+
+/* A read-only, memory mapped copy of the live catalogue for fast browsing.
+ *
+ * The image lives next to the database as <dbfile>.img and is built from it on
+ * request. It holds fixed size records, so lookups are array indexing and binary
+ * searches instead of SQL:
+ *   disks        sorted by id, with their catalogue's name
+ *   directories  sorted by id, each with its parent's index, a range in the
+ *                child index and a range in the file table
+ *   child index  directory indexes grouped by parent
+ *   files        sorted by (directory, id), so each directory's files are adjacent
+ *   string pool  UTF-16, referenced by (offset, length)
+ *
+ * Records use the machine's byte order; the image is a local cache, not an
+ * interchange format. It records the database generation it was built from.
+ * Triggers bump the generation on every change to disks or catalogues, and
+ * directory and file rows only change along with their disk. current() checks
+ * it, only after something has been committed, and drops an image that has gone
+ * stale. Callers then fall back to SQL.
+ */
+
+class CatImage
+{
+public:
+    struct Str
+    {
+        quint32 offset;     // In QChars from the start of the pool
+        quint32 length;
+    };
+
+    struct Disk
+    {
+        qint64 id;
+        qint64 catID;
+        Str name;
+        Str catPath;
+        Str catName;
+    };
+
+    struct Dir
+    {
+        qint64 id;
+        qint64 diskID;
+        qint64 modTime;
+        qint64 numItems;
+        quint32 parent;     // Index, NO_PARENT for a disk's root directory
+        quint32 firstChild; // Into the child index
+        quint32 numChildren;
+        quint32 firstFile;
+        quint32 numFiles;
+        quint32 qPermissions;
+        Str name;
+        Str owner;
+        Str group;
+        quint32 accessDenied;
+        quint32 reserved;
+    };
+
+    struct File
+    {
+        qint64 id;
+        qint64 size;
+        qint64 modTime;
+        quint32 dir;
+        qint32 type;
+        Str name;
+        Str owner;
+        Str group;
+        quint32 qPermissions;
+        quint32 reserved;
+    };
+
+    const static quint32 NO_PARENT = 0xFFFFFFFF;
+
+    ~CatImage();
+
+    static QString fileNameFor(const QString& dbFileName);
+    static bool build(DB& idb, const QString& imageFileName); // Any thread, on that thread's connection
+    static void attach();   // After the database opens. Loads the image if there is a current one
+    static void detach();   // Before the database closes
+    static QSharedPointer<const CatImage> current(); // GUI thread. NULL when there is no current image
+
+    int findDir(qint64 dirID) const;    // -1 if not in the image
+    const Disk* findDisk(qint64 diskID) const;
+    const Dir& dirAt(int index) const { return dirs[index]; }
+    const File& fileAt(quint32 index) const { return files[index]; }
+    quint32 childAt(quint32 position) const { return children[position]; }
+    QString string(const Str& s) const { return QString(pool + s.offset, static_cast<int>(s.length)); }
+    QString diskPath(int dirIndex) const; // "/a/b" for directory b, "" for a root directory
+    bool dirChildren(qint64 parentDirID, QVector<DirRow>& rows) const;
+    qint64 getGeneration() const { return generation; }
+
+private:
+    CatImage();
+    bool open(const QString& fileName);
+
+    QFile file;
+    qint64 generation = -1;
+    quint64 numDisks = 0;
+    quint64 numDirs = 0;
+    const Disk* disks = NULL;
+    const Dir* dirs = NULL;
+    const quint32* children = NULL;
+    const File* files = NULL;
+    const QChar* pool = NULL;
+
+    static QSharedPointer<const CatImage> attached;
+    static qint64 checkedAt; // DB::getCommitCount() when current() last asked for the generation
+};
+
+#endif // CATIMAGE_H
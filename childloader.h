@@ -0,0 +1,47 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHILDLOADER_H
+#define CHILDLOADER_H
+
+#include <QObject>
+#include <QVector>
+
+#include "nodedir.h"
+
+/* Loads the child directories of a tree node as an interactive scheduler job,
+ * on the lane thread's pooled connection, so that expanding big directories, or
+ * a database on slow storage, does not block the GUI. Owned by TreeModel, which
+ * matches results up by token. load() is called directly on the lane thread.
+ */
+
+class ChildLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    ChildLoader();
+    ~ChildLoader();
+
+    void load(quint64 token, qint64 parentDirID);
+
+signals:
+    void loaded(quint64 token, QVector<DirRow> rows);
+    void loadFailed(quint64 token);
+};
+
+#endif // CHILDLOADER_H
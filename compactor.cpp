@@ -0,0 +1,111 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <sqlite3.h>
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "db.h"
+#include "dbpool.h"
+
+#include "compactor.h"
+
+Compactor::Compactor(const QString& t_tempFileName)
+    : tempFileName(t_tempFileName)
+{
+}
+
+QString Compactor::tempFileNameFor(const QString& dbFileName)
+{
+    // Same directory, so the swap is a rename on one filesystem
+    return dbFileName + ".compact";
+}
+
+void Compactor::abort()
+{
+    abortNow = true;
+}
+
+void Compactor::go()
+{
+    bool ok = false;
+
+    cdb = DBPool::connection();
+    if (cdb) ok = compact();
+    DBPool::release(); // The copy is swapped in next, nothing may stay open on the old file
+    cdb = NULL;
+
+    if (!ok) QFile::remove(tempFileName);
+    emit finished(ok);
+}
+
+bool Compactor::compact()
+{
+    QSqlQuery query(cdb->getqdb());
+
+    qint64 values[3];
+    const char* pragmas[3] = { "pragma page_size", "pragma page_count", "pragma freelist_count" };
+    for (int i = 0; i < 3; i++)
+    {
+        if (!query.exec(pragmas[i]) || !query.next()) return false;
+        values[i] = query.value(0).toLongLong();
+    }
+    query.finish();
+
+    // The copy comes to roughly the pages in use
+    expectedBytes = (values[1] - values[2]) * values[0];
+    if (expectedBytes < 1) expectedBytes = 1;
+
+    QFile::remove(tempFileName); // Left over from a run that didn't finish
+
+    // Not applied to this file without a plain VACUUM, but VACUUM INTO builds the copy with it
+    if (!query.exec("pragma auto_vacuum = incremental")) return false;
+
+    sqlite3* handle = cdb->getSQLiteHandle();
+    if (handle) sqlite3_progress_handler(handle, PROGRESS_OPS, &Compactor::progressCallback, this);
+    else qDebug() << "Compactor: no SQLite handle, running without progress or cancel";
+
+    progressTimer.start();
+    query.prepare("vacuum into :file");
+    query.bindValue(":file", tempFileName);
+    bool ok = query.exec();
+    if (!ok && !abortNow) qDebug() << "Compactor: vacuum into failed:" << query.lastError().text();
+    query.finish();
+
+    if (handle) sqlite3_progress_handler(handle, 0, NULL, NULL);
+    return ok && !abortNow;
+}
+
+int Compactor::progressCallback(void* compactor)
+{
+    // Called by SQLite every PROGRESS_OPS virtual machine steps, on the compactor thread
+
+    Compactor* c = static_cast<Compactor*>(compactor);
+    if (c->abortNow) return 1; // Interrupts the vacuum
+
+    if (c->progressTimer.elapsed() >= PROGRESS_INTERVAL_MS)
+    {
+        c->progressTimer.restart();
+        qint64 percent = QFileInfo(c->tempFileName).size() * 100 / c->expectedBytes;
+        emit c->progress(static_cast<int>(qMin(percent, static_cast<qint64>(99)))); // 100 closes the progress dialog
+    }
+    return 0;
+}
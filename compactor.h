@@ -0,0 +1,72 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPACTOR_H
+#define COMPACTOR_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+
+class DB;
+
+/* Full compaction without taking the database away from everything else.
+ * Runs VACUUM INTO a temporary file next to the database, on its own
+ * connection and thread, so other connections can keep reading meanwhile.
+ * Progress is the size of the copy against the pages in use in the original.
+ * Cancelling interrupts the vacuum and removes the copy. The caller swaps the
+ * finished copy in (see MainWindow::compactionFinished) once every connection to
+ * the old file is closed.
+ *
+ * The copy is made with auto_vacuum = incremental, so from then on the
+ * Reclaimer can hand free pages back without another full compaction.
+ */
+
+class Compactor : public QObject
+{
+    Q_OBJECT
+
+public:
+    Compactor(const QString& tempFileName);
+
+    static QString tempFileNameFor(const QString& dbFileName);
+    const QString& getTempFileName() const { return tempFileName; }
+    bool wasAborted() const { return abortNow; }
+    void abort();
+
+public slots:
+    void go();
+
+signals:
+    void progress(int percent);
+    void finished(bool ok);
+
+private:
+    bool compact();
+    static int progressCallback(void* compactor);
+
+    QString tempFileName;
+    DB* cdb = NULL;
+    bool abortNow = false;
+    qint64 expectedBytes = 1;
+    QElapsedTimer progressTimer;
+
+    const static int PROGRESS_OPS = 10000;
+    const static int PROGRESS_INTERVAL_MS = 250;
+};
+
+#endif // COMPACTOR_H
@@ -15,17 +15,25 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <sqlite3.h>
+
+#include <QCoreApplication>
 #include <QDebug>
 #include <QFileInfo>
+#include <QProgressDialog>
 #include <QSqlDatabase>
+#include <QSqlDriver>
 #include <QSqlQuery>
 
 #include "globals.h"
 #include "utils.h"
+#include "dbpool.h"
 
 #include "db.h"
 
 QString DB::fileName;
+bool DB::readOnly = false;
+QAtomicInteger<qint64> DB::commits;
 
 DB::DB()
 {
@@ -78,6 +86,25 @@ QSqlDatabase& DB::getqdb()
     return *qdp;
 }
 
+// For the few things Qt doesn't wrap (progress handler, interrupt). The QSQLITE
+// plugin has to be built against the same system libsqlite3 that ezcat links
+sqlite3* DB::getSQLiteHandle()
+{
+    QVariant handle = qdp->driver()->handle();
+    if (!handle.isValid() || (qstrcmp(handle.typeName(), "sqlite3*") != 0)) return NULL;
+    return *static_cast<sqlite3* const*>(handle.constData());
+}
+
+const QVector<DBIndex>& DB::getIndexes()
+{
+    // Kept apart from db-schema.txt so a bulk load that takes them down puts back exactly these
+    static const QVector<DBIndex> indexes =
+    {
+#include "db-indexes.txt"
+    };
+    return indexes;
+}
+
 bool DB::openDB(const QString& _fileName)
 {
     if (dbIsOpen) return false;
@@ -90,7 +117,17 @@ bool DB::openDB(const QString& _fileName)
         return false;
     }
 
+    /* WAL needs to write the file and to make its -wal and -shm files beside it.
+     * A file on read-only media, or one the user may only read, still opens for
+     * browsing in whatever journal mode it already has. That is settled before
+     * anything is read, so nothing tries to write to it. The pool's connections
+     * follow, see the other openDB()
+     */
+    QFileInfo dirInfo(checkExists.absolutePath());
+    readOnly = !checkExists.isWritable() || !dirInfo.isWritable();
+
     qdp->setDatabaseName(fileName);
+    qdp->setConnectOptions(readOnly ? "QSQLITE_OPEN_READONLY" : QString());
 
     if (!qdp->open())
     {
@@ -98,13 +135,46 @@ bool DB::openDB(const QString& _fileName)
         return false;
     }
 
-    if (!checkDBContent())
+    int version = getDBVersion();
+    if ((version < 0) || (version > DB_VERSION))
     {
         qdp->close();
         Utils::errorMessageBox("Database not in expected format");
         return false;
     }
 
+    if (version < DB_VERSION)
+    {
+        if (readOnly)
+        {
+            qdp->close();
+            Utils::errorMessageBox("This database was made by an older version of EZ Cat and has to be upgraded before it can be opened, "
+                                   "but it can't be written to. Open it from a location where it can be written, or copy it somewhere that can.");
+            return false;
+        }
+
+        if (!upgradeDB(version))
+        {
+            qdp->close();
+            Utils::errorMessageBox("Failed to upgrade the database to this version of EZ Cat. The database has not been changed.");
+            return false;
+        }
+    }
+
+    // The file and folder can be written, but the file system may still not manage WAL
+    if (!readOnly && !setJournal())
+    {
+        qDebug() << "DB: WAL mode not available, opening read-only";
+        qdp->close();
+        qdp->setConnectOptions("QSQLITE_OPEN_READONLY");
+        if (!qdp->open())
+        {
+            Utils::errorMessageBox("Failed to open database");
+            return false;
+        }
+        readOnly = true;
+    }
+
     dbIsOpen = true;
     return true;
 }
@@ -114,6 +184,7 @@ bool DB::openDB() // Secondary connections. Uses stored static fileName
     if (dbIsOpen) return false;
 
     qdp->setDatabaseName(fileName);
+    if (readOnly) qdp->setConnectOptions("QSQLITE_OPEN_READONLY");
 
     if (!qdp->open())
     {
@@ -121,6 +192,10 @@ bool DB::openDB() // Secondary connections. Uses stored static fileName
         return false;
     }
 
+    QSqlQuery query(*qdp);
+    if (!readOnly && !query.exec("pragma synchronous = normal")) qDebug() << "DB: failed to set synchronous";
+    if (!readOnly) watchCommits();
+
     dbIsOpen = true;
     return true;
 }
@@ -130,7 +205,53 @@ void DB::closeDB()
     if (!dbIsOpen) return;
     dbIsOpen = false;
     qdp->close();
-    if (!secondary) fileName.clear();
+    if (!secondary)
+    {
+        fileName.clear();
+        DBPool::invalidate();
+    }
+}
+
+/* WAL lets the worker threads' connections read and write alongside the GUI's
+ * reads. The mode is kept in the file, so this only changes anything the first
+ * time an older database is opened. Synchronous is per connection; normal is
+ * safe with WAL, only the last commits can be lost to a power cut, not the file.
+ */
+bool DB::setJournal()
+{
+    QSqlQuery query(*qdp);
+    if (!query.exec("pragma journal_mode = wal") || !query.next()) return false;
+    if (query.value(0).toString().compare("wal", Qt::CaseInsensitive) != 0) return false;
+    query.finish();
+    if (!query.exec("pragma synchronous = normal")) return false;
+    watchCommits();
+    return true;
+}
+
+/* SQLite calls the WAL hook once a commit is in the log, on the connection that
+ * made it, autocommit statements included. Readers such as CatImage::current()
+ * compare getCommitCount() with the count they last saw instead of asking the
+ * database. Setting a hook takes the place of the automatic checkpoint, so
+ * walHook() does that job too, at SQLite's default of 1000 pages
+ */
+void DB::watchCommits()
+{
+    sqlite3* handle = getSQLiteHandle();
+    if (handle)
+    {
+        sqlite3_wal_hook(handle, &DB::walHook, NULL);
+        return;
+    }
+
+    qDebug() << "DB: no SQLite handle, commits are not counted";
+    commits.storeRelease(-1);
+}
+
+int DB::walHook(void*, sqlite3* handle, const char* dbName, int walPages)
+{
+    if (commits.loadAcquire() >= 0) commits.fetchAndAddOrdered(1);
+    if (walPages >= 1000) sqlite3_wal_checkpoint_v2(handle, dbName, SQLITE_CHECKPOINT_PASSIVE, NULL, NULL);
+    return SQLITE_OK;
 }
 
 bool DB::makeNewDB(const QString& newFileName)
@@ -162,6 +283,9 @@ bool DB::makeNewDB(const QString& newFileName)
 
     QSqlQuery query;
 
+    // Has to be set before the first table is created. Lets the Reclaimer hand free pages back a few at a time
+    query.exec("pragma auto_vacuum = incremental");
+
     for (qint64 i = 0; i < sql.size(); i++)
     {
         if (!query.exec(sql[i]))
@@ -172,23 +296,110 @@ bool DB::makeNewDB(const QString& newFileName)
         }
     }
 
+    for (const DBIndex& index : getIndexes())
+    {
+        if (!query.exec(QString("create index %1 on %2").arg(index.name, index.on)))
+        {
+            Utils::errorMessageBox("Failed to execute schema SQL");
+            closeDB();
+            return false;
+        }
+    }
+
     if (!query.exec(QString("INSERT INTO ezcat_db_version (version) values (%1)").arg(DB_VERSION)))
     {
         Utils::errorMessageBox("Database error");
         closeDB();
         return false;
     }
+
+    if (!setJournal())
+    {
+        Utils::errorMessageBox("Failed to put the database into WAL mode");
+        closeDB();
+        return false;
+    }
     return true;
 }
 
-bool DB::checkDBContent() const
+int DB::getDBVersion()
 {
     QSqlQuery query;
-    if (!query.exec("select * from ezcat_db_version")) return false;
-    if (!query.next()) return false;
-    int version = query.value(0).toInt();
-    if (version != DB_VERSION) return false;
-    return true;
+    if (!query.exec("select * from ezcat_db_version")) return -1;
+    if (!query.next()) return -1;
+    return query.value(0).toInt();
+}
+
+// Called by SQLite every PROGRESS_OPS virtual machine steps during an upgrade. User input
+// is left queued, as nothing else may use the database until the upgrade is done
+int DB::upgradeProgress(void*)
+{
+    QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+    return 0;
+}
+
+bool DB::upgradeDB(int fromVersion)
+{
+    // upgrades[n] takes the schema from version n to n + 1
+
+    QList<QList<const char*>> upgrades =
+    {
+#include "db-upgrade.txt"
+    };
+
+    Q_ASSERT(upgrades.size() == DB_VERSION);
+
+    if (!startTransaction()) return false;
+
+    /* Some steps rebuild indexes over every directory and file, which takes a while
+     * on a big catalogue. This runs inside openDB() on the GUI thread, so a dialog
+     * shows how far it has got, and SQLite's progress handler keeps it painted
+     */
+    int numSteps = 0;
+    for (int v = fromVersion; v < DB_VERSION; v++) numSteps += upgrades[v].size();
+
+    QProgressDialog progress("Upgrading database...", QString(), 0, numSteps);
+    progress.setWindowFlag(Qt::WindowContextHelpButtonHint, false);
+    progress.setWindowModality(Qt::ApplicationModal);
+    progress.setMinimumDuration(0);
+    progress.setValue(0);
+
+    sqlite3* handle = getSQLiteHandle();
+    if (handle) sqlite3_progress_handler(handle, PROGRESS_OPS, &DB::upgradeProgress, NULL);
+
+    QSqlQuery query;
+    int step = 0;
+    bool ok = true;
+
+    for (int v = fromVersion; ok && (v < DB_VERSION); v++)
+    {
+        for (const char* sql : upgrades[v])
+        {
+            if (!query.exec(sql))
+            {
+                qDebug() << "Upgrade to version" << (v + 1) << "failed:" << sql;
+                ok = false;
+                break;
+            }
+            progress.setValue(++step);
+        }
+    }
+
+    if (handle) sqlite3_progress_handler(handle, 0, NULL, NULL);
+
+    if (!ok)
+    {
+        rollbackTransaction();
+        return false;
+    }
+
+    if (!query.exec(QString("UPDATE ezcat_db_version SET version = %1").arg(DB_VERSION)))
+    {
+        rollbackTransaction();
+        return false;
+    }
+
+    return commitTransaction();
 }
 
 bool DB::startTransaction()
@@ -206,13 +417,6 @@ bool DB::rollbackTransaction()
     return qdp->rollback();
 }
 
-void DB::compact() const
-{
-    if (!dbIsOpen) return;
-    QSqlQuery query;
-    query.exec(QString("vacuum"));
-}
-
 qint64 DB::getFileSize() const
 {
     return QFile(fileName).size();
@@ -220,6 +424,8 @@ qint64 DB::getFileSize() const
 
 DBStats DB::getStats() const
 {
+    // Directory and file counts are maintained per disk, so this never has to count the big tables
+
     QSqlQuery query;
     struct DBStats dbstats;
     dbstats.size = getFileSize();
@@ -228,17 +434,27 @@ DBStats DB::getStats() const
     query.next();
     dbstats.numCats = query.value(0).toLongLong();
 
-    query.exec(QString("select count(*) from disks"));
+    query.exec(QString("select count(*), ifnull(sum(numdirs), 0), ifnull(sum(numfiles), 0) from disks where deleted = 0"));
     query.next();
     dbstats.numDisks = query.value(0).toLongLong();
+    dbstats.numDirs = query.value(1).toLongLong();
+    dbstats.numFiles = query.value(2).toLongLong();
+
+    query.exec(QString("pragma page_size"));
+    query.next();
+    dbstats.pageSize = query.value(0).toLongLong();
+
+    query.exec(QString("pragma page_count"));
+    query.next();
+    dbstats.pageCount = query.value(0).toLongLong();
 
-    query.exec(QString("select count(*) from directories"));
+    query.exec(QString("pragma freelist_count"));
     query.next();
-    dbstats.numDirs = query.value(0).toLongLong();
+    dbstats.freePages = query.value(0).toLongLong();
 
-    query.exec(QString("select count(*) from files"));
+    query.exec(QString("pragma auto_vacuum"));
     query.next();
-    dbstats.numFiles = query.value(0).toLongLong();
+    dbstats.autoVacuum = query.value(0).toInt();
 
     return dbstats;
 }
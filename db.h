@@ -18,7 +18,11 @@
 #ifndef DB_H
 #define DB_H
 
+#include <QAtomicInteger>
 #include <QSqlDatabase>
+#include <QVector>
+
+struct sqlite3;
 
 struct DBStats
 {
@@ -27,6 +31,16 @@ struct DBStats
     qint64 numDirs;
     qint64 numFiles;
     qint64 size;
+    qint64 pageSize;
+    qint64 pageCount;
+    qint64 freePages;
+    int autoVacuum; // 0 none, 1 full, 2 incremental
+};
+
+struct DBIndex
+{
+    const char* name;
+    const char* on; // table(columns)
 };
 
 class DB
@@ -37,9 +51,13 @@ public:
 
     bool getDBisOpen() const { return dbIsOpen; }
     static const QString& getFileName() { return fileName; }
+    static bool isReadOnly() { return readOnly; } // The file or its directory couldn't be written, see openDB()
+    static const QVector<DBIndex>& getIndexes(); // The secondary indexes on directories and files, see db-indexes.txt
+    static qint64 getCommitCount() { return commits.loadAcquire(); } // Goes up with each commit on any connection, -1 if it can't be told, see walHook()
 
     bool initLib(const QString& secondaryName = QString());
     QSqlDatabase& getqdb();
+    sqlite3* getSQLiteHandle();
 
     bool openDB(const QString& fileName);
     bool openDB(); // secondary connections
@@ -48,18 +66,26 @@ public:
     bool startTransaction();
     bool commitTransaction();
     bool rollbackTransaction();
-    void compact() const;
     DBStats getStats() const;
     qint64 getFileSize() const;
 
 private:
-    bool checkDBContent() const;
+    int getDBVersion(); // -1 if this isn't an EZ Cat database
+    bool setJournal();
+    void watchCommits();
+    static int walHook(void*, sqlite3* handle, const char* dbName, int walPages);
+    bool upgradeDB(int fromVersion);
+    static int upgradeProgress(void*);
 
     QSqlDatabase* qdp;
     bool secondary = false;
     bool dbIsOpen = false;
 
     static QString fileName; // static - share this between all instances
+    static bool readOnly;
+    static QAtomicInteger<qint64> commits;
+
+    const static int PROGRESS_OPS = 100000;
 };
 
 #endif // DB_H
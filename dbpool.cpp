@@ -0,0 +1,93 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QThread>
+#include <QThreadStorage>
+
+#include "globals.h"
+#include "db.h"
+
+#include "dbpool.h"
+
+namespace
+{
+    struct PooledConnection
+    {
+        DB* pdb = NULL;
+        int generation = 0;
+
+        ~PooledConnection()
+        {
+            if (!pdb) return;
+            pdb->closeDB();
+            delete pdb;
+        }
+    };
+
+    // Deleted, and so closed, by Qt as each thread finishes, on that thread
+    QThreadStorage<PooledConnection*> pooled;
+
+    QAtomicInt generation(0);
+    QAtomicInt nextConnection(0);
+}
+
+DB* DBPool::connection()
+{
+    if (QThread::currentThread() == QCoreApplication::instance()->thread())
+        return db.getDBisOpen() ? &db : NULL;
+
+    PooledConnection* pc = pooled.localData();
+    if (pc && (pc->generation != generation.load()))
+    {
+        pooled.setLocalData(NULL); // Deletes the stale one
+        pc = NULL;
+    }
+
+    if (!pc)
+    {
+        if (DB::getFileName().isEmpty()) return NULL;
+
+        DB* pdb = new DB();
+        if (!pdb->initLib(QString("pool%1").arg(nextConnection.fetchAndAddRelaxed(1))) || !pdb->openDB())
+        {
+            qDebug() << "DBPool: failed to open a connection";
+            delete pdb;
+            return NULL;
+        }
+
+        pc = new PooledConnection();
+        pc->pdb = pdb;
+        pc->generation = generation.load();
+        pooled.setLocalData(pc);
+    }
+
+    return pc->pdb;
+}
+
+void DBPool::release()
+{
+    if (QThread::currentThread() == QCoreApplication::instance()->thread()) return;
+    if (pooled.hasLocalData()) pooled.setLocalData(NULL);
+}
+
+void DBPool::invalidate()
+{
+    generation.ref();
+}
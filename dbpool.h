@@ -0,0 +1,51 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DBPOOL_H
+#define DBPOOL_H
+
+class DB;
+
+/* One database connection per thread. A QtSql connection may only be used by
+ * the thread that opened it, so code running in a worker thread takes its
+ * connection from here, and never uses the default connection (the global db),
+ * which belongs to the GUI thread. Asked from the GUI thread, this hands back
+ * the global db, so code that runs on either side can use it too.
+ *
+ * A worker thread's connection is opened the first time the thread asks and
+ * reused until the thread ends, when it is closed for it. Closing the database
+ * makes every pooled connection stale, and a stale one is reopened the next
+ * time its thread asks. release() closes the calling thread's connection
+ * straight away, for work that must leave nothing open on the file.
+ *
+ * The database is in WAL mode, so the connections don't hold each other up
+ * for reads, and a writer waits (Qt's busy timeout) for another writer
+ * rather than failing.
+ */
+
+class DBPool
+{
+public:
+    static DB* connection(); // NULL if no database is open or it can't be opened
+    static void release();
+    static void invalidate(); // By DB, when the database is closed
+
+private:
+    DBPool() {}
+};
+
+#endif // DBPOOL_H
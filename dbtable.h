@@ -0,0 +1,161 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DBTABLE_H
+#define DBTABLE_H
+
+#include <array>
+#include <tuple>
+#include <utility>
+
+#include <QByteArray>
+#include <QString>
+
+#include "sqlstatement.h"
+
+/* Compile time descriptions of the tables the scan writes and the browser
+ * reads in bulk. Each one pairs the column names with pointers to the members
+ * of a plain row struct, in the same order, and the templates below turn that
+ * into the column list, the insert statement and the code that binds or reads
+ * a whole row, with the types checked by the compiler.
+ *
+ * The id (and for directories, numitems, which is filled in after the scan)
+ * is in the row struct but not in the description, as it is never inserted.
+ * Readers that want it select it ahead of the described columns.
+ */
+
+struct FileRecord
+{
+    qint64 id;
+    qint64 dirID;
+    QString name;
+    qint64 size;
+    int type;
+    qint64 modTime;
+    QString owner;
+    QString group;
+    qint64 qPermissions;
+};
+
+struct DirRecord
+{
+    qint64 id;
+    qint64 numItems;
+    qint64 diskID;
+    qint64 parent;
+    QString name;
+    qint64 modTime;
+    QString owner;
+    QString group;
+    qint64 qPermissions;
+    int accessDenied;
+};
+
+struct FilesTable
+{
+    typedef FileRecord Row;
+    static const char* name() { return "files"; }
+    static constexpr std::array<const char*, 8> columns()
+    {
+        return {{ "dirid", "name", "size", "type", "modtime", "fowner", "fgroup", "qpermissions" }};
+    }
+    static constexpr auto fields()
+    {
+        return std::make_tuple(&Row::dirID, &Row::name, &Row::size, &Row::type, &Row::modTime,
+                               &Row::owner, &Row::group, &Row::qPermissions);
+    }
+};
+
+struct DirectoriesTable
+{
+    typedef DirRecord Row;
+    static const char* name() { return "directories"; }
+    static constexpr std::array<const char*, 8> columns()
+    {
+        return {{ "diskid", "parent", "name", "modtime", "fowner", "fgroup", "qpermissions", "accessdenied" }};
+    }
+    static constexpr auto fields()
+    {
+        return std::make_tuple(&Row::diskID, &Row::parent, &Row::name, &Row::modTime,
+                               &Row::owner, &Row::group, &Row::qPermissions, &Row::accessDenied);
+    }
+};
+
+namespace DBTable
+{
+    template <typename Table>
+    constexpr int numColumns()
+    {
+        static_assert(std::tuple_size<decltype(Table::fields())>::value == Table::columns().size(),
+                      "Table description has a different number of columns and fields");
+        return static_cast<int>(Table::columns().size());
+    }
+
+    // "dirid, name, ..." or with a prefix, "f.dirid, f.name, ..."
+    template <typename Table>
+    QByteArray columnList(const char* prefix = "")
+    {
+        QByteArray list;
+        for (const char* column : Table::columns())
+        {
+            if (!list.isEmpty()) list += ", ";
+            list += prefix;
+            list += column;
+        }
+        return list;
+    }
+
+    template <typename Table>
+    QByteArray insertSQL()
+    {
+        QByteArray params;
+        for (int i = 0; i < numColumns<Table>(); i++) params += (i ? ", ?" : "?");
+        return QByteArray("insert into ") + Table::name() + " (" + columnList<Table>() + ") values (" + params + ")";
+    }
+
+    template <typename Table, size_t... I>
+    void bindFields(SqlStatement& statement, const typename Table::Row& row, int firstParam, std::index_sequence<I...>)
+    {
+        auto fields = Table::fields();
+        int expand[] = { 0, (statement.bind(firstParam + static_cast<int>(I), row.*std::get<I>(fields)), 0)... };
+        (void)expand;
+    }
+
+    template <typename Table, size_t... I>
+    void readFields(const SqlStatement& statement, typename Table::Row& row, int firstColumn, std::index_sequence<I...>)
+    {
+        auto fields = Table::fields();
+        int expand[] = { 0, (statement.column(firstColumn + static_cast<int>(I), row.*std::get<I>(fields)), 0)... };
+        (void)expand;
+    }
+
+    // Binds the described columns to parameters firstParam onwards
+    template <typename Table>
+    void bindRow(SqlStatement& statement, const typename Table::Row& row, int firstParam = 1)
+    {
+        bindFields<Table>(statement, row, firstParam, std::make_index_sequence<numColumns<Table>()>());
+    }
+
+    // Reads the described columns from result column firstColumn onwards
+    template <typename Table>
+    void readRow(const SqlStatement& statement, typename Table::Row& row, int firstColumn = 0)
+    {
+        readFields<Table>(statement, row, firstColumn, std::make_index_sequence<numColumns<Table>()>());
+    }
+}
+
+#endif // DBTABLE_H
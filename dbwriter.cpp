@@ -0,0 +1,212 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QSqlQuery>
+#include <QVariant>
+
+#include "globals.h"
+#include "db.h"
+#include "dbpool.h"
+#include "taskscheduler.h"
+
+#include "dbwriter.h"
+
+DBWriter::Mutation DBWriter::renameDisk(qint64 diskID, const QString& newName)
+{
+    return { OP_RENAME_DISK, diskID, 0, newName, QString() };
+}
+
+DBWriter::Mutation DBWriter::moveDisk(qint64 diskID, qint64 newCatID)
+{
+    return { OP_MOVE_DISK, diskID, newCatID, QString(), QString() };
+}
+
+DBWriter::Mutation DBWriter::setDiskCommands(qint64 diskID, const QString& mountCommand, const QString& unmountCommand)
+{
+    return { OP_SET_DISK_COMMANDS, diskID, 0, mountCommand, unmountCommand };
+}
+
+DBWriter::Mutation DBWriter::deleteDisk(qint64 diskID)
+{
+    return { OP_DELETE_DISK, diskID, 0, QString(), QString() };
+}
+
+DBWriter::Mutation DBWriter::renameCatalogue(qint64 catID, const QString& newName)
+{
+    return { OP_RENAME_CATALOGUE, catID, 0, newName, QString() };
+}
+
+DBWriter::Mutation DBWriter::deleteCatalogue(qint64 catID)
+{
+    return { OP_DELETE_CATALOGUE, catID, 0, QString(), QString() };
+}
+
+QString DBWriter::describe(int op)
+{
+    switch(op)
+    {
+        case OP_RENAME_DISK:       return "rename the disk";
+        case OP_MOVE_DISK:         return "move the disk";
+        case OP_SET_DISK_COMMANDS: return "save the mount commands";
+        case OP_DELETE_DISK:       return "delete the disk";
+        case OP_RENAME_CATALOGUE:  return "rename the catalogue";
+        case OP_DELETE_CATALOGUE:  return "delete the catalogue";
+    }
+    return "save a change";
+}
+
+DBWriter::DBWriter()
+{
+}
+
+quint64 DBWriter::submit(const Mutation& mutation)
+{
+    QMutexLocker locker(&mutex);
+    quint64 ticket = nextTicket++;
+    pending.append(qMakePair(ticket, mutation));
+    if (batchQueued) return ticket; // Goes in with the batch already waiting
+
+    batchQueued = true;
+    locker.unlock();
+    lastJob = scheduler.submit(TaskScheduler::LANE_WRITE, [this] (TaskScheduler::Job&) { writeBatch(); });
+    return ticket;
+}
+
+// Waits until everything submitted so far has been written. For before the database is closed or copied
+void DBWriter::flush()
+{
+    scheduler.wait(lastJob);
+}
+
+void DBWriter::beginBulk()
+{
+    QMutexLocker locker(&mutex);
+    while (writerWaiting || bulkOpen) gateChanged.wait(&mutex);
+    bulkOpen = true;
+}
+
+void DBWriter::endBulk()
+{
+    QMutexLocker locker(&mutex);
+    bulkOpen = false;
+    gateChanged.wakeAll();
+}
+
+// Runs on the write lane
+void DBWriter::writeBatch()
+{
+    QMutexLocker locker(&mutex);
+    writerWaiting = true;
+    while (bulkOpen) gateChanged.wait(&mutex);
+
+    // Taken only now, so anything submitted while waiting for the gate comes too
+    Batch batch = pending;
+    pending.clear();
+    batchQueued = false;
+    locker.unlock();
+
+    DB* wdb = DBPool::connection();
+    bool together = wdb && writeTogether(wdb, batch);
+    QList<bool> results;
+    for (const QPair<quint64, Mutation>& m : batch)
+    {
+        bool ok = together;
+        if (!together && wdb && (batch.size() > 1)) ok = writeTogether(wdb, Batch() << m);
+        results.append(ok);
+    }
+
+    locker.relock();
+    writerWaiting = false;
+    gateChanged.wakeAll();
+    locker.unlock();
+
+    for (int i = 0; i < batch.size(); i++)
+    {
+        if (!results[i]) qDebug() << "DBWriter: failed to" << describe(batch[i].second.op);
+        emit finished(batch[i].first, batch[i].second.op, batch[i].second.id, results[i]);
+    }
+}
+
+bool DBWriter::writeTogether(DB* wdb, const Batch& batch)
+{
+    if (!wdb->startTransaction()) return false;
+
+    QSqlQuery query(wdb->getqdb());
+    for (const QPair<quint64, Mutation>& m : batch)
+    {
+        if (!apply(query, m.second))
+        {
+            wdb->rollbackTransaction();
+            return false;
+        }
+    }
+
+    if (!wdb->commitTransaction())
+    {
+        wdb->rollbackTransaction();
+        return false;
+    }
+    return true;
+}
+
+bool DBWriter::apply(QSqlQuery& query, const Mutation& mutation)
+{
+    switch(mutation.op)
+    {
+        case OP_RENAME_DISK:
+            query.prepare("update disks set name = :name where id = :id");
+            query.bindValue(":name", mutation.text);
+            break;
+
+        case OP_MOVE_DISK:
+            query.prepare("update disks set catid = :catid where id = :id");
+            query.bindValue(":catid", mutation.number);
+            break;
+
+        case OP_SET_DISK_COMMANDS:
+            query.prepare("update disks set mountcmd = :mcom, umountcmd = :umcom where id = :id");
+            query.bindValue(":mcom", mutation.text);
+            query.bindValue(":umcom", mutation.text2);
+            break;
+
+        case OP_DELETE_DISK:
+            // Only tombstones the disk, and any unfinished update of it. The Reclaimer removes their directories and files later
+            if (!query.exec(QString("update disks set deleted = 1 where deleted = 2 and id in (select updateid from disks where id = %1)")
+                            .arg(mutation.id))) return false;
+            query.prepare("update disks set deleted = 1 where id = :id");
+            break;
+
+        case OP_RENAME_CATALOGUE:
+            query.prepare("update catalogues set name = :name where id = :id");
+            query.bindValue(":name", mutation.text);
+            break;
+
+        case OP_DELETE_CATALOGUE:
+            // Tombstones the catalogue's disks, then the catalogue row itself can go
+            if (!query.exec(QString("update disks set deleted = 1 where deleted = 2 and id in (select updateid from disks where catid = %1)")
+                            .arg(mutation.id))) return false;
+            if (!query.exec(QString("update disks set deleted = 1 where catid = %1").arg(mutation.id))) return false;
+            query.prepare("delete from catalogues where id = :id");
+            break;
+    }
+
+    query.bindValue(":id", mutation.id);
+    return query.exec();
+}
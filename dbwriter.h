@@ -0,0 +1,111 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DBWRITER_H
+#define DBWRITER_H
+
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QWaitCondition>
+
+class DB;
+class QSqlQuery;
+
+/* The GUI's edits to the catalogue - renames, moves, mount commands, deletes -
+ * go through here rather than being written on the GUI thread's connection.
+ * Each is a Mutation. They are queued and written on the scheduler's single
+ * LANE_WRITE thread, all that have built up going in one transaction. The node
+ * is changed in memory straight away, so the edit looks instant. finished() comes
+ * back later with the ticket submit() gave out. If a batch fails, its mutations
+ * are tried again one at a time so that one bad one doesn't take the rest with it,
+ * and MainWindow puts the node of any that still fail back as the database has it.
+ *
+ * A long writer (the Cataloguer, the Hasher, the StatsBuilder) calls beginBulk()
+ * before each of its transactions and endBulk() after. A batch waits for
+ * endBulk(), and the next beginBulk() waits for the batch or another long
+ * writer, so writers take turns instead of fighting over SQLite's write lock
+ * and running into its busy timeout. The scan dialog is modal, so during a
+ * scan this only lets in edits that were queued before it started.
+ *
+ * submit() and flush() are for the GUI thread. Creating new rows, which needs
+ * the new ID back at once, is still done directly.
+ */
+
+class DBWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Op
+    {
+        OP_RENAME_DISK,
+        OP_MOVE_DISK,
+        OP_SET_DISK_COMMANDS,
+        OP_DELETE_DISK,
+        OP_RENAME_CATALOGUE,
+        OP_DELETE_CATALOGUE
+    };
+
+    struct Mutation
+    {
+        Op op;
+        qint64 id;      // Of the disk or catalogue
+        qint64 number;  // OP_MOVE_DISK: the new catalogue
+        QString text;   // A new name, or the mount command
+        QString text2;  // The unmount command
+    };
+
+    static Mutation renameDisk(qint64 diskID, const QString& newName);
+    static Mutation moveDisk(qint64 diskID, qint64 newCatID);
+    static Mutation setDiskCommands(qint64 diskID, const QString& mountCommand, const QString& unmountCommand);
+    static Mutation deleteDisk(qint64 diskID);
+    static Mutation renameCatalogue(qint64 catID, const QString& newName);
+    static Mutation deleteCatalogue(qint64 catID);
+    static QString describe(int op);
+
+    DBWriter();
+
+    quint64 submit(const Mutation& mutation);
+    void flush();
+    void beginBulk();
+    void endBulk();
+
+signals:
+    void finished(quint64 ticket, int op, qint64 id, bool ok); // id is the Mutation's
+
+private:
+    typedef QList<QPair<quint64, Mutation>> Batch;
+
+    void writeBatch();
+    bool writeTogether(DB* wdb, const Batch& batch);
+    bool apply(QSqlQuery& query, const Mutation& mutation);
+
+    QMutex mutex;
+    QWaitCondition gateChanged;
+    Batch pending;
+    bool batchQueued = false; // A writeBatch job is queued and hasn't taken pending yet
+    bool bulkOpen = false;
+    bool writerWaiting = false;
+    quint64 nextTicket = 1;
+    quint64 lastJob = 0; // GUI thread only
+};
+
+#endif // DBWRITER_H
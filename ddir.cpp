@@ -25,6 +25,8 @@
 #include "globals.h"
 #include "node.h"
 #include "utils.h"
+#include "catimage.h"
+#include "dbtable.h"
 
 #include "ddir.h"
 
@@ -37,19 +39,31 @@ bool DDir::loadFromDB()
 {
     if (dbLoaded) return false;
 
-    QSqlQuery query;
-    if (!query.exec(QString("select diskid,parent,numitems,name,modtime,fowner,fgroup,qpermissions,accessdenied from directories where id = %1").arg(id))) return false;
+    QSharedPointer<const CatImage> image = CatImage::current();
+    if (image && loadFromImage(*image))
+    {
+        dbLoaded = true;
+        return true;
+    }
+
+    SqlStatement query;
+    if (!query.prepare(db.getSQLiteHandle(), "select numitems, " + DBTable::columnList<DirectoriesTable>() +
+                                             " from directories where id = ?")) return false;
+    query.bind(1, id);
     if (!query.next()) return false;
 
-    diskID = query.value(0).toLongLong();
-    parentDirID = query.value(1).toLongLong();
-    numItems = query.value(2).toLongLong();
-    dirName = query.value(3).toString();
-    modtime = query.value(4).toLongLong();
-    fOwner = query.value(5).toString();
-    fGroup = query.value(6).toString();
-    qPermissions = query.value(7).toLongLong();
-    if (query.value(8).toInt() > 0) accessDenied = true;
+    DirRecord record;
+    record.numItems = query.int64(0);
+    DBTable::readRow<DirectoriesTable>(query, record, 1);
+    diskID = record.diskID;
+    parentDirID = record.parent;
+    numItems = record.numItems;
+    dirName = record.name;
+    modtime = record.modTime;
+    fOwner = record.owner;
+    fGroup = record.group;
+    qPermissions = record.qPermissions;
+    if (record.accessDenied > 0) accessDenied = true;
 
     qdtLastModified.setSecsSinceEpoch(modtime);
 
@@ -57,14 +71,16 @@ bool DDir::loadFromDB()
     if (parentDirID != 0) // is not a root directory
     {
         qint64 pparentDirID = parentDirID;
+        if (!query.prepare(db.getSQLiteHandle(), "select diskid, parent, name from directories where id = ?")) return false;
         while(true)
         {
-            query.exec(QString("select diskid,parent,name from directories where id = %1").arg(pparentDirID));
-            query.next();
-            pparentDirID = query.value(1).toLongLong();
-            diskID = query.value(0).toLongLong();
+            query.reset();
+            query.bind(1, pparentDirID);
+            if (!query.next()) return false;
+            pparentDirID = query.int64(1);
+            diskID = query.int64(0);
             if (pparentDirID == 0) break;
-            parents.prepend(query.value(2).toString());
+            parents.prepend(query.text(2));
         }
     }
 
@@ -76,20 +92,23 @@ bool DDir::loadFromDB()
         diskPath.append(q);
     }
 
-    if (!query.exec(QString("select catid,name,catpath from disks where id = %1").arg(diskID))) return false;
+    if (!query.prepare(db.getSQLiteHandle(), "select catid, name, catpath from disks where id = ?")) return false;
+    query.bind(1, diskID);
     if (!query.next()) return false;
-    catID = query.value(0).toLongLong();
-    diskName = query.value(1).toString();
+    catID = query.int64(0);
+    diskName = query.text(1);
 
-    containerPath = query.value(2).toString();
+    rootPath = query.text(2);
+    containerPath = rootPath;
     containerPath += diskPath;
     fullPath = containerPath + "/" + dirName;
 
     if (catID)
     {
-        if (!query.exec(QString("select name from catalogues where id = %1").arg(catID))) return false;
+        if (!query.prepare(db.getSQLiteHandle(), "select name from catalogues where id = ?")) return false;
+        query.bind(1, catID);
         if (!query.next()) return false;
-        catName = query.value(0).toString();
+        catName = query.text(0);
     }
 
     if (parents.size() == 0) diskPath = "/";
@@ -99,6 +118,41 @@ bool DDir::loadFromDB()
     return true;
 }
 
+bool DDir::loadFromImage(const CatImage& image)
+{
+    int dirIndex = image.findDir(id);
+    if (dirIndex < 0) return false;
+    const CatImage::Dir& dir = image.dirAt(dirIndex);
+    const CatImage::Disk* disk = image.findDisk(dir.diskID);
+    if (!disk) return false;
+
+    diskID = dir.diskID;
+    parentDirID = (dir.parent == CatImage::NO_PARENT) ? 0 : image.dirAt(static_cast<int>(dir.parent)).id;
+    numItems = dir.numItems;
+    dirName = image.string(dir.name);
+    modtime = dir.modTime;
+    fOwner = image.string(dir.owner);
+    fGroup = image.string(dir.group);
+    qPermissions = dir.qPermissions;
+    accessDenied = (dir.accessDenied > 0);
+
+    qdtLastModified.setSecsSinceEpoch(modtime);
+
+    if (dir.parent != CatImage::NO_PARENT) diskPath = image.diskPath(static_cast<int>(dir.parent));
+
+    catID = disk->catID;
+    diskName = image.string(disk->name);
+    catName = image.string(disk->catName);
+    rootPath = image.string(disk->catPath);
+    containerPath = rootPath;
+    containerPath += diskPath;
+    fullPath = containerPath + "/" + dirName;
+
+    if (diskPath.isEmpty()) diskPath = "/";
+    if (dirName.isEmpty()) dirName = "/";
+    return true;
+}
+
 void DDir::loadFromFileSystem()
 {
     if (fsLoaded) return;
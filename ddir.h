@@ -23,6 +23,8 @@
 #include <QFileInfo>
 #include <QString>
 
+class CatImage;
+
 class DDir
 {
 public:
@@ -37,6 +39,9 @@ public:
     const QString& getDiskName() const { return diskName; }
     const QString& getCatName() const { return catName; }
     const QString& getDiskPath() const { return diskPath; }
+    const QString& getRootPath() const { return rootPath; }
+    const QString& getFullPath() const { return fullPath; }
+    const QString& getContainerPath() const { return containerPath; }
     bool isAccessDenied() const { return accessDenied; }
 
     const QString& getLastModifiedFullText();
@@ -49,6 +54,8 @@ public:
     void osOpen();
 
 private:
+    bool loadFromImage(const CatImage& image);
+
     bool dbLoaded = false;
     bool fsLoaded = false;
 
@@ -73,6 +80,7 @@ private:
     QString lastModifiedFullText;
     QString permissionsText;
     QString diskPath;
+    QString rootPath;
     QString fullPath;
     QString containerPath;
     QDir qdir;
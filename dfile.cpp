@@ -17,13 +17,14 @@
 
 #include <QDateTime>
 #include <QLocale>
-#include <QSqlQuery>
 #include <QDebug>
 #include <QDesktopServices>
 #include <QUrl>
 
 #include "globals.h"
 #include "utils.h"
+#include "catimage.h"
+#include "dbtable.h"
 
 #include "dfile.h"
 
@@ -36,31 +37,43 @@ bool DFile::loadFromDB()
 {
     if (dbLoaded) return true;
 
-    QSqlQuery query;
-    if (!query.exec(QString("select dirid,name,size,type,modtime,fowner,fgroup,qpermissions from files where id = %1").arg(id))) return false;
+    SqlStatement query;
+    if (!query.prepare(db.getSQLiteHandle(), "select " + DBTable::columnList<FilesTable>() + " from files where id = ?")) return false;
+    query.bind(1, id);
     if (!query.next()) return false;
 
-    dirID = query.value(0).toLongLong();
-    fileName = query.value(1).toString();
-    size = query.value(2).toLongLong();
-    type = query.value(3).toInt();
-    modtime = query.value(4).toLongLong();
-    fOwner = query.value(5).toString();
-    fGroup = query.value(6).toString();
-    qPermissions = query.value(7).toLongLong();
+    FileRecord record;
+    DBTable::readRow<FilesTable>(query, record);
+    dirID = record.dirID;
+    fileName = record.name;
+    size = record.size;
+    type = record.type;
+    modtime = record.modTime;
+    fOwner = record.owner;
+    fGroup = record.group;
+    qPermissions = record.qPermissions;
 
     qdtLastModified.setSecsSinceEpoch(modtime);
 
+    QSharedPointer<const CatImage> image = CatImage::current();
+    if (image && locateFromImage(*image))
+    {
+        dbLoaded = true;
+        return true;
+    }
+
     QList<QString> parents;
     qint64 parentDirID = dirID;
+    if (!query.prepare(db.getSQLiteHandle(), "select diskid, parent, name from directories where id = ?")) return false;
     while(true)
     {
-        if (!query.exec(QString("select diskid,parent,name from directories where id = %1").arg(parentDirID))) return false;
+        query.reset();
+        query.bind(1, parentDirID);
         if (!query.next()) return false;
-        parentDirID = query.value(1).toLongLong();
-        diskID = query.value(0).toLongLong();
+        parentDirID = query.int64(1);
+        diskID = query.int64(0);
         if (parentDirID == 0) break;
-        parents.prepend(query.value(2).toString());
+        parents.prepend(query.text(2));
     }
 
     diskPath.reserve(1024);
@@ -71,25 +84,49 @@ bool DFile::loadFromDB()
         diskPath.append(q);
     }
 
-    if (!query.exec(QString("select catid,name,catpath from disks where id = %1").arg(diskID))) return false;
+    if (!query.prepare(db.getSQLiteHandle(), "select catid, name, catpath from disks where id = ?")) return false;
+    query.bind(1, diskID);
     if (!query.next()) return false;
-    catID = query.value(0).toLongLong();
-    diskName = query.value(1).toString();
+    catID = query.int64(0);
+    diskName = query.text(1);
 
-    containerPath = query.value(2).toString();
+    rootPath = query.text(2);
+    containerPath = rootPath;
     containerPath += diskPath;
     fullPath = containerPath + "/" + fileName;
 
     if (catID)
     {
-        if (!query.exec(QString("select name from catalogues where id = %1").arg(catID))) return false;
+        if (!query.prepare(db.getSQLiteHandle(), "select name from catalogues where id = ?")) return false;
+        query.bind(1, catID);
         if (!query.next()) return false;
-        catName = query.value(0).toString();
+        catName = query.text(0);
     }
     dbLoaded = true;
     return true;
 }
 
+// The directory chain, disk and catalogue without a query per level
+bool DFile::locateFromImage(const CatImage& image)
+{
+    int dirIndex = image.findDir(dirID);
+    if (dirIndex < 0) return false;
+    const CatImage::Dir& dir = image.dirAt(dirIndex);
+    const CatImage::Disk* disk = image.findDisk(dir.diskID);
+    if (!disk) return false;
+
+    diskID = dir.diskID;
+    diskPath = image.diskPath(dirIndex);
+    catID = disk->catID;
+    diskName = image.string(disk->name);
+    catName = image.string(disk->catName);
+    rootPath = image.string(disk->catPath);
+    containerPath = rootPath;
+    containerPath += diskPath;
+    fullPath = containerPath + "/" + fileName;
+    return true;
+}
+
 void DFile::loadFromFileSystem()
 {
     if (fsLoaded) return;
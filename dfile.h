@@ -23,6 +23,8 @@
 #include <QFileInfo>
 #include <QString>
 
+class CatImage;
+
 class DFile
 {
 public:
@@ -38,6 +40,9 @@ public:
     const QString& getDiskName() const { return diskName; }
     const QString& getCatName() const { return catName; }
     const QString& getDiskPath() const { return diskPath; }
+    const QString& getRootPath() const { return rootPath; }
+    const QString& getFullPath() const { return fullPath; }
+    const QString& getContainerPath() const { return containerPath; }
 
     const QString& getSizeFullText();
     const QString& getPermissionsText();
@@ -49,6 +54,8 @@ public:
     void osOpenContainer();
 
 private:
+    bool locateFromImage(const CatImage& image);
+
     bool dbLoaded = false;
     bool fsLoaded = false;
 
@@ -74,6 +81,7 @@ private:
     QString lastModifiedFullText;
     QString permissionsText;
     QString diskPath;
+    QString rootPath;
     QString fullPath;
     QString containerPath;
     QFile qfile;
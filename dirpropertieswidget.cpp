@@ -18,16 +18,18 @@
 #include <QDebug>
 
 #include "ddir.h"
+#include "reachabilitymonitor.h"
 
 #include "dirpropertieswidget.h"
 #include "ui_dirpropertieswidget.h"
 
-DirPropertiesWidget::DirPropertiesWidget(QWidget *t_parent, DDir* t_dir) :
+DirPropertiesWidget::DirPropertiesWidget(QWidget *t_parent, DDir* t_dir, ReachabilityMonitor* t_reachability) :
     QWidget(t_parent),
     ui(new Ui::DirPropertiesWidget),
     dirIcon(QIcon::fromTheme("folder")),
     dirPixmap(dirIcon.pixmap(100, 100)),
-    dir(t_dir)
+    dir(t_dir),
+    reachability(t_reachability)
 {
     ui->setupUi(this);
 
@@ -43,15 +45,17 @@ DirPropertiesWidget::DirPropertiesWidget(QWidget *t_parent, DDir* t_dir) :
     ui->lDiskName->setText(dir->getDiskName());
     ui->lCatalogue->setText(dir->getCatName());
 
-    if (dir->isReachable())
-    {
-        ui->lReachable->setText("Yes");
-        ui->bOpenDirectory->setEnabled(true);
-    }
-    else
-    {
-        ui->lReachable->setText("No");
-    }
+    showReachability();
+    connect(reachability, SIGNAL(updated()), this, SLOT(showReachability()));
+}
+
+// From the monitor's cache, so a dead mount can't hang the dialog. Shown again as probes answer
+void DirPropertiesWidget::showReachability()
+{
+    ReachabilityMonitor::PathState ps = reachability->query(dir->getRootPath(), dir->getFullPath());
+    if (!ps.known) ui->lReachable->setText("Checking...");
+    else ui->lReachable->setText(ps.isDir ? "Yes" : "No");
+    ui->bOpenDirectory->setEnabled(ps.isDir);
 }
 
 DirPropertiesWidget::~DirPropertiesWidget()
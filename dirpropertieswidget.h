@@ -26,24 +26,27 @@ class DirPropertiesWidget;
 }
 
 class DDir;
+class ReachabilityMonitor;
 
 class DirPropertiesWidget : public QWidget
 {
     Q_OBJECT
 
 public:
-    explicit DirPropertiesWidget(QWidget *parent, DDir* dir);
+    explicit DirPropertiesWidget(QWidget *parent, DDir* dir, ReachabilityMonitor* reachability);
     ~DirPropertiesWidget();
 
 private slots:
     void on_bOpenDirectory_clicked();
     void on_bCalcSubContents_clicked();
+    void showReachability();
 
 private:
     Ui::DirPropertiesWidget *ui;
     QIcon dirIcon;
     QPixmap dirPixmap;
     DDir* dir;
+    ReachabilityMonitor* reachability;
 };
 
 #endif // DIRPROPERTIESWIDGET_H
@@ -0,0 +1,210 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <QDebug>
+#include <QStringList>
+
+#include "globals.h"
+#include "sqlstatement.h"
+
+#include "diskstats.h"
+
+namespace
+{
+    // Extensions, lower case, to the kind of content they are most likely to be
+    const QHash<QString, QString>& groupTable()
+    {
+        static const QHash<QString, QString> table = []
+        {
+            QHash<QString, QString> t;
+            auto add = [&t] (const char* group, const QStringList& extensions)
+            {
+                for (const QString& extension : extensions) t.insert(extension, group);
+            };
+
+            add("Video", { "mp4", "mkv", "avi", "mov", "wmv", "flv", "webm", "m4v", "mpg", "mpeg", "ts", "vob", "3gp" });
+            add("Audio", { "mp3", "flac", "wav", "ogg", "m4a", "aac", "wma", "opus", "aiff", "ape" });
+            add("Images", { "jpg", "jpeg", "png", "gif", "bmp", "tif", "tiff", "webp", "svg", "heic", "cr2", "nef", "dng", "psd", "ico" });
+            add("Documents", { "pdf", "doc", "docx", "odt", "xls", "xlsx", "ods", "ppt", "pptx", "odp", "txt", "rtf", "md", "epub", "csv", "html", "htm" });
+            add("Archives", { "zip", "rar", "7z", "tar", "gz", "bz2", "xz", "zst", "tgz", "iso", "dmg", "deb", "rpm" });
+            add("Source code", { "c", "cpp", "cc", "h", "hpp", "py", "js", "java", "rs", "go", "rb", "php", "sh", "pl", "cs", "swift", "kt", "sql", "json", "xml", "yml", "yaml" });
+            return t;
+        }();
+        return table;
+    }
+
+    const char* const KEY_ALL = "all";
+    const char* const NO_EXTENSION = "(none)";
+}
+
+void DiskStats::addFile(const QString& name, int type, qint64 size)
+{
+    all.add(size);
+
+    if (type == TYPE_SYMLINK)
+    {
+        groups["Symbolic links"].add(size);
+        return;
+    }
+    if (type != TYPE_FILE)
+    {
+        groups["Special files"].add(size);
+        return;
+    }
+
+    QString extension = extensionOf(name);
+    extensions[extension].add(size);
+    groups[groupTable().value(extension, "Other files")].add(size);
+    sizes[sizeBucket(size)].add(size);
+}
+
+// Hidden files (".profile") and anything that doesn't look like an extension count as having none
+QString DiskStats::extensionOf(const QString& name)
+{
+    int dot = name.lastIndexOf('.');
+    if (dot < 1) return NO_EXTENSION;
+
+    int length = name.size() - dot - 1;
+    if ((length < 1) || (length > MAX_EXTENSION_LENGTH)) return NO_EXTENSION;
+
+    for (int i = dot + 1; i < name.size(); i++)
+    {
+        if (!name[i].isLetterOrNumber()) return NO_EXTENSION;
+    }
+    return name.mid(dot + 1).toLower();
+}
+
+int DiskStats::sizeBucket(qint64 size)
+{
+    if (size <= 0) return 0;
+
+    // 4 KiB, then every factor of 16
+    qint64 limit = 4096;
+    int bucket = 1;
+    while ((bucket < NUM_SIZE_BUCKETS - 1) && (size >= limit))
+    {
+        limit *= 16;
+        ++bucket;
+    }
+    return bucket;
+}
+
+QString DiskStats::sizeBucketName(int bucket)
+{
+    switch (bucket)
+    {
+        case 0: return "Empty";
+        case 1: return "Under 4 KiB";
+        case 2: return "4 KiB - 64 KiB";
+        case 3: return "64 KiB - 1 MiB";
+        case 4: return "1 MiB - 16 MiB";
+        case 5: return "16 MiB - 256 MiB";
+        case 6: return "256 MiB - 4 GiB";
+        default: return "4 GiB and over";
+    }
+}
+
+bool DiskStats::store(sqlite3* handle, qint64 diskID) const
+{
+    SqlStatement query;
+    if (!query.prepare(handle, "delete from diskstats where diskid = ?")) return false;
+    query.bind(1, diskID);
+    if (!query.exec()) return false;
+
+    if (!query.prepare(handle, "insert into diskstats (diskid, kind, key, numfiles, totalsize) values (?, ?, ?, ?, ?)")) return false;
+
+    auto insert = [&] (int kind, const QString& key, const Total& total)
+    {
+        query.bind(1, diskID);
+        query.bind(2, kind);
+        query.bind(3, key);
+        query.bind(4, total.numFiles);
+        query.bind(5, total.totalSize);
+        return query.exec();
+    };
+
+    if (!insert(KIND_TOTAL, KEY_ALL, all)) return false;
+    for (auto i = groups.constBegin(); i != groups.constEnd(); ++i)
+    {
+        if (!insert(KIND_GROUP, i.key(), i.value())) return false;
+    }
+    for (auto i = extensions.constBegin(); i != extensions.constEnd(); ++i)
+    {
+        if (!insert(KIND_EXTENSION, i.key(), i.value())) return false;
+    }
+    for (int bucket = 0; bucket < NUM_SIZE_BUCKETS; bucket++)
+    {
+        if (sizes[bucket].numFiles && !insert(KIND_SIZE, QString::number(bucket), sizes[bucket])) return false;
+    }
+    return true;
+}
+
+void DiskStats::addTo(QVector<DiskStatsRow>& rows) const
+{
+    auto add = [&] (int kind, const QString& key, const Total& total)
+    {
+        for (DiskStatsRow& row : rows)
+        {
+            if ((row.kind != kind) || (row.key != key)) continue;
+            row.numFiles += total.numFiles;
+            row.totalSize += total.totalSize;
+            return;
+        }
+        rows.append({ kind, key, total.numFiles, total.totalSize });
+    };
+
+    add(KIND_TOTAL, KEY_ALL, all);
+    for (auto i = groups.constBegin(); i != groups.constEnd(); ++i) add(KIND_GROUP, i.key(), i.value());
+    for (auto i = extensions.constBegin(); i != extensions.constEnd(); ++i) add(KIND_EXTENSION, i.key(), i.value());
+    for (int bucket = 0; bucket < NUM_SIZE_BUCKETS; bucket++)
+    {
+        if (sizes[bucket].numFiles) add(KIND_SIZE, QString::number(bucket), sizes[bucket]);
+    }
+}
+
+bool DiskStats::isStored(sqlite3* handle, qint64 diskID)
+{
+    SqlStatement query;
+    if (!query.prepare(handle, "select 1 from diskstats where diskid = ? and kind = ?")) return false;
+    query.bind(1, diskID);
+    query.bind(2, static_cast<int>(KIND_TOTAL));
+    return query.next();
+}
+
+// The disks' rows added together. Size rows come back with the bucket number as the key
+bool DiskStats::load(sqlite3* handle, const QVector<qint64>& diskIDs, QVector<DiskStatsRow>& rows)
+{
+    if (diskIDs.isEmpty()) return true;
+
+    QStringList ids;
+    for (qint64 diskID : diskIDs) ids.append(QString::number(diskID));
+
+    SqlStatement query;
+    if (!query.prepare(handle, QString("select kind, key, sum(numfiles), sum(totalsize) from diskstats "
+                                       "where diskid in (%1) group by kind, key").arg(ids.join(',')).toUtf8())) return false;
+    while (query.next())
+    {
+        rows.append({ query.integer(0), query.text(1), query.int64(2), query.int64(3) });
+    }
+    if (query.failed())
+    {
+        qDebug() << "DiskStats: load failed:" << query.errorText();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DISKSTATS_H
+#define DISKSTATS_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+struct sqlite3;
+
+struct DiskStatsRow
+{
+    int kind;
+    QString key;
+    qint64 numFiles;
+    qint64 totalSize;
+};
+
+/* Breakdowns of a disk's files by kind of content, by extension and by size,
+ * tallied in one pass over the files. The Cataloguer tallies as it finishes a
+ * scan, during the pass it already makes over every file, and stores the
+ * result in the diskstats table. Re-cataloguing a disk clears its rows, and
+ * disks with none (catalogued before the table existed, or brought in by an
+ * import) are tallied on demand by StatsBuilder. A catalogue's breakdown is
+ * a group by over its disks' rows, never over the files.
+ *
+ * Each stored disk has a KIND_TOTAL row, so a disk without files still shows
+ * as done.
+ */
+
+class DiskStats
+{
+public:
+    enum Kind { KIND_TOTAL = 0, KIND_GROUP = 1, KIND_EXTENSION = 2, KIND_SIZE = 3 };
+
+    void addFile(const QString& name, int type, qint64 size);
+    bool store(sqlite3* handle, qint64 diskID) const; // Replaces the disk's rows. Inside the caller's transaction
+    void addTo(QVector<DiskStatsRow>& rows) const; // Sums into rows as load() returns them, for stats that weren't stored
+
+    static bool isStored(sqlite3* handle, qint64 diskID);
+    static bool load(sqlite3* handle, const QVector<qint64>& diskIDs, QVector<DiskStatsRow>& rows);
+    static QString sizeBucketName(int bucket);
+
+    const static int NUM_SIZE_BUCKETS = 8;
+
+private:
+    struct Total
+    {
+        qint64 numFiles = 0;
+        qint64 totalSize = 0;
+        void add(qint64 size) { ++numFiles; totalSize += size; }
+    };
+
+    static QString extensionOf(const QString& name);
+    static int sizeBucket(qint64 size);
+
+    Total all;
+    QHash<QString, Total> groups;
+    QHash<QString, Total> extensions;
+    Total sizes[NUM_SIZE_BUCKETS];
+
+    const static int MAX_EXTENSION_LENGTH = 10;
+};
+
+#endif // DISKSTATS_H
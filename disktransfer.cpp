@@ -0,0 +1,542 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QSqlQuery>
+#include <QVariant>
+
+#include "globals.h"
+#include "db.h"
+#include "dbpool.h"
+#include "snapshot.h"
+
+#include "disktransfer.h"
+
+/* Snapshot record layout, in stream order
+ *
+ * Header:      bytes "EZCATSNP", uint format version
+ * Disk:        string name, catpath, int cattime, string devname, fslabel, fstype,
+ *              int fssize, fsfree, uint isroot, string mountcmd, umountcmd, uuid,
+ *              uint numdirs, numfiles, totalsize, hashcontents,
+ *              string excludes, uint mountpolicy
+ * Directories: in id order, so parents come first. Each is uint 1, then
+ *              uint steps back to the parent (0 for the root), uint numitems + 1,
+ *              string name, int modtime delta, table fowner, fgroup,
+ *              uint qpermissions, accessdenied, bytes digest, uint totalsize + 1.
+ *              uint 0 ends the list. The + 1 fields use 0 for null.
+ * Files:       in directory order. Each is uint 1, then uint steps on from the
+ *              previous file's directory, string name, uint size, type,
+ *              int modtime delta, table fowner, fgroup, uint qpermissions,
+ *              bytes hash. uint 0 ends the list.
+ * File hashes: each is uint 1, then string path, uint size, int modtime,
+ *              bytes hash, int seen. uint 0 ends the list.
+ */
+
+namespace
+{
+    const char SNAPSHOT_MAGIC[] = "EZCATSNP";
+
+    quint64 nullableToUInt(const QVariant& value)
+    {
+        if (value.isNull()) return 0;
+        return static_cast<quint64>(value.toLongLong()) + 1;
+    }
+
+    QVariant uintToNullable(quint64 value)
+    {
+        if (value == 0) return QVariant(QVariant::LongLong);
+        return static_cast<qint64>(value - 1);
+    }
+}
+
+DiskTransfer::DiskTransfer(Mode t_mode, const QString& t_fileName, qint64 t_id)
+    : mode(t_mode), fileName(t_fileName), id(t_id)
+{
+}
+
+void DiskTransfer::abort()
+{
+    abortNow = true;
+}
+
+void DiskTransfer::countObject()
+{
+    if (++numObjects % 10000 == 0) emit progress(numObjects);
+}
+
+void DiskTransfer::go()
+{
+    try
+    {
+        tdb = DBPool::connection();
+        if (!tdb) throw 6;
+
+        if (mode == MODE_EXPORT) exportDisk();
+        else if (mode == MODE_IMPORT) importDisk();
+        else mergeDatabase();
+    }
+    catch (int e)
+    {
+        savedError = e;
+        qDebug() << "DiskTransfer error: " << e;
+        if      (e == 6) qDebug() << "Failed to get a DB connection";
+        else if (e == 10) qDebug() << "Snapshot file open failed";
+        else if (e == 20) qDebug() << "Export: disk query failed";
+        else if (e == 30) qDebug() << "Export: directories query failed";
+        else if (e == 35) qDebug() << "Export: directory found before its parent";
+        else if (e == 40) qDebug() << "Export: files query failed";
+        else if (e == 45) qDebug() << "Export: file hashes query failed";
+        else if (e == 50) qDebug() << "Export: write failed";
+        else if (e == 100) qDebug() << "Import: not a snapshot, or an unsupported version";
+        else if (e == 110) qDebug() << "Failed to start transaction";
+        else if (e == 120) qDebug() << "Drop index query failed";
+        else if (e == 130) qDebug() << "Max IDs query failed";
+        else if (e == 135) qDebug() << "Row count query failed";
+        else if (e == 140) qDebug() << "Import: disk insert failed";
+        else if (e == 150) qDebug() << "Import: directory insert failed";
+        else if (e == 160) qDebug() << "Import: file insert failed";
+        else if (e == 165) qDebug() << "Import: file hash insert failed";
+        else if (e == 170) qDebug() << "Import: snapshot is damaged";
+        else if (e == 180) qDebug() << "Create index query failed";
+        else if (e == 190) qDebug() << "Commit transaction failed";
+        else if (e == 210) qDebug() << "Aborted";
+        else if (e == 300) qDebug() << "Merge: attach failed";
+        else if (e == ERROR_VERSION) qDebug() << "Merge: other database is a different version";
+        else if (e == 315) qDebug() << "Merge: other database is the open one";
+        else if (e == 320) qDebug() << "Merge: disks copy failed";
+        else if (e == 330) qDebug() << "Merge: directories copy failed";
+        else if (e == 340) qDebug() << "Merge: files copy failed";
+        else if (e == 350) qDebug() << "Merge: file hashes copy failed";
+
+        newDiskIDs.clear();
+        if (inTransaction) tdb->rollbackTransaction();
+    }
+
+    if (tdb)
+    {
+        if (attached)
+        {
+            QSqlQuery query(tdb->getqdb());
+            if (!query.exec("detach database src")) qDebug() << "DiskTransfer: detach failed";
+        }
+        tdb = NULL;
+    }
+
+    emit progress(numObjects);
+    emit finished(savedError == 0);
+}
+
+void DiskTransfer::dropIndexes(QSqlQuery& query) // throws int
+{
+    for (const DBIndex& index : DB::getIndexes())
+        if (!query.exec(QString("drop index main.%1").arg(index.name))) throw 120;
+}
+
+void DiskTransfer::createIndexes(QSqlQuery& query) // throws int
+{
+    for (const DBIndex& index : DB::getIndexes())
+        if (!query.exec(QString("create index main.%1 on %2").arg(index.name, index.on))) throw 180;
+}
+
+qint64 DiskTransfer::liveRows(QSqlQuery& query, const QString& schema) // throws int
+{
+    // The disks keep their own totals, far cheaper than counting the tables
+    if (!query.exec(QString("select ifnull(sum(numdirs + numfiles), 0) from %1.disks where deleted = 0").arg(schema))) throw 135;
+    if (!query.next()) throw 135;
+    return query.value(0).toLongLong();
+}
+
+bool DiskTransfer::worthRebuildingIndexes(qint64 incomingRows, qint64 existingRows)
+{
+    // Rows go in through the indexes at a little extra cost each. Dropping them and building
+    // them again afterwards costs a sort of every row in the tables, which only pays off when
+    // the new rows outnumber the ones already there
+    return incomingRows > existingRows;
+}
+
+void DiskTransfer::maxIDs(QSqlQuery& query, qint64& maxDirID, qint64& maxFileID) // throws int
+{
+    if (!query.exec("select ifnull(max(id), 0) from main.directories")) throw 130;
+    if (!query.next()) throw 130;
+    maxDirID = query.value(0).toLongLong();
+    if (!query.exec("select ifnull(max(id), 0) from main.files")) throw 130;
+    if (!query.next()) throw 130;
+    maxFileID = query.value(0).toLongLong();
+}
+
+void DiskTransfer::exportDisk() // throws int
+{
+    QSqlQuery query(tdb->getqdb());
+    query.setForwardOnly(true);
+
+    if (!query.exec(QString("select name, catpath, cattime, devname, fslabel, fstype, fssize, fsfree, isroot, "
+                            "mountcmd, umountcmd, uuid, numdirs, numfiles, totalsize, hashcontents, excludes, mountpolicy "
+                            "from disks where id = %1").arg(id))) throw 20;
+    if (!query.next()) throw 20;
+
+    // QSaveFile only replaces the target once everything is written
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) throw 10;
+
+    SnapshotWriter writer(&file);
+    writer.putBytes(QByteArray(SNAPSHOT_MAGIC));
+    writer.putUInt(FORMAT_VERSION);
+
+    writer.putString(query.value(0).toString());
+    writer.putString(query.value(1).toString());
+    writer.putInt(query.value(2).toLongLong());
+    writer.putString(query.value(3).toString());
+    writer.putString(query.value(4).toString());
+    writer.putString(query.value(5).toString());
+    writer.putInt(query.value(6).toLongLong());
+    writer.putInt(query.value(7).toLongLong());
+    writer.putUInt(query.value(8).toULongLong());
+    writer.putString(query.value(9).toString());
+    writer.putString(query.value(10).toString());
+    writer.putString(query.value(11).toString());
+    writer.putUInt(query.value(12).toULongLong());
+    writer.putUInt(query.value(13).toULongLong());
+    writer.putUInt(query.value(14).toULongLong());
+    writer.putUInt(query.value(15).toULongLong());
+    writer.putString(query.value(16).toString());
+    writer.putUInt(query.value(17).toULongLong());
+    writer.endRecord();
+
+    // Directories. Parents are always inserted before their children, so id order has them first
+    if (!query.exec(QString("select id, parent, numitems, name, modtime, fowner, fgroup, qpermissions, accessdenied, "
+                            "digest, totalsize from directories where diskid = %1 order by id").arg(id))) throw 30;
+
+    QHash<qint64, qint64> ordinals;
+    qint64 ordinal = 0;
+    qint64 lastModTime = 0;
+    while (query.next())
+    {
+        if (abortNow) throw 210;
+
+        qint64 dirID = query.value(0).toLongLong();
+        qint64 parent = query.value(1).toLongLong();
+        quint64 stepsBack = 0;
+        if (parent != 0)
+        {
+            auto i = ordinals.constFind(parent);
+            if (i == ordinals.constEnd()) throw 35;
+            stepsBack = static_cast<quint64>(ordinal - i.value());
+        }
+        qint64 modTime = query.value(4).toLongLong();
+
+        writer.putUInt(1);
+        writer.putUInt(stepsBack);
+        writer.putUInt(nullableToUInt(query.value(2)));
+        writer.putString(query.value(3).toString());
+        writer.putInt(modTime - lastModTime);
+        writer.putTableString(query.value(5).toString());
+        writer.putTableString(query.value(6).toString());
+        writer.putUInt(query.value(7).toULongLong());
+        writer.putUInt(query.value(8).toULongLong());
+        writer.putBytes(query.value(9).toByteArray());
+        writer.putUInt(nullableToUInt(query.value(10)));
+        writer.endRecord();
+        if (!writer.ok()) throw 50;
+
+        ordinals.insert(dirID, ordinal++);
+        lastModTime = modTime;
+        countObject();
+    }
+    writer.putUInt(0);
+
+    // Files
+    if (!query.exec(QString("select f.dirid, f.name, f.size, f.type, f.modtime, f.fowner, f.fgroup, f.qpermissions, f.hash "
+                            "from files as f join directories as d on f.dirid = d.id "
+                            "where d.diskid = %1 order by f.dirid, f.id").arg(id))) throw 40;
+
+    qint64 lastOrdinal = 0;
+    lastModTime = 0;
+    while (query.next())
+    {
+        if (abortNow) throw 210;
+
+        auto i = ordinals.constFind(query.value(0).toLongLong());
+        if (i == ordinals.constEnd()) throw 40;
+        qint64 modTime = query.value(4).toLongLong();
+
+        writer.putUInt(1);
+        writer.putUInt(static_cast<quint64>(i.value() - lastOrdinal));
+        writer.putString(query.value(1).toString());
+        writer.putUInt(query.value(2).toULongLong());
+        writer.putUInt(query.value(3).toULongLong());
+        writer.putInt(modTime - lastModTime);
+        writer.putTableString(query.value(5).toString());
+        writer.putTableString(query.value(6).toString());
+        writer.putUInt(query.value(7).toULongLong());
+        writer.putBytes(query.value(8).toByteArray());
+        writer.endRecord();
+        if (!writer.ok()) throw 50;
+
+        lastOrdinal = i.value();
+        lastModTime = modTime;
+        countObject();
+    }
+    writer.putUInt(0);
+
+    // The content hash memo, so a later update of the imported disk need not read everything again
+    if (!query.exec(QString("select path, size, modtime, hash, seen from filehashes where diskid = %1").arg(id))) throw 45;
+    while (query.next())
+    {
+        if (abortNow) throw 210;
+
+        writer.putUInt(1);
+        writer.putString(query.value(0).toString());
+        writer.putUInt(query.value(1).toULongLong());
+        writer.putInt(query.value(2).toLongLong());
+        writer.putBytes(query.value(3).toByteArray());
+        writer.putInt(query.value(4).toLongLong());
+        writer.endRecord();
+        if (!writer.ok()) throw 50;
+    }
+    writer.putUInt(0);
+
+    if (!writer.finish()) throw 50;
+    if (!file.commit()) throw 50;
+}
+
+void DiskTransfer::importDisk() // throws int
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) throw 10;
+
+    SnapshotReader reader(&file);
+    if (reader.getBytes() != QByteArray(SNAPSHOT_MAGIC)) throw 100;
+    if (reader.getUInt() != FORMAT_VERSION) throw 100;
+
+    QSqlQuery query(tdb->getqdb());
+
+    if (!tdb->startTransaction()) throw 110;
+    inTransaction = true;
+
+    qint64 maxDirID;
+    qint64 maxFileID;
+    maxIDs(query, maxDirID, maxFileID);
+    qint64 existingRows = liveRows(query, "main");
+
+    if (!query.prepare("insert into disks (catid, name, catpath, cattime, devname, fslabel, fstype, fssize, fsfree, isroot, "
+                       "mountcmd, umountcmd, uuid, numdirs, numfiles, totalsize, hashcontents, excludes, mountpolicy) "
+                       "values (:catid, :name, :catpath, :cattime, :devname, :fslabel, :fstype, :fssize, :fsfree, :isroot, "
+                       ":mountcmd, :umountcmd, :uuid, :numdirs, :numfiles, :totalsize, :hashcontents, :excludes, :mountpolicy)")) throw 140;
+    query.bindValue(":catid", id);
+    query.bindValue(":name", reader.getString());
+    query.bindValue(":catpath", reader.getString());
+    query.bindValue(":cattime", reader.getInt());
+    query.bindValue(":devname", reader.getString());
+    query.bindValue(":fslabel", reader.getString());
+    query.bindValue(":fstype", reader.getString());
+    query.bindValue(":fssize", reader.getInt());
+    query.bindValue(":fsfree", reader.getInt());
+    query.bindValue(":isroot", reader.getUInt());
+    query.bindValue(":mountcmd", reader.getString());
+    query.bindValue(":umountcmd", reader.getString());
+    query.bindValue(":uuid", reader.getString());
+    query.bindValue(":numdirs", reader.getUInt());
+    query.bindValue(":numfiles", reader.getUInt());
+    query.bindValue(":totalsize", reader.getUInt());
+    query.bindValue(":hashcontents", reader.getUInt());
+    QString excludes = reader.getString();
+    query.bindValue(":excludes", excludes.isEmpty() ? QVariant() : QVariant(excludes)); // Stored as null when there are none
+    query.bindValue(":mountpolicy", reader.getUInt());
+    if (!reader.ok()) throw 170;
+    if (!query.exec()) throw 140;
+    qint64 newDiskID = query.lastInsertId().toLongLong();
+
+    bool rebuildIndexes = worthRebuildingIndexes(query.boundValue(":numdirs").toLongLong() + query.boundValue(":numfiles").toLongLong(),
+                                                 existingRows);
+    if (rebuildIndexes) dropIndexes(query);
+
+    // Directories. New IDs are the ordinals shifted above everything already in the table
+    QSqlQuery dirQuery(tdb->getqdb());
+    if (!dirQuery.prepare("insert into directories (id, diskid, parent, numitems, name, modtime, fowner, fgroup, "
+                          "qpermissions, accessdenied, digest, totalsize) "
+                          "values (:id, :diskid, :parent, :numitems, :name, :modtime, :fowner, :fgroup, "
+                          ":qpermissions, :accessdenied, :digest, :totalsize)")) throw 150;
+
+    qint64 numDirs = 0;
+    qint64 modTime = 0;
+    while (reader.getUInt() == 1)
+    {
+        if (abortNow) throw 210;
+
+        quint64 stepsBack = reader.getUInt();
+        if (stepsBack > static_cast<quint64>(numDirs)) throw 170;
+        if ((stepsBack == 0) && (numDirs > 0)) throw 170; // Only the first directory is a root
+
+        dirQuery.bindValue(":id", maxDirID + 1 + numDirs);
+        dirQuery.bindValue(":diskid", newDiskID);
+        dirQuery.bindValue(":parent", stepsBack ? (maxDirID + 1 + numDirs - static_cast<qint64>(stepsBack)) : 0);
+        dirQuery.bindValue(":numitems", uintToNullable(reader.getUInt()));
+        dirQuery.bindValue(":name", reader.getString());
+        modTime += reader.getInt();
+        dirQuery.bindValue(":modtime", modTime);
+        dirQuery.bindValue(":fowner", reader.getTableString());
+        dirQuery.bindValue(":fgroup", reader.getTableString());
+        dirQuery.bindValue(":qpermissions", reader.getUInt());
+        dirQuery.bindValue(":accessdenied", reader.getUInt());
+        dirQuery.bindValue(":digest", reader.getBytes());
+        dirQuery.bindValue(":totalsize", uintToNullable(reader.getUInt()));
+        if (!reader.ok()) throw 170;
+        if (!dirQuery.exec()) throw 150;
+
+        ++numDirs;
+        countObject();
+    }
+    if (!reader.ok() || (numDirs == 0)) throw 170;
+
+    // Files
+    QSqlQuery fileQuery(tdb->getqdb());
+    if (!fileQuery.prepare("insert into files (id, dirid, name, size, type, modtime, fowner, fgroup, qpermissions, hash) "
+                           "values (:id, :dirid, :name, :size, :type, :modtime, :fowner, :fgroup, :qpermissions, :hash)")) throw 160;
+
+    qint64 numFiles = 0;
+    qint64 dirOrdinal = 0;
+    modTime = 0;
+    while (reader.getUInt() == 1)
+    {
+        if (abortNow) throw 210;
+
+        dirOrdinal += static_cast<qint64>(reader.getUInt());
+        if (dirOrdinal >= numDirs) throw 170;
+
+        fileQuery.bindValue(":id", maxFileID + 1 + numFiles);
+        fileQuery.bindValue(":dirid", maxDirID + 1 + dirOrdinal);
+        fileQuery.bindValue(":name", reader.getString());
+        fileQuery.bindValue(":size", reader.getUInt());
+        fileQuery.bindValue(":type", reader.getUInt());
+        modTime += reader.getInt();
+        fileQuery.bindValue(":modtime", modTime);
+        fileQuery.bindValue(":fowner", reader.getTableString());
+        fileQuery.bindValue(":fgroup", reader.getTableString());
+        fileQuery.bindValue(":qpermissions", reader.getUInt());
+        fileQuery.bindValue(":hash", reader.getBytes());
+        if (!reader.ok()) throw 170;
+        if (!fileQuery.exec()) throw 160;
+
+        ++numFiles;
+        countObject();
+    }
+    if (!reader.ok()) throw 170;
+
+    // File hashes
+    if (!query.prepare("insert into filehashes (diskid, path, size, modtime, hash, seen) "
+                       "values (:diskid, :path, :size, :modtime, :hash, :seen)")) throw 165;
+    while (reader.getUInt() == 1)
+    {
+        if (abortNow) throw 210;
+
+        query.bindValue(":diskid", newDiskID);
+        query.bindValue(":path", reader.getString());
+        query.bindValue(":size", reader.getUInt());
+        query.bindValue(":modtime", reader.getInt());
+        query.bindValue(":hash", reader.getBytes());
+        query.bindValue(":seen", reader.getInt());
+        if (!reader.ok()) throw 170;
+        if (!query.exec()) throw 165;
+    }
+    if (!reader.ok()) throw 170;
+
+    emit progress(numObjects);
+    if (rebuildIndexes) createIndexes(query);
+    if (!tdb->commitTransaction()) throw 190;
+    inTransaction = false;
+
+    newDiskIDs.append(newDiskID);
+}
+
+void DiskTransfer::mergeDatabase() // throws int
+{
+    if (QFileInfo(fileName).canonicalFilePath() == QFileInfo(DB::getFileName()).canonicalFilePath()) throw 315;
+
+    QSqlQuery query(tdb->getqdb());
+
+    // Attach has to happen outside a transaction
+    if (!query.prepare("attach database :file as src")) throw 300;
+    query.bindValue(":file", fileName);
+    if (!query.exec()) throw 300;
+    attached = true;
+
+    if (!query.exec("select version from src.ezcat_db_version")) throw ERROR_VERSION;
+    if (!query.next() || (query.value(0).toInt() != DB_VERSION)) throw ERROR_VERSION;
+
+    if (!tdb->startTransaction()) throw 110;
+    inTransaction = true;
+
+    bool rebuildIndexes = worthRebuildingIndexes(liveRows(query, "src"), liveRows(query, "main"));
+    if (rebuildIndexes) dropIndexes(query);
+
+    qint64 maxDirID;
+    qint64 maxFileID;
+    maxIDs(query, maxDirID, maxFileID);
+
+    // Disks one at a time to learn their new IDs, then everything under them set-wise through the map
+    if (!query.exec("create temp table diskmap (oldid integer primary key, newid integer not null)")) throw 320;
+
+    QList<qint64> oldDiskIDs;
+    // Partly catalogued disks are left behind, their scan state doesn't carry over
+    if (!query.exec("select id from src.disks where deleted = 0 and partial = 0 order by id")) throw 320;
+    while (query.next()) oldDiskIDs.append(query.value(0).toLongLong());
+
+    for (qint64 oldDiskID : oldDiskIDs)
+    {
+        if (!query.exec(QString("insert into main.disks (catid, name, catpath, cattime, devname, fslabel, fstype, fssize, fsfree, "
+                                "isroot, mountcmd, umountcmd, uuid, numdirs, numfiles, totalsize, hashcontents, excludes, mountpolicy) "
+                                "select %1, name, catpath, cattime, devname, fslabel, fstype, fssize, fsfree, "
+                                "isroot, mountcmd, umountcmd, uuid, numdirs, numfiles, totalsize, hashcontents, excludes, mountpolicy "
+                                "from src.disks where id = %2").arg(id).arg(oldDiskID))) throw 320;
+        qint64 newDiskID = query.lastInsertId().toLongLong();
+        if (!query.exec(QString("insert into temp.diskmap (oldid, newid) values (%1, %2)").arg(oldDiskID).arg(newDiskID))) throw 320;
+        newDiskIDs.append(newDiskID);
+    }
+
+    if (abortNow) throw 210;
+    if (!query.exec(QString("insert into main.directories (id, diskid, parent, numitems, name, modtime, fowner, fgroup, "
+                            "qpermissions, accessdenied, digest, totalsize) "
+                            "select d.id + %1, m.newid, case when d.parent = 0 then 0 else d.parent + %1 end, "
+                            "d.numitems, d.name, d.modtime, d.fowner, d.fgroup, d.qpermissions, d.accessdenied, d.digest, d.totalsize "
+                            "from src.directories as d join temp.diskmap as m on d.diskid = m.oldid").arg(maxDirID))) throw 330;
+    numObjects += query.numRowsAffected();
+    emit progress(numObjects);
+
+    if (abortNow) throw 210;
+    if (!query.exec(QString("insert into main.files (id, dirid, name, size, type, modtime, fowner, fgroup, qpermissions, hash) "
+                            "select f.id + %1, f.dirid + %2, f.name, f.size, f.type, f.modtime, f.fowner, f.fgroup, "
+                            "f.qpermissions, f.hash "
+                            "from src.files as f join src.directories as d on f.dirid = d.id "
+                            "join temp.diskmap as m on d.diskid = m.oldid").arg(maxFileID).arg(maxDirID))) throw 340;
+    numObjects += query.numRowsAffected();
+    emit progress(numObjects);
+
+    if (abortNow) throw 210;
+    if (!query.exec("insert into main.filehashes (diskid, path, size, modtime, hash, seen) "
+                    "select m.newid, h.path, h.size, h.modtime, h.hash, h.seen "
+                    "from src.filehashes as h join temp.diskmap as m on h.diskid = m.oldid")) throw 350;
+
+    if (!query.exec("drop table temp.diskmap")) throw 350;
+
+    if (rebuildIndexes) createIndexes(query);
+    if (!tdb->commitTransaction()) throw 190;
+    inTransaction = false;
+}
@@ -0,0 +1,88 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DISKTRANSFER_H
+#define DISKTRANSFER_H
+
+#include <QList>
+#include <QObject>
+#include <QString>
+
+class DB;
+class QSqlQuery;
+
+/* Moves catalogued disks between databases, on its own thread like the Cataloguer.
+ *
+ * Export writes one disk to a snapshot file (see snapshot.h). Import reads one
+ * back into a catalogue. Merge copies every live disk from another EZ Cat
+ * database file with a few INSERT ... SELECT statements over an attached
+ * connection. Import and merge give the new rows IDs by adding a fixed offset
+ * above the current maximum, so no per-row ID map is needed. Both run in one
+ * transaction. The rows go in through the indexes, unless there are more of them
+ * than the database already holds, when the indexes are dropped for the load and
+ * built again at the end.
+ */
+
+class DiskTransfer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Mode { MODE_EXPORT, MODE_IMPORT, MODE_MERGE };
+
+    DiskTransfer(Mode mode, const QString& fileName, qint64 id); // id is the disk to export, or the catalogue to import into
+
+    Mode getMode() const { return mode; }
+    int getError() const { return savedError; }
+    const QList<qint64>& getNewDiskIDs() const { return newDiskIDs; }
+    void abort();
+
+    const static int ERROR_VERSION = 310;
+
+public slots:
+    void go();
+
+signals:
+    void progress(qint64 numObjects);
+    void finished(bool ok);
+
+private:
+    void exportDisk(); // throws int
+    void importDisk(); // throws int
+    void mergeDatabase(); // throws int
+    void dropIndexes(QSqlQuery& query); // throws int
+    void createIndexes(QSqlQuery& query); // throws int
+    qint64 liveRows(QSqlQuery& query, const QString& schema); // throws int
+    static bool worthRebuildingIndexes(qint64 incomingRows, qint64 existingRows);
+    void maxIDs(QSqlQuery& query, qint64& maxDirID, qint64& maxFileID); // throws int
+    void countObject();
+
+    Mode mode;
+    QString fileName;
+    qint64 id;
+    DB* tdb = NULL;
+    bool inTransaction = false;
+    bool attached = false;
+    bool abortNow = false;
+    qint64 numObjects = 0;
+    int savedError = 0;
+    QList<qint64> newDiskIDs;
+
+    const static quint64 FORMAT_VERSION = 1;
+};
+
+#endif // DISKTRANSFER_H
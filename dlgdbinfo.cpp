@@ -16,16 +16,27 @@
  */
 
 #include <QProgressDialog>
-#include <QThread>
 #include <QDebug>
 
 #include "globals.h"
-#include "db.h"
-#include "backgroundtask.h"
+#include "taskscheduler.h"
+#include "utils.h"
+#include "compactor.h"
 
 #include "dlgdbinfo.h"
 #include "ui_dlgdbinfo.h"
 
+namespace
+{
+QString freePagesText(const DBStats& dbstats)
+{
+    double percent = dbstats.pageCount ? (100.0 * dbstats.freePages / dbstats.pageCount) : 0.0;
+    return QLocale(QLocale::English).toString(dbstats.freePages) + " of " +
+           QLocale(QLocale::English).toString(dbstats.pageCount) + " pages free (" +
+           QLocale(QLocale::English).toString(percent, 'f', 1) + "%)";
+}
+}
+
 DlgDBInfo::DlgDBInfo(QWidget *parent) :
     QDialog(parent),
     ui(new Ui::DlgDBInfo)
@@ -33,6 +44,23 @@ DlgDBInfo::DlgDBInfo(QWidget *parent) :
     ui->setupUi(this);
     setWindowFlag(Qt::WindowContextHelpButtonHint, false);
 
+    showStats();
+    ui->lCompactResult->clear();
+}
+
+DlgDBInfo::~DlgDBInfo()
+{
+    delete ui;
+}
+
+void DlgDBInfo::refuseCompaction(const QString& reason)
+{
+    ui->bCompact->setEnabled(false);
+    ui->lCompactResult->setText(reason);
+}
+
+DBStats DlgDBInfo::showStats()
+{
     ui->ldbFileName->setText(db.getFileName());
     DBStats dbstats = db.getStats();
     ui->ldbFileSize->setText(fileSizeToHR(dbstats.size));
@@ -40,39 +68,73 @@ DlgDBInfo::DlgDBInfo(QWidget *parent) :
     ui->lNumDisks->setText(QLocale(QLocale::English).toString(dbstats.numDisks));
     ui->lNumDirs->setText(QLocale(QLocale::English).toString(dbstats.numDirs));
     ui->lNumFiles->setText(QLocale(QLocale::English).toString(dbstats.numFiles));
-}
+    ui->lFreePages->setText(freePagesText(dbstats));
 
-DlgDBInfo::~DlgDBInfo()
-{
-    delete ui;
+    if (dbstats.autoVacuum == 2) ui->lAutoVacuum->setText("Free pages are released in the background");
+    else if (dbstats.autoVacuum == 1) ui->lAutoVacuum->setText("Free pages are released on every commit");
+    else ui->lAutoVacuum->setText("Off. Compact once to switch it on");
+
+    return dbstats;
 }
 
 void DlgDBInfo::on_bCompact_clicked()
 {
-    progressDialog = new QProgressDialog("Compacting database...", QString(), 0, 0, this);
+    beforeStats = db.getStats();
+    ui->lCompactResult->clear();
+    ui->bCompact->setEnabled(false);
+
+    emit compactionStarting(); // Nothing may write to the database until the copy is swapped in
+
+    progressDialog = new QProgressDialog("Compacting database...", "Cancel", 0, 100, this);
     progressDialog->setWindowFlag(Qt::WindowContextHelpButtonHint, false);
     progressDialog->setWindowModality(Qt::WindowModal);
     progressDialog->setMinimumDuration(0);
     progressDialog->setValue(0);
 
-    QThread* thread = new QThread;
-    runningCompactor = new BackgroundTask( [] { db.compact(); } );
-    runningCompactor->moveToThread(thread);
+    runningCompactor = new Compactor(Compactor::tempFileNameFor(db.getFileName()));
+
+    connect(runningCompactor, SIGNAL(progress(int)), this, SLOT(compactorProgress(int)));
+    connect(progressDialog, SIGNAL(canceled()), this, SLOT(compactorAbort()));
+    connect(runningCompactor, SIGNAL(finished(bool)), this, SLOT(compactorFinished(bool)));
 
-    connect(thread, SIGNAL(started()), runningCompactor, SLOT(go()));
-    connect(runningCompactor, SIGNAL(finished()), this, SLOT(compactorFinished()));
-    connect(runningCompactor, SIGNAL(finished()), thread, SLOT(quit()));
-    connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
+    compactorJob = scheduler.submitWorker(TaskScheduler::LANE_BULK, runningCompactor, "Compacting database", [this] { compactorAbort(); });
+}
+
+void DlgDBInfo::compactorAbort()
+{
+    // Runs in the GUI thread, as does compactorFinished, so no race
+    if (runningCompactor) runningCompactor->abort();
+}
 
-    thread->start();
+void DlgDBInfo::compactorProgress(int percent)
+{
+    if (progressDialog) progressDialog->setValue(percent);
+    scheduler.setProgress(compactorJob, percent);
 }
 
-void DlgDBInfo::compactorFinished()
+void DlgDBInfo::compactorFinished(bool ok)
 {
+    scheduler.wait(compactorJob);
+    compactorJob = 0;
+
+    bool aborted = runningCompactor->wasAborted();
+    QString tempFileName = runningCompactor->getTempFileName();
+
     delete runningCompactor;
     delete progressDialog;
     runningCompactor = NULL;
     progressDialog = NULL;
-    DBStats dbstats = db.getStats();
-    ui->ldbFileSize->setText(fileSizeToHR(dbstats.size));
+
+    // Reopens the database on the compacted copy. An abort or failure leaves the original as it was
+    emit compactionFinished(ok ? tempFileName : QString());
+    if (!ok && !aborted) Utils::errorMessageBoxNonBlocking("Compaction failed. The database has not been changed.");
+
+    ui->bCompact->setEnabled(true);
+    if (!db.getDBisOpen()) return;
+
+    DBStats afterStats = showStats();
+    if (!ok) return;
+
+    ui->lCompactResult->setText("Before: " + fileSizeToHR(beforeStats.size) + ", " + freePagesText(beforeStats) +
+                                ". After: " + fileSizeToHR(afterStats.size) + ", " + freePagesText(afterStats) + ".");
 }
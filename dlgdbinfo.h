@@ -20,12 +20,14 @@
 
 #include <QDialog>
 
+#include "db.h"
+
 namespace Ui {
 class DlgDBInfo;
 }
 
 class QProgressDialog;
-class BackgroundTask;
+class Compactor;
 
 class DlgDBInfo : public QDialog
 {
@@ -35,14 +37,26 @@ public:
     explicit DlgDBInfo(QWidget *parent = 0);
     ~DlgDBInfo();
 
+    void refuseCompaction(const QString& reason);
+
+signals:
+    void compactionStarting();
+    void compactionFinished(const QString& tempFileName); // Empty if there is nothing to swap in
+
 private slots:
     void on_bCompact_clicked();
-    void compactorFinished();
+    void compactorAbort();
+    void compactorProgress(int percent);
+    void compactorFinished(bool ok);
 
 private:
     Ui::DlgDBInfo *ui;
     QProgressDialog* progressDialog = NULL;
-    BackgroundTask* runningCompactor = NULL;
+    Compactor* runningCompactor = NULL;
+    quint64 compactorJob = 0;
+    DBStats beforeStats;
+
+    DBStats showStats();
 
 };
 
@@ -20,14 +20,14 @@
 #include "dlgdirproperties.h"
 #include "ui_dlgdirproperties.h"
 
-DlgDirProperties::DlgDirProperties(QWidget *t_parent, DDir* t_dir) :
+DlgDirProperties::DlgDirProperties(QWidget *t_parent, DDir* t_dir, ReachabilityMonitor* t_reachability) :
     QDialog(t_parent),
     ui(new Ui::DlgDirProperties), dir(t_dir)
 {
     ui->setupUi(this);
     setWindowFlag(Qt::WindowContextHelpButtonHint, false);
 
-    dpw = new DirPropertiesWidget(this, dir);
+    dpw = new DirPropertiesWidget(this, dir, t_reachability);
     ui->centralArea->setLayout(new QVBoxLayout());
     ui->centralArea->layout()->addWidget(dpw);
 }
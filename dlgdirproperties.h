@@ -26,13 +26,14 @@ class DlgDirProperties;
 
 class DirPropertiesWidget;
 class DDir;
+class ReachabilityMonitor;
 
 class DlgDirProperties : public QDialog
 {
     Q_OBJECT
 
 public:
-    explicit DlgDirProperties(QWidget *parent, DDir* dir);
+    explicit DlgDirProperties(QWidget *parent, DDir* dir, ReachabilityMonitor* reachability);
     ~DlgDirProperties();
 
 private:
@@ -17,18 +17,39 @@
 
 #include <QDateTime>
 #include <QDebug>
+#include <QTreeWidgetItem>
+#include <algorithm>
 
 #include "globals.h"
+#include "noderoot.h"
 #include "nodecatalogue.h"
 #include "nodedisk.h"
 #include "ddir.h"
 #include "utils.h"
 #include "dirpropertieswidget.h"
+#include "taskscheduler.h"
+#include "statsbuilder.h"
 
 #include "dlgdiskdirproperties.h"
 #include "ui_diskdirproperties.h"
 
-DlgDiskDirProperties::DlgDiskDirProperties(QWidget *t_parent, NodeDisk* t_disk) :
+namespace
+{
+    const int MAX_EXTENSIONS_SHOWN = 50;
+
+    QTreeWidgetItem* addStatsItem(QTreeWidgetItem* parent, const QString& name, qint64 numFiles, qint64 totalSize, qint64 allSize)
+    {
+        QTreeWidgetItem* item = new QTreeWidgetItem(parent);
+        item->setText(0, name);
+        item->setText(1, QLocale(QLocale::English).toString(numFiles));
+        item->setText(2, fileSizeToHR(totalSize));
+        if (allSize > 0) item->setText(3, QString::number(100.0 * static_cast<double>(totalSize) / static_cast<double>(allSize), 'f', 1) + "%");
+        for (int column = 1; column < 4; column++) item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+        return item;
+    }
+}
+
+DlgDiskDirProperties::DlgDiskDirProperties(QWidget *t_parent, NodeDisk* t_disk, ReachabilityMonitor* t_reachability) :
     QDialog(t_parent), ui(new Ui::DiskDirProperties), disk(t_disk),
     diskIcon(QIcon::fromTheme("media-floppy")),
     diskPixmap(diskIcon.pixmap(100, 100))
@@ -76,15 +97,23 @@ DlgDiskDirProperties::DlgDiskDirProperties(QWidget *t_parent, NodeDisk* t_disk)
 
     ddir = new DDir(disk->getRootDirID());
     if (!ddir->loadFromDB()) Utils::errorMessageBox("Database error");
-    ddir->loadFromFileSystem();
 
-    dpw = new DirPropertiesWidget(this, ddir);
+    dpw = new DirPropertiesWidget(this, ddir, t_reachability);
     ui->tab2CentralArea->setLayout(new QVBoxLayout());
     ui->tab2CentralArea->layout()->addWidget(dpw);
+
+    // --- Statistics, worked out the first time the tab is looked at
+
+    ui->comboStatsScope->addItem("This disk");
+    NodeCatalogue* statsCat = Node::getRootNode()->catFromID(disk->getCatID());
+    if (statsCat) ui->comboStatsScope->addItem("Catalogue: " + statsCat->getName());
+    connect(ui->tabWidget, SIGNAL(currentChanged(int)), this, SLOT(tabChanged(int)));
+    connect(ui->comboStatsScope, SIGNAL(currentIndexChanged(int)), this, SLOT(statsScopeChanged(int)));
 }
 
 DlgDiskDirProperties::~DlgDiskDirProperties()
 {
+    stopBuilder();
     delete ui;
     delete ddir;
 }
@@ -100,3 +129,124 @@ void DlgDiskDirProperties::done(int code)
 
     QDialog::done(code);
 }
+
+void DlgDiskDirProperties::tabChanged(int index)
+{
+    if ((ui->tabWidget->widget(index) == ui->tab_3) && !statsShown) startBuilder();
+}
+
+void DlgDiskDirProperties::statsScopeChanged(int)
+{
+    if (statsShown) startBuilder();
+}
+
+void DlgDiskDirProperties::startBuilder()
+{
+    stopBuilder();
+    statsShown = true;
+    ui->treeStats->clear();
+
+    QVector<qint64> diskIDs;
+    NodeCatalogue* statsCat = Node::getRootNode()->catFromID(disk->getCatID());
+    if ((ui->comboStatsScope->currentIndex() == 1) && statsCat)
+    {
+        for (qint64 i = 0; i < statsCat->numChildren(); i++) diskIDs.append(statsCat->getChild(i)->getID());
+    }
+    else
+    {
+        diskIDs.append(disk->getID());
+    }
+
+    // Quick if the disks have been catalogued since statistics were added, otherwise one pass over their files
+    ui->lStatsStatus->setText("Working out statistics...");
+    runningBuilder = new StatsBuilder(diskIDs);
+    connect(runningBuilder, SIGNAL(finished(bool)), this, SLOT(builderFinished(bool)));
+    StatsBuilder* builder = runningBuilder;
+    builderJob = scheduler.submitWorker(TaskScheduler::LANE_BULK, runningBuilder, "Disk statistics", [builder] { builder->abort(); });
+}
+
+void DlgDiskDirProperties::stopBuilder()
+{
+    if (!runningBuilder) return;
+
+    disconnect(runningBuilder, NULL, this, NULL);
+    runningBuilder->abort();
+    scheduler.wait(builderJob);
+    delete runningBuilder;
+    runningBuilder = NULL;
+    builderJob = 0;
+}
+
+void DlgDiskDirProperties::builderFinished(bool ok)
+{
+    scheduler.wait(builderJob); // go() may still be returning
+    QVector<DiskStatsRow> rows = runningBuilder->getRows();
+    delete runningBuilder;
+    runningBuilder = NULL;
+    builderJob = 0;
+
+    if (!ok)
+    {
+        ui->lStatsStatus->setText("Database error while working out statistics");
+        return;
+    }
+
+    qint64 allFiles = -1;
+    qint64 allSize = 0;
+    QVector<DiskStatsRow> groups;
+    QVector<DiskStatsRow> extensions;
+    QVector<DiskStatsRow> sizes;
+    for (const DiskStatsRow& row : rows)
+    {
+        if (row.kind == DiskStats::KIND_TOTAL)
+        {
+            allFiles = row.numFiles;
+            allSize = row.totalSize;
+        }
+        else if (row.kind == DiskStats::KIND_GROUP) groups.append(row);
+        else if (row.kind == DiskStats::KIND_EXTENSION) extensions.append(row);
+        else if (row.kind == DiskStats::KIND_SIZE) sizes.append(row);
+    }
+
+    if (allFiles < 0)
+    {
+        ui->lStatsStatus->setText("No statistics"); // Cancelled, or a catalogue with no disks
+        return;
+    }
+
+    auto bySize = [] (const DiskStatsRow& a, const DiskStatsRow& b) { return a.totalSize > b.totalSize; };
+    std::sort(groups.begin(), groups.end(), bySize);
+    std::sort(extensions.begin(), extensions.end(), bySize);
+    std::sort(sizes.begin(), sizes.end(), [] (const DiskStatsRow& a, const DiskStatsRow& b) { return a.key.toInt() < b.key.toInt(); });
+
+    QTreeWidgetItem* section = new QTreeWidgetItem(ui->treeStats, QStringList("By type"));
+    for (const DiskStatsRow& row : groups) addStatsItem(section, row.key, row.numFiles, row.totalSize, allSize);
+    section->setExpanded(true);
+
+    // The long tail of rare extensions goes into one line
+    section = new QTreeWidgetItem(ui->treeStats, QStringList("By extension"));
+    qint64 restFiles = 0;
+    qint64 restSize = 0;
+    for (int i = 0; i < extensions.size(); i++)
+    {
+        if (i < MAX_EXTENSIONS_SHOWN)
+        {
+            addStatsItem(section, extensions[i].key, extensions[i].numFiles, extensions[i].totalSize, allSize);
+        }
+        else
+        {
+            restFiles += extensions[i].numFiles;
+            restSize += extensions[i].totalSize;
+        }
+    }
+    if (restFiles) addStatsItem(section, QString("%1 other extensions").arg(extensions.size() - MAX_EXTENSIONS_SHOWN), restFiles, restSize, allSize);
+
+    section = new QTreeWidgetItem(ui->treeStats, QStringList("By size"));
+    for (const DiskStatsRow& row : sizes) addStatsItem(section, DiskStats::sizeBucketName(row.key.toInt()), row.numFiles, row.totalSize, allSize);
+    section->setExpanded(true);
+
+    for (int column = 0; column < 4; column++) ui->treeStats->resizeColumnToContents(column);
+
+    QLocale locale(QLocale::English);
+    ui->lStatsStatus->setText(QString("%1 files, %2").arg(locale.toString(allFiles), fileSizeToHR(allSize)));
+}
@@ -28,13 +28,15 @@ class DiskDirProperties;
 class NodeDisk;
 class DirPropertiesWidget;
 class DDir;
+class StatsBuilder;
+class ReachabilityMonitor;
 
 class DlgDiskDirProperties : public QDialog
 {
     Q_OBJECT
 
 public:
-    explicit DlgDiskDirProperties(QWidget *parent, NodeDisk* disk);
+    explicit DlgDiskDirProperties(QWidget *parent, NodeDisk* disk, ReachabilityMonitor* reachability);
     ~DlgDiskDirProperties();
 
 private:
@@ -45,8 +47,19 @@ private:
     DirPropertiesWidget* dpw;
     DDir* ddir;
 
+    StatsBuilder* runningBuilder = NULL;
+    quint64 builderJob = 0;
+    bool statsShown = false;
+    void startBuilder();
+    void stopBuilder();
+
 public slots:
     void done(int);
+
+private slots:
+    void tabChanged(int index);
+    void statsScopeChanged(int index);
+    void builderFinished(bool ok);
 };
 
 #endif // DLGDISKDIRPROPERTIES_H
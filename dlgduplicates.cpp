@@ -0,0 +1,121 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QHeaderView>
+#include <QLocale>
+
+#include "globals.h"
+#include "taskscheduler.h"
+#include "dupmodel.h"
+#include "searchresult.h"
+#include "utils.h"
+
+#include "dlgduplicates.h"
+#include "ui_dlgduplicates.h"
+
+DlgDuplicates::DlgDuplicates(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::DlgDuplicates)
+{
+    ui->setupUi(this);
+    setWindowFlag(Qt::WindowContextHelpButtonHint, false);
+
+    qRegisterMetaType<QVector<DupGroup>>("QVector<DupGroup>");
+
+    model = new DupModel(this);
+    ui->tableView->setModel(model);
+    ui->tableView->verticalHeader()->hide();
+    ui->tableView->setShowGrid(false);
+    ui->tableView->setColumnWidth(0, 60);
+    ui->tableView->setColumnWidth(1, 220);
+    ui->tableView->setColumnWidth(2, 300);
+    updateSummary();
+}
+
+DlgDuplicates::~DlgDuplicates()
+{
+    stopFinder();
+    delete ui;
+}
+
+void DlgDuplicates::on_bFind_clicked()
+{
+    if (runningFinder)
+    {
+        runningFinder->abort();
+        return;
+    }
+
+    model->clear();
+
+    runningFinder = new DupFinder(static_cast<qint64>(ui->spinMinSize->value()) * 1024, ui->checkCrossDisk->isChecked(),
+                                  ui->checkDirectories->isChecked());
+    connect(runningFinder, SIGNAL(groupsFound(QVector<DupGroup>)), this, SLOT(finderGroups(QVector<DupGroup>)));
+    connect(runningFinder, SIGNAL(finished(bool)), this, SLOT(finderFinished(bool)));
+
+    ui->bFind->setText("Stop");
+    ui->lSummary->setText("Searching...");
+    DupFinder* finder = runningFinder;
+    finderJob = scheduler.submitWorker(TaskScheduler::LANE_BULK, runningFinder, "Finding duplicates",
+                                       [finder] { finder->abort(); }, QThread::LowPriority);
+}
+
+void DlgDuplicates::finderGroups(QVector<DupGroup> groups)
+{
+    model->addGroups(groups);
+    updateSummary();
+}
+
+void DlgDuplicates::finderFinished(bool ok)
+{
+    scheduler.wait(finderJob); // go() may still be returning
+    delete runningFinder;
+    runningFinder = NULL;
+    finderJob = 0;
+
+    ui->bFind->setText("Find");
+    updateSummary();
+    if (!ok) Utils::errorMessageBox("Database error while searching for duplicates");
+}
+
+void DlgDuplicates::stopFinder()
+{
+    if (!runningFinder) return;
+
+    disconnect(runningFinder, NULL, this, NULL);
+    runningFinder->abort();
+    scheduler.wait(finderJob);
+    delete runningFinder;
+    runningFinder = NULL;
+    finderJob = 0;
+}
+
+void DlgDuplicates::updateSummary()
+{
+    QLocale locale(QLocale::English);
+    ui->lSummary->setText(QString("%1 groups, %2 items. Reclaimable: %3")
+                          .arg(locale.toString(model->getNumGroups()), locale.toString(model->getNumFiles()),
+                               fileSizeToHR(model->getReclaimable())));
+}
+
+void DlgDuplicates::on_tableView_activated(const QModelIndex& index)
+{
+    if (!index.isValid()) return;
+    SearchResult* sr = model->getLocated(index.row());
+    emit locationRequested(sr->getFullIDLocation());
+}
@@ -0,0 +1,61 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DLGDUPLICATES_H
+#define DLGDUPLICATES_H
+
+#include <QDialog>
+#include <QList>
+#include <QPair>
+#include <QVector>
+
+#include "dupfinder.h"
+
+namespace Ui {
+class DlgDuplicates;
+}
+
+class DupModel;
+
+class DlgDuplicates : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DlgDuplicates(QWidget *parent);
+    ~DlgDuplicates();
+
+signals:
+    void locationRequested(QList<QPair<qint64,qint64>> fullIDLocation);
+
+private slots:
+    void on_bFind_clicked();
+    void on_tableView_activated(const QModelIndex& index);
+    void finderGroups(QVector<DupGroup> groups);
+    void finderFinished(bool ok);
+
+private:
+    Ui::DlgDuplicates *ui;
+    DupModel* model;
+    DupFinder* runningFinder = NULL;
+    quint64 finderJob = 0;
+
+    void stopFinder();
+    void updateSummary();
+};
+
+#endif // DLGDUPLICATES_H
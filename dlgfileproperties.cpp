@@ -17,12 +17,13 @@
 
 #include "dfile.h"
 #include "utils.h"
+#include "reachabilitymonitor.h"
 
 #include "dlgfileproperties.h"
 #include "ui_filepropertiesdialog.h"
 
-DlgFileProperties::DlgFileProperties(QWidget *t_parent, DFile* t_file) :
-    QDialog(t_parent), ui(new Ui::FilePropertiesDialog), file(t_file),
+DlgFileProperties::DlgFileProperties(QWidget *t_parent, DFile* t_file, ReachabilityMonitor* t_reachability) :
+    QDialog(t_parent), ui(new Ui::FilePropertiesDialog), file(t_file), reachability(t_reachability),
     fileIcon(QIcon::fromTheme("file")),
     filePixmap(fileIcon.pixmap(100, 100))
 {
@@ -33,7 +34,6 @@ DlgFileProperties::DlgFileProperties(QWidget *t_parent, DFile* t_file) :
     //ui->lFullPath->setStyleSheet("* { background-color: rgba(0, 0, 0, 0); }");
 
     if (!file->loadFromDB()) Utils::errorMessageBox("Database error");
-    file->loadFromFileSystem();
 
     if (file->getType() == TYPE_FILE)
     {
@@ -60,20 +60,19 @@ DlgFileProperties::DlgFileProperties(QWidget *t_parent, DFile* t_file) :
     if (file->getDiskPath().isEmpty()) ui->lFullPath->setText("/");
     else ui->lFullPath->setText(file->getDiskPath());
 
-    if (file->isReachable())
-    {
-        ui->lReachable->setText("Yes");
-        if (file->getType() == TYPE_FILE) ui->bOpenFile->setEnabled(true);
-    }
-    else
-    {
-        ui->lReachable->setText("No");
-    }
+    showReachability();
+    connect(reachability, SIGNAL(updated()), this, SLOT(showReachability()));
+}
 
-    if (file->isContainerReachable())
-    {
-        ui->bOpenContainer->setEnabled(true);
-    }
+// From the monitor's cache, so a dead mount can't hang the dialog. Shown again as probes answer
+void DlgFileProperties::showReachability()
+{
+    ReachabilityMonitor::PathState ps = reachability->query(file->getRootPath(), file->getFullPath());
+    if (!ps.known) ui->lReachable->setText("Checking...");
+    else ui->lReachable->setText(ps.exists ? "Yes" : "No");
+    ui->bOpenFile->setEnabled(ps.exists && (file->getType() == TYPE_FILE));
+
+    ui->bOpenContainer->setEnabled(reachability->query(file->getRootPath(), file->getContainerPath()).isDir);
 }
 
 DlgFileProperties::~DlgFileProperties()
@@ -29,22 +29,25 @@ class FilePropertiesDialog;
 }
 
 class DFile;
+class ReachabilityMonitor;
 
 class DlgFileProperties : public QDialog
 {
     Q_OBJECT
 
 public:
-    explicit DlgFileProperties(QWidget *parent, DFile* file);
+    explicit DlgFileProperties(QWidget *parent, DFile* file, ReachabilityMonitor* reachability);
     ~DlgFileProperties();
 
 private slots:
     void on_bOpenFile_clicked();
     void on_bOpenContainer_clicked();
+    void showReachability();
 
 private:
     Ui::FilePropertiesDialog *ui;
     DFile* file;
+    ReachabilityMonitor* reachability;
     QIcon fileIcon;
     QPixmap filePixmap;
 };
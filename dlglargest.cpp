@@ -0,0 +1,134 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <QDebug>
+#include <QHeaderView>
+#include <QLocale>
+
+#include "globals.h"
+#include "taskscheduler.h"
+#include "largestfinder.h"
+#include "largestmodel.h"
+#include "searchresult.h"
+#include "node.h"
+#include "nodedisk.h"
+#include "utils.h"
+
+#include "dlglargest.h"
+#include "ui_dlglargest.h"
+
+namespace
+{
+    // Catalogues and the root hold disks, the tree has them all loaded
+    void collectRootDirs(Node* node, QVector<qint64>& rootDirIDs)
+    {
+        if (node->getType() == TYPE_DIR)
+        {
+            rootDirIDs.append(node->getID());
+        }
+        else if (node->getType() == TYPE_DISK)
+        {
+            rootDirIDs.append(static_cast<NodeDisk*>(node)->getRootDirID());
+        }
+        else
+        {
+            for (qint64 i = 0; i < node->numChildren(); i++) collectRootDirs(node->getChild(i), rootDirIDs);
+        }
+    }
+}
+
+DlgLargest::DlgLargest(QWidget *parent, Node* scope) :
+    QDialog(parent),
+    ui(new Ui::DlgLargest),
+    wholeDatabase(scope->getType() == TYPE_ROOT)
+{
+    ui->setupUi(this);
+    setWindowFlag(Qt::WindowContextHelpButtonHint, false);
+
+    collectRootDirs(scope, rootDirIDs);
+    if (wholeDatabase) setWindowTitle("Largest Items in the Database");
+    else setWindowTitle("Largest Items in " + scope->getName());
+
+    model = new LargestModel(this);
+    ui->tableView->setModel(model);
+    ui->tableView->verticalHeader()->hide();
+    ui->tableView->setShowGrid(false);
+    ui->tableView->setColumnWidth(0, 260);
+    ui->tableView->setColumnWidth(1, 340);
+
+    on_bFind_clicked();
+}
+
+DlgLargest::~DlgLargest()
+{
+    stopFinder();
+    delete ui;
+}
+
+void DlgLargest::on_bFind_clicked()
+{
+    if (runningFinder)
+    {
+        runningFinder->abort();
+        return;
+    }
+
+    model->clear();
+
+    runningFinder = new LargestFinder(rootDirIDs, wholeDatabase, ui->comboShow->currentIndex() == 1, ui->spinCount->value());
+    connect(runningFinder, SIGNAL(finished(bool)), this, SLOT(finderFinished(bool)));
+
+    ui->bFind->setText("Stop");
+    ui->lSummary->setText("Searching...");
+    LargestFinder* finder = runningFinder;
+    finderJob = scheduler.submitWorker(TaskScheduler::LANE_BULK, runningFinder, "Finding largest items",
+                                       [finder] { finder->abort(); });
+}
+
+void DlgLargest::finderFinished(bool ok)
+{
+    scheduler.wait(finderJob); // go() may still be returning
+    model->setItems(runningFinder->getItems());
+    delete runningFinder;
+    runningFinder = NULL;
+    finderJob = 0;
+
+    ui->bFind->setText("Find");
+    ui->lSummary->setText(QString("%1 items, %2 in total").arg(QLocale(QLocale::English).toString(model->rowCount()),
+                                                              fileSizeToHR(model->getTotalSize())));
+    if (!ok) Utils::errorMessageBox("Database error while finding the largest items");
+}
+
+void DlgLargest::stopFinder()
+{
+    if (!runningFinder) return;
+
+    disconnect(runningFinder, NULL, this, NULL);
+    runningFinder->abort();
+    scheduler.wait(finderJob);
+    delete runningFinder;
+    runningFinder = NULL;
+    finderJob = 0;
+}
+
+void DlgLargest::on_tableView_activated(const QModelIndex& index)
+{
+    if (!index.isValid()) return;
+    SearchResult* sr = model->getLocated(index.row());
+    emit locationRequested(sr->getFullIDLocation());
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DLGLARGEST_H
+#define DLGLARGEST_H
+
+#include <QDialog>
+#include <QList>
+#include <QPair>
+#include <QVector>
+
+namespace Ui {
+class DlgLargest;
+}
+
+class Node;
+class LargestModel;
+class LargestFinder;
+
+class DlgLargest : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DlgLargest(QWidget *parent, Node* scope);
+    ~DlgLargest();
+
+signals:
+    void locationRequested(QList<QPair<qint64,qint64>> fullIDLocation);
+
+private slots:
+    void on_bFind_clicked();
+    void on_tableView_activated(const QModelIndex& index);
+    void finderFinished(bool ok);
+
+private:
+    Ui::DlgLargest *ui;
+    LargestModel* model;
+    LargestFinder* runningFinder = NULL;
+    quint64 finderJob = 0;
+
+    QVector<qint64> rootDirIDs; // Where the scope's tree starts
+    bool wholeDatabase;
+
+    void stopFinder();
+};
+
+#endif // DLGLARGEST_H
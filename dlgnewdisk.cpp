@@ -21,6 +21,7 @@
 #include <QStorageInfo>
 
 #include "globals.h"
+#include "excluderules.h"
 #include "nodecatalogue.h"
 #include "noderoot.h"
 #include "utils.h"
@@ -46,6 +47,10 @@ DlgNewDisk::DlgNewDisk(QWidget *parent, qint64 preSelectCat) :
         if (cat->getID() == preSelectCat) setIndex = indexCounter;
     });
     ui->comboBox->setCurrentIndex(setIndex);
+
+    ui->comboPriority->setCurrentIndex(settings.value("scanpriority", 0).toInt());
+    ui->spinMaxObjects->setValue(settings.value("scanmaxobjects", 0).toInt());
+    ui->spinMaxMB->setValue(settings.value("scanmaxmb", 0).toInt());
 }
 
 DlgNewDisk::~DlgNewDisk()
@@ -53,13 +58,17 @@ DlgNewDisk::~DlgNewDisk()
     delete ui;
 }
 
-void DlgNewDisk::updateMode(const QString &diskName, const QString &catPath)
+void DlgNewDisk::updateMode(const QString &diskName, const QString &catPath, bool hashContents,
+                            const QString& excludes, int mountPolicy)
 {
     setWindowTitle("Update Disk");
     ui->lNewDiskName->setText("Disk name:");
     ui->lCatalogue->setText("Put disk in catalogue:");
     ui->editNewDiskName->setText(diskName);
     ui->editLocation->setText(catPath);
+    ui->checkHashContents->setChecked(hashContents);
+    ui->editExcludes->setPlainText(excludes);
+    ui->comboMountPolicy->setCurrentIndex(mountPolicy);
 }
 
 qint64 DlgNewDisk::getSelectedCatalogue() const
@@ -77,6 +86,36 @@ QString DlgNewDisk::getScanLocation() const
     return ui->editLocation->text();
 }
 
+bool DlgNewDisk::getHashContents() const
+{
+    return ui->checkHashContents->isChecked();
+}
+
+QString DlgNewDisk::getExcludes() const
+{
+    return ui->editExcludes->toPlainText().trimmed();
+}
+
+int DlgNewDisk::getMountPolicy() const
+{
+    return ui->comboMountPolicy->currentIndex(); // Items are in MountTable::Policy order
+}
+
+int DlgNewDisk::getPriority() const
+{
+    return ui->comboPriority->currentIndex(); // Items are in ScanPriority::Priority order
+}
+
+qint64 DlgNewDisk::getMaxObjects() const
+{
+    return ui->spinMaxObjects->value();
+}
+
+qint64 DlgNewDisk::getMaxMB() const
+{
+    return ui->spinMaxMB->value();
+}
+
 void DlgNewDisk::on_chooseLocation_clicked()
 {
     QString fileName = QFileDialog::getOpenFileName(
@@ -136,6 +175,13 @@ void DlgNewDisk::done(int code)
                 return;
             }
 
+            QString badLine;
+            if (!ExcludeRules().compile(getExcludes(), &badLine))
+            {
+                Utils::errorMessageBox("Exclusion rule not understood: " + badLine);
+                return;
+            }
+
             if (QDir(ui->editLocation->text()).isEmpty())
             {
                 QMessageBox msgBox(this);
@@ -31,10 +31,17 @@ class DlgNewDisk : public QDialog
 public:
     explicit DlgNewDisk(QWidget *parent, qint64 preSelectCat);
     ~DlgNewDisk();
-    void updateMode(const QString& diskName, const QString& catPath);
+    void updateMode(const QString& diskName, const QString& catPath, bool hashContents,
+                    const QString& excludes, int mountPolicy);
     qint64 getSelectedCatalogue() const;
     QString getNewDiskName() const;
     QString getScanLocation() const;
+    bool getHashContents() const;
+    QString getExcludes() const;
+    int getMountPolicy() const;
+    int getPriority() const;
+    qint64 getMaxObjects() const;
+    qint64 getMaxMB() const;
 
 protected:
     void done(int code);
@@ -0,0 +1,82 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QPushButton>
+
+#include "dlgscanprogress.h"
+#include "ui_dlgscanprogress.h"
+
+DlgScanProgress::DlgScanProgress(QWidget* parent, qint64 maxObjectsPerSec, qint64 maxMBPerSec) :
+    QDialog(parent),
+    ui(new Ui::DlgScanProgress)
+{
+    ui->setupUi(this);
+    setWindowFlag(Qt::WindowContextHelpButtonHint, false);
+    setWindowModality(Qt::WindowModal);
+
+    // Set before the signals are wired up by name, so these don't count as changes
+    ui->spinMaxObjects->blockSignals(true);
+    ui->spinMaxMB->blockSignals(true);
+    ui->spinMaxObjects->setValue(static_cast<int>(maxObjectsPerSec));
+    ui->spinMaxMB->setValue(static_cast<int>(maxMBPerSec));
+    ui->spinMaxObjects->blockSignals(false);
+    ui->spinMaxMB->blockSignals(false);
+
+    setPercent(-1);
+}
+
+DlgScanProgress::~DlgScanProgress()
+{
+    delete ui;
+}
+
+void DlgScanProgress::setLabelText(const QString& text)
+{
+    if (cancelled) return; // Keep showing that it is stopping
+    ui->lStatus->setText(text);
+}
+
+void DlgScanProgress::setPercent(int percent)
+{
+    if (percent < 0)
+    {
+        ui->progressBar->setRange(0, 0);
+        return;
+    }
+    ui->progressBar->setRange(0, 100);
+    ui->progressBar->setValue(percent);
+}
+
+// Cancel button, Esc and the window's close button
+void DlgScanProgress::reject()
+{
+    if (cancelled) return;
+    cancelled = true;
+    ui->lStatus->setText("Stopping...");
+    ui->buttonBox->button(QDialogButtonBox::Cancel)->setEnabled(false);
+    emit canceled();
+}
+
+void DlgScanProgress::on_spinMaxObjects_valueChanged(int)
+{
+    emit limitsChanged(ui->spinMaxObjects->value(), ui->spinMaxMB->value());
+}
+
+void DlgScanProgress::on_spinMaxMB_valueChanged(int)
+{
+    emit limitsChanged(ui->spinMaxObjects->value(), ui->spinMaxMB->value());
+}
@@ -0,0 +1,59 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DLGSCANPROGRESS_H
+#define DLGSCANPROGRESS_H
+
+#include <QDialog>
+
+namespace Ui {
+class DlgScanProgress;
+}
+
+/* Progress for cataloguing. Like a QProgressDialog, but with the scan's speed
+ * limits, which can be changed while it runs. Cancelling doesn't close it, it
+ * stays up until the Cataloguer has stopped and saved what it found.
+ */
+
+class DlgScanProgress : public QDialog
+{
+    Q_OBJECT
+
+public:
+    DlgScanProgress(QWidget* parent, qint64 maxObjectsPerSec, qint64 maxMBPerSec);
+    ~DlgScanProgress();
+
+    void setLabelText(const QString& text);
+    void setPercent(int percent); // -1 shows a busy bar
+
+signals:
+    void canceled();
+    void limitsChanged(qint64 maxObjectsPerSec, qint64 maxMBPerSec); // 0 for no limit
+
+public slots:
+    void reject() override;
+
+private slots:
+    void on_spinMaxObjects_valueChanged(int);
+    void on_spinMaxMB_valueChanged(int);
+
+private:
+    Ui::DlgScanProgress *ui;
+    bool cancelled = false;
+};
+
+#endif // DLGSCANPROGRESS_H
@@ -0,0 +1,148 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <sqlite3.h>
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QSqlQuery>
+#include <QVariant>
+
+#include "globals.h"
+#include "db.h"
+#include "dbpool.h"
+
+#include "dupfinder.h"
+
+DupFinder::DupFinder(qint64 t_minSize, bool t_crossDiskOnly, bool t_directories)
+    : minSize(t_minSize), crossDiskOnly(t_crossDiskOnly), directories(t_directories)
+{
+    if (minSize < 1) minSize = 1; // Empty files are all "duplicates" of each other
+}
+
+void DupFinder::abort()
+{
+    abortNow = true;
+}
+
+bool DupFinder::keepGroup(const DupGroup& group) const
+{
+    if (group.files.size() < 2) return false;
+    if (!crossDiskOnly) return true;
+
+    QSet<qint64> disks;
+    for (const DupFile& file : group.files)
+    {
+        disks.insert(file.diskID);
+        if (disks.size() > 1) return true;
+    }
+    return false;
+}
+
+int DupFinder::progressCallback(void* finder)
+{
+    // Called by SQLite every PROGRESS_OPS virtual machine steps, on the finder thread. The
+    // sort runs inside the first step, so without this a stop would wait for all of it
+    return static_cast<DupFinder*>(finder)->abortNow ? 1 : 0;
+}
+
+void DupFinder::go()
+{
+    DB* fdb = DBPool::connection();
+    bool ok = (fdb != NULL);
+
+    if (ok)
+    {
+        sqlite3* handle = fdb->getSQLiteHandle();
+        if (handle) sqlite3_progress_handler(handle, PROGRESS_OPS, &DupFinder::progressCallback, this);
+        else qDebug() << "DupFinder: no SQLite handle, stop takes effect once the query has sorted";
+
+        QSqlQuery query(fdb->getqdb());
+        query.setForwardOnly(true);
+
+        if (directories)
+        {
+            // A directory whose parent is itself duplicated is part of a bigger match, so leave it out
+            ok = query.exec(QString(
+                "with dup as (select d.digest from directories as d join disks as k on d.diskid = k.id "
+                "where d.digest is not null and d.totalsize >= %1 and k.deleted = 0 "
+                "group by d.digest having count(*) > 1) "
+                "select d.totalsize, hex(d.digest) as matchkey, 1, "
+                "d.id, d.parent, d.diskid, coalesce(d.name, k.name) "
+                "from directories as d "
+                "join disks as k on d.diskid = k.id "
+                "where k.deleted = 0 and d.digest in dup "
+                "and not exists (select 1 from directories as p where p.id = d.parent and p.digest in dup) "
+                "order by d.totalsize desc, matchkey").arg(minSize));
+        }
+        else
+        {
+            // Files with a stored hash group on it, the rest on their name
+            ok = query.exec(QString(
+                "select f.size, coalesce(hex(f.hash), 'n:' || f.name) as matchkey, f.hash is not null, "
+                "f.id, f.dirid, d.diskid, f.name "
+                "from files as f "
+                "join directories as d on f.dirid = d.id "
+                "join disks as k on d.diskid = k.id "
+                "where f.type = %1 and f.size >= %2 and k.deleted = 0 "
+                "and f.size in (select size from files where size >= %2 group by size having count(*) > 1) "
+                "order by f.size desc, matchkey").arg(TYPE_FILE).arg(minSize));
+        }
+
+        if (!ok && !abortNow) qDebug() << "DupFinder: query failed";
+
+        QVector<DupGroup> batch;
+        DupGroup current { directories ? TYPE_DIR : TYPE_FILE, -1, false, {} };
+        QString currentKey;
+        QElapsedTimer sinceEmit;
+        sinceEmit.start();
+
+        while (ok && !abortNow && query.next())
+        {
+            qint64 size = query.value(0).toLongLong();
+            QString key = query.value(1).toString();
+
+            if ((size != current.size) || (key != currentKey))
+            {
+                if (keepGroup(current)) batch.append(current);
+                current.size = size;
+                current.byHash = query.value(2).toBool();
+                current.files.clear();
+                currentKey = key;
+            }
+
+            current.files.append({ query.value(3).toLongLong(), query.value(4).toLongLong(),
+                                   query.value(5).toLongLong(), query.value(6).toString() });
+
+            if (!batch.isEmpty() && (sinceEmit.elapsed() > EMIT_EVERY_MS))
+            {
+                emit groupsFound(batch);
+                batch.clear();
+                sinceEmit.restart();
+            }
+        }
+
+        if (ok && !abortNow && keepGroup(current)) batch.append(current);
+        if (!batch.isEmpty()) emit groupsFound(batch);
+
+        query.finish();
+        if (handle) sqlite3_progress_handler(handle, 0, NULL, NULL); // The connection is pooled, don't leave this behind
+    }
+
+    emit finished(ok || abortNow); // An interrupted query is a stop, not an error
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DUPFINDER_H
+#define DUPFINDER_H
+
+#include <QObject>
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+
+class DB;
+
+// A file, or with directory matching a directory, in which case dirID is its parent
+struct DupFile
+{
+    qint64 id;
+    qint64 dirID;
+    qint64 diskID;
+    QString name;
+};
+
+struct DupGroup
+{
+    int type;     // TYPE_FILE or TYPE_DIR
+    qint64 size;
+    bool byHash;  // Matched on content hash, otherwise on name and size
+    QVector<DupFile> files;
+};
+
+Q_DECLARE_METATYPE(DupGroup)
+
+/* Finds groups of duplicate files across all disks. The database does the
+ * heavy lifting as one ordered scan: candidate sizes come from the size index,
+ * and rows of those sizes are sorted by (size, hash or name) so that each group
+ * is a run of adjacent rows. SQLite spills that sort to temporary storage, so
+ * memory use does not depend on the number of files, only on the biggest group.
+ *
+ * With directories selected it does the same over the subtree digests the
+ * Cataloguer stores, reporting only the top of each identical tree rather than
+ * every matching directory inside it.
+ *
+ * A stop interrupts the query through an SQLite progress handler, as the
+ * Compactor does, so it doesn't wait for the sort to finish.
+ */
+
+class DupFinder : public QObject
+{
+    Q_OBJECT
+
+public:
+    DupFinder(qint64 minSize, bool crossDiskOnly, bool directories);
+
+    void abort();
+
+public slots:
+    void go();
+
+signals:
+    void groupsFound(QVector<DupGroup> groups);
+    void finished(bool ok);
+
+private:
+    bool keepGroup(const DupGroup& group) const;
+    static int progressCallback(void* finder);
+
+    qint64 minSize;
+    bool crossDiskOnly;
+    bool directories;
+    bool abortNow = false;
+
+    const static int EMIT_EVERY_MS = 250;
+    const static int PROGRESS_OPS = 10000;
+};
+
+#endif // DUPFINDER_H
@@ -0,0 +1,150 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+
+#include "globals.h"
+#include "searchresult.h"
+
+#include "dupmodel.h"
+
+DupModel::DupModel(QObject* parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+DupModel::~DupModel()
+{
+    for (Row& row : rows) delete row.sr;
+}
+
+QVariant DupModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal) return QVariant();
+    if (role != Qt::DisplayRole) return QVariant();
+
+    switch(section)
+    {
+        case 0:
+            return "Group";
+        case 1:
+            return "Name";
+        case 2:
+            return "Location";
+        case 3:
+            return "Size";
+        case 4:
+            return "Match";
+    }
+
+    return QVariant();
+}
+
+int DupModel::rowCount(const QModelIndex& /*parent*/) const
+{
+    return rows.size();
+}
+
+int DupModel::columnCount(const QModelIndex& /*parent*/) const
+{
+    return 5;
+}
+
+QVariant DupModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid()) return QVariant();
+    const Row& row = rows[index.row()];
+
+    if (role == Qt::DisplayRole)
+    {
+        switch(index.column())
+        {
+            case 0:
+                return row.group;
+            case 1:
+                return row.sr->getName();
+            case 2:
+                return getLocated(index.row())->getLocation();
+            case 3:
+                return fileSizeToHR(row.size);
+            case 4:
+                if (row.type == TYPE_DIR) return "Directory tree";
+                return row.byHash ? "Content" : "Name and size";
+        }
+    }
+    else if (role == Qt::DecorationRole)
+    {
+        if (index.column() == 1) return (row.type == TYPE_DIR) ? dirIcon : fileIcon;
+    }
+    else if (role == ROLE_ID)
+    {
+        return row.sr->getID();
+    }
+    else if (role == ROLE_TYPE)
+    {
+        return row.type;
+    }
+
+    return QVariant();
+}
+
+SearchResult* DupModel::getLocated(int rowNum) const
+{
+    Row& row = rows[rowNum];
+    if (!row.located)
+    {
+        row.sr->calcLocation();
+        row.located = true;
+    }
+    return row.sr;
+}
+
+void DupModel::addGroups(const QVector<DupGroup>& groups)
+{
+    int numNewRows = 0;
+    for (const DupGroup& group : groups) numNewRows += group.files.size();
+    if (numNewRows == 0) return;
+
+    beginInsertRows(QModelIndex(), rows.size(), rows.size() + numNewRows - 1);
+    for (const DupGroup& group : groups)
+    {
+        ++numGroups;
+        reclaimable += group.size * (group.files.size() - 1);
+
+        for (const DupFile& file : group.files)
+        {
+            SearchResult* sr = new SearchResult();
+            sr->setType(group.type);
+            sr->setID(file.id);
+            QString name = file.name;
+            sr->setName(name);
+            sr->setParentDirID(file.dirID);
+            rows.append({ group.type, numGroups, group.size, group.byHash, sr, false });
+        }
+    }
+    endInsertRows();
+}
+
+void DupModel::clear()
+{
+    beginResetModel();
+    for (Row& row : rows) delete row.sr;
+    rows.clear();
+    numGroups = 0;
+    reclaimable = 0;
+    endResetModel();
+}
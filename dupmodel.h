@@ -0,0 +1,67 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DUPMODEL_H
+#define DUPMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+
+#include "dupfinder.h"
+
+class SearchResult;
+
+// One row per duplicate file, groups kept together in the order the DupFinder streams them
+class DupModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit DupModel(QObject* parent = nullptr);
+    ~DupModel();
+
+    qint64 getNumGroups() const { return numGroups; }
+    qint64 getNumFiles() const { return rows.size(); }
+    qint64 getReclaimable() const { return reclaimable; }
+
+    virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    virtual int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    void addGroups(const QVector<DupGroup>& groups);
+    void clear();
+    SearchResult* getLocated(int row) const;
+
+private:
+    struct Row
+    {
+        int type;
+        qint64 group;
+        qint64 size;
+        bool byHash;
+        SearchResult* sr;
+        bool located;
+    };
+
+    // Locations cost a few queries each, so they are only worked out for rows that get displayed
+    mutable QVector<Row> rows;
+    qint64 numGroups = 0;
+    qint64 reclaimable = 0;
+};
+
+#endif // DUPMODEL_H
@@ -0,0 +1,151 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include <QDateTime>
+#include <QStringList>
+
+#include "excluderules.h"
+
+bool ExcludeRules::compile(const QString& rulesText, QString* badLine)
+{
+    static const qint64 sizeMultipliers[] = { 1024LL, 1024LL * 1024, 1024LL * 1024 * 1024, 1024LL * 1024 * 1024 * 1024 };
+    static const qint64 ageMultipliers[] = { 86400, 3600, 60 };
+
+    *this = ExcludeRules();
+
+    QStringList names;
+    QStringList paths;
+    qint64 now = QDateTime::currentDateTime().toSecsSinceEpoch();
+
+    for (QString line : rulesText.split('\n'))
+    {
+        int hash = line.indexOf('#');
+        if (hash >= 0) line.truncate(hash);
+        line = line.trimmed();
+        if (line.isEmpty()) continue;
+
+        qint64 amount;
+        if (line.startsWith("size>") || line.startsWith("size<"))
+        {
+            if (!parseAmount(line.mid(5), "KMGT", sizeMultipliers, amount)) { if (badLine) *badLine = line; return false; }
+            if (line[4] == '>') maxSize = amount;
+            else minSize = amount;
+        }
+        else if (line.startsWith("age>") || line.startsWith("age<"))
+        {
+            // Days if there is no unit
+            if (!parseAmount(line.mid(4), "dhm", ageMultipliers, amount)) { if (badLine) *badLine = line; return false; }
+            if (line.at(line.size() - 1).isDigit()) amount *= 86400;
+            if (line[3] == '>') oldestTime = now - amount;
+            else newestTime = now - amount;
+        }
+        else if (line.contains('/'))
+        {
+            while (line.startsWith('/')) line.remove(0, 1);
+            while (line.endsWith('/')) line.chop(1);
+            if (line.isEmpty()) { if (badLine) *badLine = "/"; return false; }
+            paths.append(globToRegex(line));
+        }
+        else
+        {
+            names.append(globToRegex(line));
+        }
+    }
+
+    hasNames = !names.isEmpty();
+    hasPaths = !paths.isEmpty();
+    if (hasNames)
+    {
+        nameRegex.setPattern("^(?:" + names.join('|') + ")$");
+        nameRegex.optimize();
+    }
+    if (hasPaths)
+    {
+        pathRegex.setPattern("^(?:" + paths.join('|') + ")$");
+        pathRegex.optimize();
+    }
+
+    empty = !hasNames && !hasPaths && (maxSize < 0) && (minSize < 0) && (oldestTime < 0) && (newestTime < 0);
+    return nameRegex.isValid() && pathRegex.isValid();
+}
+
+bool ExcludeRules::excludesDir(const QString& name, const QString& relPath) const
+{
+    if (hasNames && nameRegex.match(name).hasMatch()) return true;
+    if (hasPaths && pathRegex.match(relPath).hasMatch()) return true;
+    return false;
+}
+
+bool ExcludeRules::excludesFile(const QString& name, const QString& relPath, qint64 size, qint64 modTime) const
+{
+    if ((maxSize >= 0) && (size > maxSize)) return true;
+    if ((minSize >= 0) && (size < minSize)) return true;
+    if ((oldestTime >= 0) && (modTime < oldestTime)) return true;
+    if ((newestTime >= 0) && (modTime > newestTime)) return true;
+    return excludesDir(name, relPath);
+}
+
+QString ExcludeRules::globToRegex(const QString& glob)
+{
+    QString regex;
+    for (int i = 0; i < glob.size(); i++)
+    {
+        if (glob[i] == '*')
+        {
+            if (((i + 1) < glob.size()) && (glob[i + 1] == '*'))
+            {
+                // "**/" may also match nothing at all, so **/x matches x at the top as well
+                if (((i + 2) < glob.size()) && (glob[i + 2] == '/')) { regex += "(?:.*/)?"; i += 2; }
+                else { regex += ".*"; i++; }
+            }
+            else
+            {
+                regex += "[^/]*";
+            }
+        }
+        else if (glob[i] == '?')
+        {
+            regex += "[^/]";
+        }
+        else
+        {
+            regex += QRegularExpression::escape(QString(glob[i]));
+        }
+    }
+    return regex;
+}
+
+bool ExcludeRules::parseAmount(const QString& t_text, const char* units, const qint64* multipliers, qint64& result)
+{
+    QString text = t_text.trimmed();
+    qint64 multiplier = 1;
+    if (!text.isEmpty())
+    {
+        const char* unit = strchr(units, text.at(text.size() - 1).toLatin1());
+        if (unit && *unit)
+        {
+            multiplier = multipliers[unit - units];
+            text.chop(1);
+        }
+    }
+
+    bool ok;
+    result = text.toLongLong(&ok) * multiplier;
+    return ok && (result >= 0);
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXCLUDERULES_H
+#define EXCLUDERULES_H
+
+#include <QRegularExpression>
+#include <QString>
+
+/* A disk's exclusion rules, compiled once before a scan into two regular
+ * expressions and a few limits so each directory entry costs at most a couple
+ * of matches. One rule per line, # starts a comment:
+ *
+ *   node_modules, *.tmp     A name pattern. Skips any file or directory of that name
+ *   .git/objects            A pattern containing a slash. Matched against the whole
+ *                           path from the location being catalogued. A leading **
+ *                           and slash matches at any depth
+ *   size>500M, size<1       Skip files larger / smaller than this. K, M, G, T suffixes
+ *   age>365d, age<2h        Skip files modified longer ago / more recently than this.
+ *                           d, h, m (minutes) suffixes, days if none
+ *
+ * In patterns * matches within one path component, ** across components, ? one
+ * character. Excluded directories are not recorded or descended into.
+ */
+
+class ExcludeRules
+{
+public:
+    bool compile(const QString& rulesText, QString* badLine = NULL);
+    bool isEmpty() const { return empty; }
+
+    bool excludesDir(const QString& name, const QString& relPath) const;
+    bool excludesFile(const QString& name, const QString& relPath, qint64 size, qint64 modTime) const;
+
+private:
+    static QString globToRegex(const QString& glob);
+    static bool parseAmount(const QString& text, const char* units, const qint64* multipliers, qint64& result);
+
+    bool empty = true;
+    QRegularExpression nameRegex;
+    QRegularExpression pathRegex;
+    bool hasNames = false;
+    bool hasPaths = false;
+    qint64 maxSize = -1;     // Files larger than this are skipped
+    qint64 minSize = -1;     // Files smaller than this are skipped
+    qint64 oldestTime = -1;  // Files modified before this are skipped
+    qint64 newestTime = -1;  // Files modified after this are skipped
+};
+
+#endif // EXCLUDERULES_H
@@ -23,11 +23,15 @@
 #include <QFileDevice>
 
 #include "db.h"
+#include "taskscheduler.h"
+#include "dbwriter.h"
 
 #include "globals.h"
 
 QSettings settings("Loggytronic", "ezcat");
 DB db;
+TaskScheduler scheduler;
+DBWriter dbWriter;
 
 QIcon catalogueIcon;
 QIcon diskIcon;
@@ -30,6 +30,12 @@ extern QSettings settings;
 #include "db.h"
 extern DB db;
 
+class TaskScheduler;
+extern TaskScheduler scheduler;
+
+class DBWriter;
+extern DBWriter dbWriter;
+
 extern QIcon catalogueIcon;
 extern QIcon diskIcon;
 extern QIcon dirIcon;
@@ -38,7 +44,7 @@ extern QIcon fileLinkIcon;
 extern QIcon fileCogIcon;
 
 #define APP_VERSION 0
-#define DB_VERSION 0
+#define DB_VERSION 11
 
 // TableSorter relies on this ordering
 const static int TYPE_INVALID = 0;
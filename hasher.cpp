@@ -0,0 +1,359 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <QAtomicInteger>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QRunnable>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QVariant>
+#include <QVector>
+
+#include "globals.h"
+#include "db.h"
+#include "dbwriter.h"
+#include "ratelimiter.h"
+#include "scanpriority.h"
+
+#include "hasher.h"
+
+namespace
+{
+    struct HashJob
+    {
+        qint64 fileID;
+        QString relPath;
+        qint64 size;
+        qint64 modtime;
+    };
+
+    struct HashResult
+    {
+        qint64 fileID;
+        QString relPath;
+        qint64 size;
+        qint64 modtime;
+        QByteArray hash;
+    };
+
+    struct HashWork
+    {
+        QString rootPath;
+        int priority;
+        RateLimiter* limiter;
+        QVector<HashJob> jobs;
+        QAtomicInt nextJob;
+        QAtomicInt stop;
+        QAtomicInteger<qint64> bytesDone;
+
+        QMutex mutex;
+        QVector<HashResult> results; // Drained by the Hasher thread
+    };
+
+    const int READ_SIZE = 1024 * 1024;
+    const int WRITE_BATCH = 5000; // Rows per transaction
+
+    // O_NOATIME is only allowed on files the user owns (or to root)
+    int openNoAtime(const QString& path)
+    {
+        QByteArray encoded = QFile::encodeName(path);
+        int fd = ::open(encoded.constData(), O_RDONLY | O_NOATIME | O_CLOEXEC);
+        if ((fd < 0) && (errno == EPERM)) fd = ::open(encoded.constData(), O_RDONLY | O_CLOEXEC);
+        return fd;
+    }
+
+    class HashWorker : public QRunnable
+    {
+    public:
+        HashWorker(HashWork* t_work) : work(t_work) {}
+
+        void run() override
+        {
+            std::vector<char> buffer(READ_SIZE);
+            ScanPriority::applyToThisThread(work->priority);
+            bool dropCache = ScanPriority::dropCache(work->priority);
+
+            while (!work->stop.load())
+            {
+                int i = work->nextJob.fetchAndAddRelaxed(1);
+                if (i >= work->jobs.size()) break;
+                const HashJob& job = work->jobs[i];
+
+                int fd = openNoAtime(work->rootPath + job.relPath);
+                if (fd < 0) continue; // Unreadable files are left without a hash
+                QFile file;
+                if (!file.open(fd, QIODevice::ReadOnly | QIODevice::Unbuffered, QFileDevice::AutoCloseHandle))
+                {
+                    ::close(fd);
+                    continue;
+                }
+                ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+                QCryptographicHash hash(QCryptographicHash::Md5);
+                qint64 numRead;
+                while ((numRead = file.read(buffer.data(), READ_SIZE)) > 0)
+                {
+                    hash.addData(buffer.data(), static_cast<int>(numRead));
+                    work->bytesDone.fetchAndAddRelaxed(numRead);
+                    if (work->limiter) work->limiter->take(numRead);
+                    if (work->stop.load()) break;
+                }
+
+                // A file some other program is using comes back in on its next read, which costs
+                // far less than a whole disk's worth of contents pushing everyone's data out
+                if (dropCache) ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+                if ((numRead < 0) || work->stop.load()) continue;
+
+                QMutexLocker locker(&work->mutex);
+                work->results.append({ job.fileID, job.relPath, job.size, job.modtime, hash.result() });
+            }
+        }
+
+    private:
+        HashWork* work;
+    };
+
+    bool writeResults(QSqlQuery& fileQuery, QSqlQuery& memoQuery, qint64 diskID, qint64 seen, const HashResult* results, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            const HashResult& result = results[i];
+            fileQuery.bindValue(":hash", result.hash);
+            fileQuery.bindValue(":id", result.fileID);
+            if (!fileQuery.exec()) return false;
+
+            memoQuery.bindValue(":diskid", diskID);
+            memoQuery.bindValue(":path", result.relPath);
+            memoQuery.bindValue(":size", result.size);
+            memoQuery.bindValue(":modtime", result.modtime);
+            memoQuery.bindValue(":hash", result.hash);
+            memoQuery.bindValue(":seen", seen);
+            if (!memoQuery.exec()) return false;
+        }
+        return true;
+    }
+
+    // Each transaction waits its turn with the GUI's edits, see DBWriter, and is kept short so they don't wait long
+    bool writeBatched(DB* hdb, QSqlQuery& fileQuery, QSqlQuery& memoQuery, qint64 diskID, qint64 seen, const QVector<HashResult>& results)
+    {
+        for (int from = 0; from < results.size(); from += WRITE_BATCH)
+        {
+            dbWriter.beginBulk();
+            bool ok = hdb->startTransaction();
+            if (ok && !writeResults(fileQuery, memoQuery, diskID, seen, results.constData() + from, qMin(WRITE_BATCH, results.size() - from)))
+            {
+                hdb->rollbackTransaction();
+                ok = false;
+            }
+            if (ok) ok = hdb->commitTransaction();
+            dbWriter.endBulk();
+            if (!ok) return false;
+        }
+        return true;
+    }
+
+    bool deleteStale(DB* hdb, qint64 diskID, qint64 seen)
+    {
+        // A page of stale paths at a time, carrying on from the last one, so each page is a seek on the key
+        QSqlQuery staleQuery(hdb->getqdb());
+        staleQuery.setForwardOnly(true);
+        if (!staleQuery.prepare("select path from filehashes where diskid = :diskid and path > :after and seen <> :seen "
+                                "order by path limit :limit")) return false;
+        QSqlQuery deleteQuery(hdb->getqdb());
+        if (!deleteQuery.prepare("delete from filehashes where diskid = :diskid and path = :path")) return false;
+
+        QString after("");
+        while (true)
+        {
+            staleQuery.bindValue(":diskid", diskID);
+            staleQuery.bindValue(":after", after);
+            staleQuery.bindValue(":seen", seen);
+            staleQuery.bindValue(":limit", WRITE_BATCH);
+            if (!staleQuery.exec()) return false;
+            QStringList paths;
+            while (staleQuery.next()) paths.append(staleQuery.value(0).toString());
+            staleQuery.finish();
+            if (paths.isEmpty()) return true;
+
+            dbWriter.beginBulk();
+            bool ok = hdb->startTransaction();
+            for (int i = 0; ok && (i < paths.size()); i++)
+            {
+                deleteQuery.bindValue(":diskid", diskID);
+                deleteQuery.bindValue(":path", paths[i]);
+                ok = deleteQuery.exec();
+            }
+            if (ok) ok = hdb->commitTransaction();
+            else hdb->rollbackTransaction();
+            dbWriter.endBulk();
+            if (!ok) return false;
+
+            if (paths.size() < WRITE_BATCH) return true;
+            after = paths.last();
+        }
+    }
+}
+
+Hasher::Hasher(DB* t_db, qint64 t_diskID, const QString& t_rootPath, const QString& t_device, const bool& t_abortNow)
+    : hdb(t_db), diskID(t_diskID), rootPath(t_rootPath), device(t_device), abortNow(t_abortNow)
+{
+    if (rootPath.endsWith("/")) rootPath.chop(1);
+}
+
+void Hasher::throttle(int t_priority, RateLimiter* t_byteLimiter)
+{
+    priority = t_priority;
+    byteLimiter = t_byteLimiter;
+}
+
+int Hasher::threadsForDevice(const QString& t_device)
+{
+    // /sys/class/block/sda1 links to .../block/sda/sda1 and only the whole disk has a queue directory
+    QFileInfo dev(t_device);
+    QString blockPath = QFileInfo("/sys/class/block/" + QFileInfo(dev.canonicalFilePath()).fileName()).canonicalFilePath();
+    if (blockPath.isEmpty()) return 2; // Not a local block device (network etc.)
+
+    QFile rotational(blockPath + "/queue/rotational");
+    if (!rotational.exists()) rotational.setFileName(blockPath + "/../queue/rotational");
+    if (!rotational.open(QIODevice::ReadOnly)) return 2;
+
+    if (rotational.readAll().trimmed() == "0") return qBound(1, QThread::idealThreadCount(), 4);
+    return 1;
+}
+
+bool Hasher::loadDirPaths(QSqlQuery& query, QHash<qint64, QString>& dirPaths)
+{
+    // Directories are inserted parent first, so in id order each parent's path is already known
+    if (!query.exec(QString("select id, parent, name from directories where diskid = %1 order by id").arg(diskID))) return false;
+    while (query.next())
+    {
+        qint64 parent = query.value(1).toLongLong();
+        if (parent == 0) dirPaths.insert(query.value(0).toLongLong(), QString());
+        else dirPaths.insert(query.value(0).toLongLong(), dirPaths.value(parent) + "/" + query.value(2).toString());
+    }
+    return true;
+}
+
+bool Hasher::run(std::function<void (qint64, qint64, qint64)> progress)
+{
+    QSqlQuery query(hdb->getqdb());
+    query.setForwardOnly(true);
+
+    QHash<qint64, QString> dirPaths;
+    if (!loadDirPaths(query, dirPaths)) return false;
+
+    // Looked up file by file on the (diskid, path) key, so the disk's memo is never held in memory
+    QSqlQuery memoLookup(hdb->getqdb());
+    memoLookup.setForwardOnly(true);
+    if (!memoLookup.prepare("select size, modtime, hash from filehashes where diskid = :diskid and path = :path")) return false;
+
+    HashWork work;
+    work.rootPath = rootPath;
+    work.priority = priority;
+    work.limiter = byteLimiter;
+    QVector<HashResult> unchanged;
+    qint64 bytesTotal = 0;
+
+    if (!query.exec(QString("select files.id, files.dirid, files.name, files.size, files.modtime from files "
+                            "join directories on files.dirid = directories.id "
+                            "where directories.diskid = %1 and files.type = %2").arg(diskID).arg(TYPE_FILE))) return false;
+    while (query.next())
+    {
+        HashJob job { query.value(0).toLongLong(), dirPaths.value(query.value(1).toLongLong()) + "/" + query.value(2).toString(),
+                      query.value(3).toLongLong(), query.value(4).toLongLong() };
+
+        memoLookup.bindValue(":diskid", diskID);
+        memoLookup.bindValue(":path", job.relPath);
+        if (!memoLookup.exec()) return false;
+        if (memoLookup.next() && (memoLookup.value(0).toLongLong() == job.size) && (memoLookup.value(1).toLongLong() == job.modtime))
+        {
+            unchanged.append({ job.fileID, job.relPath, job.size, job.modtime, memoLookup.value(2).toByteArray() });
+        }
+        else
+        {
+            bytesTotal += job.size;
+            work.jobs.append(job);
+        }
+        memoLookup.finish();
+    }
+    query.finish();
+    dirPaths.clear();
+
+    QSqlQuery fileQuery(hdb->getqdb());
+    if (!fileQuery.prepare("update files set hash = :hash where id = :id")) return false;
+    QSqlQuery memoQuery(hdb->getqdb());
+    if (!memoQuery.prepare("insert or replace into filehashes (diskid, path, size, modtime, hash, seen) "
+                           "values (:diskid, :path, :size, :modtime, :hash, :seen)")) return false;
+
+    qint64 seen = QDateTime::currentDateTime().toSecsSinceEpoch();
+
+    if (!writeBatched(hdb, fileQuery, memoQuery, diskID, seen, unchanged)) return false;
+    unchanged.clear();
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadsForDevice(device));
+    for (int i = 0; i < pool.maxThreadCount(); i++) pool.start(new HashWorker(&work));
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    bool ok = true;
+    bool allDone = false;
+
+    while (!allDone)
+    {
+        allDone = pool.waitForDone(PROGRESS_MS);
+        if (abortNow) work.stop.store(1);
+
+        QVector<HashResult> batch;
+        {
+            QMutexLocker locker(&work.mutex);
+            batch.swap(work.results);
+        }
+
+        if (ok && !batch.isEmpty())
+        {
+            ok = writeBatched(hdb, fileQuery, memoQuery, diskID, seen, batch);
+            if (!ok) work.stop.store(1);
+        }
+
+        qint64 bytesDone = work.bytesDone.load();
+        qint64 ms = elapsed.elapsed();
+        progress(bytesDone, bytesTotal, (ms > 0) ? (bytesDone * 1000 / ms) : 0);
+    }
+
+    if (!ok) return false;
+
+    // Forget files that no longer exist, unless the pass was cut short
+    if (!work.stop.load()) return deleteStale(hdb, diskID, seen);
+    return true;
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HASHER_H
+#define HASHER_H
+
+#include <functional>
+#include <QHash>
+#include <QString>
+
+class DB;
+class QSqlQuery;
+class RateLimiter;
+
+/* Content hashing pass, run by the Cataloguer after a disk has been catalogued.
+ * Files are read with large sequential reads on a small pool of threads sized
+ * for the device (one for spinning disks, so the heads are not thrown about).
+ * Hashes are remembered by path, size and modtime in the filehashes table, so
+ * re-cataloguing only reads files that have changed. Files are opened with
+ * O_NOATIME where the owner allows it, so hashing doesn't change the disk.
+ */
+
+class Hasher
+{
+public:
+    Hasher(DB* db, qint64 diskID, const QString& rootPath, const QString& device, const bool& abortNow);
+    void throttle(int priority, RateLimiter* byteLimiter); // ScanPriority, and a limiter shared by the hashing threads
+
+    // Progress is called about five times a second from the calling thread
+    bool run(std::function<void (qint64 bytesDone, qint64 bytesTotal, qint64 bytesPerSec)> progress);
+
+    static int threadsForDevice(const QString& device);
+
+private:
+    DB* hdb;
+    qint64 diskID;
+    QString rootPath;
+    QString device;
+    const bool& abortNow;
+    int priority = 0;
+    RateLimiter* byteLimiter = NULL;
+
+    bool loadDirPaths(QSqlQuery& query, QHash<qint64, QString>& dirPaths);
+
+    const static int PROGRESS_MS = 200;
+};
+
+#endif // HASHER_H
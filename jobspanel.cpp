@@ -0,0 +1,90 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <QAction>
+#include <QMenu>
+#include <QMessageBox>
+
+#include "globals.h"
+#include "taskscheduler.h"
+
+#include "jobspanel.h"
+
+namespace
+{
+    QString describe(const TaskScheduler::JobInfo& info)
+    {
+        if (!info.running) return info.title + " (waiting)";
+        if (info.percent < 0) return info.title;
+        return QString("%1 (%2%)").arg(info.title).arg(info.percent);
+    }
+}
+
+JobsPanel::JobsPanel(QWidget* parent)
+    : QToolButton(parent)
+{
+    jobsMenu = new QMenu(this);
+    setMenu(jobsMenu);
+    setPopupMode(QToolButton::InstantPopup);
+    setAutoRaise(true);
+    hide();
+
+    connect(jobsMenu, SIGNAL(aboutToShow()), this, SLOT(fillMenu()));
+    connect(jobsMenu, SIGNAL(triggered(QAction*)), this, SLOT(jobPicked(QAction*)));
+    connect(&scheduler, SIGNAL(jobsChanged()), this, SLOT(refresh()));
+}
+
+void JobsPanel::refresh()
+{
+    QVector<TaskScheduler::JobInfo> shown;
+    for (const TaskScheduler::JobInfo& info : scheduler.getJobs())
+    {
+        if (!info.title.isEmpty()) shown.append(info);
+    }
+
+    if (shown.isEmpty())
+    {
+        hide();
+        return;
+    }
+
+    if (shown.size() == 1) setText(describe(shown.first()));
+    else setText(QString("%1 jobs").arg(shown.size()));
+    show();
+}
+
+// Built as it opens so the progress figures are current
+void JobsPanel::fillMenu()
+{
+    jobsMenu->clear();
+    for (const TaskScheduler::JobInfo& info : scheduler.getJobs())
+    {
+        if (info.title.isEmpty()) continue;
+        QAction* action = jobsMenu->addAction(describe(info));
+        action->setData(info.id);
+        action->setEnabled(info.cancellable);
+    }
+}
+
+void JobsPanel::jobPicked(QAction* action)
+{
+    quint64 jobID = action->data().toULongLong();
+    QString title = action->text();
+    if (QMessageBox::question(window(), "Cancel Job", QString("Cancel %1?").arg(title)) != QMessageBox::Yes) return;
+    scheduler.cancel(jobID); // Does nothing if it has finished in the meantime
+}
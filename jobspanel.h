@@ -0,0 +1,48 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef JOBSPANEL_H
+#define JOBSPANEL_H
+
+#include <QToolButton>
+
+class QMenu;
+
+/* The status bar's list of running background jobs. Shows the one job, or how
+ * many there are, and drops down a menu of them all with their progress. Picking
+ * one that can be cancelled asks, then cancels it. Hidden when there are none.
+ * Only jobs submitted to the scheduler with a title are listed.
+ */
+
+class JobsPanel : public QToolButton
+{
+    Q_OBJECT
+
+public:
+    explicit JobsPanel(QWidget* parent = NULL);
+
+private slots:
+    void refresh();
+    void fillMenu();
+    void jobPicked(QAction* action);
+
+private:
+    QMenu* jobsMenu;
+};
+
+#endif // JOBSPANEL_H
@@ -0,0 +1,187 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+
+#include <QDebug>
+
+#include "globals.h"
+#include "db.h"
+#include "dbpool.h"
+#include "sqlstatement.h"
+
+#include "largestfinder.h"
+
+namespace
+{
+    // As the heap's ordering this keeps the smallest item at the front
+    bool biggerFirst(const LargestItem& a, const LargestItem& b)
+    {
+        return a.size > b.size;
+    }
+}
+
+LargestFinder::LargestFinder(const QVector<qint64>& t_rootDirIDs, bool t_wholeDatabase, bool t_directories, int t_limit)
+    : rootDirIDs(t_rootDirIDs), wholeDatabase(t_wholeDatabase), directories(t_directories), limit(t_limit)
+{
+}
+
+void LargestFinder::abort()
+{
+    abortNow = true;
+}
+
+void LargestFinder::go()
+{
+    DB* ldb = DBPool::connection();
+    sqlite3* handle = ldb ? ldb->getSQLiteHandle() : NULL;
+    bool ok = (handle != NULL);
+
+    if (ok && (limit > 0))
+    {
+        if (wholeDatabase && !directories) ok = walkSizeIndex(handle);
+        else ok = walkTree(handle);
+        if (!ok) qDebug() << "LargestFinder: query failed";
+    }
+
+    items = heap;
+    heap.clear();
+    std::sort(items.begin(), items.end(), biggerFirst);
+
+    emit finished(ok);
+}
+
+bool LargestFinder::cannotMakeIt(qint64 size) const
+{
+    return (heap.size() >= limit) && (size <= heap.first().size);
+}
+
+void LargestFinder::offer(const LargestItem& item)
+{
+    if (heap.size() < limit)
+    {
+        heap.append(item);
+        std::push_heap(heap.begin(), heap.end(), biggerFirst);
+        return;
+    }
+
+    if (item.size <= heap.first().size) return;
+    std::pop_heap(heap.begin(), heap.end(), biggerFirst);
+    heap.last() = item;
+    std::push_heap(heap.begin(), heap.end(), biggerFirst);
+}
+
+// Rows come off the index biggest first, so the first ones that belong to live disks are the answer
+bool LargestFinder::walkSizeIndex(sqlite3* handle)
+{
+    SqlStatement files;
+    if (!files.prepare(handle, "select f.size, f.id, f.dirid, f.name from files as f indexed by files_size_idx "
+                               "cross join directories as d on d.id = f.dirid "
+                               "cross join disks as k on k.id = d.diskid "
+                               "where f.type = ? and k.deleted = 0 order by f.size desc")) return false;
+    files.bind(1, TYPE_FILE);
+
+    while (!abortNow && (heap.size() < limit) && files.next())
+    {
+        offer({ TYPE_FILE, files.int64(1), files.int64(2), files.int64(0), files.text(3) });
+    }
+    return !files.failed();
+}
+
+bool LargestFinder::walkTree(sqlite3* handle)
+{
+    // Subdirectories smallest first, so the biggest is the next one off the stack
+    SqlStatement subdirs;
+    if (!subdirs.prepare(handle, "select id, name, ifnull(totalsize, -1) from directories where parent = ? order by totalsize")) return false;
+
+    SqlStatement files;
+    if (!files.prepare(handle, "select size, id, name from files where dirid = ? and type = ?")) return false;
+
+    SqlStatement fileSizes;
+    if (!fileSizes.prepare(handle, "select ifnull(sum(size), 0) from files where dirid = ?")) return false;
+
+    struct Pending
+    {
+        qint64 id;
+        qint64 total; // -1 if not known
+    };
+
+    QVector<Pending> stack;
+    for (qint64 rootDirID : rootDirIDs) stack.append({ rootDirID, -1 });
+
+    while (!stack.isEmpty() && !abortNow)
+    {
+        Pending dir = stack.takeLast();
+        if ((dir.total >= 0) && cannotMakeIt(dir.total)) continue; // The heap has filled up since it was queued
+
+        if (!directories)
+        {
+            files.bind(1, dir.id);
+            files.bind(2, TYPE_FILE);
+            while (files.next())
+            {
+                qint64 size = files.int64(0);
+                if (!cannotMakeIt(size)) offer({ TYPE_FILE, files.int64(1), dir.id, size, files.text(2) });
+            }
+            if (files.failed()) return false;
+        }
+
+        QVector<LargestItem> untotalled;
+        subdirs.bind(1, dir.id);
+        while (subdirs.next())
+        {
+            qint64 total = subdirs.int64(2);
+            if ((total >= 0) && cannotMakeIt(total)) continue; // Nothing under it can make the list
+            if (directories)
+            {
+                if (total < 0) untotalled.append({ TYPE_DIR, subdirs.int64(0), dir.id, 0, subdirs.text(1) });
+                else offer({ TYPE_DIR, subdirs.int64(0), dir.id, total, subdirs.text(1) });
+            }
+            if (!directories || (total >= 0)) stack.append({ subdirs.int64(0), total });
+        }
+        if (subdirs.failed()) return false;
+
+        for (LargestItem& item : untotalled) // Only once subdirs has been read to the end, it is used again below
+            if (!addUpSubtree(subdirs, fileSizes, item)) return false;
+    }
+    return true;
+}
+
+// Sets dir's size to the total of everything under it, offering it and each directory below on the way
+bool LargestFinder::addUpSubtree(SqlStatement& subdirs, SqlStatement& fileSizes, LargestItem& dir)
+{
+    fileSizes.bind(1, dir.id);
+    dir.size = fileSizes.next() ? fileSizes.int64(0) : 0;
+    if (fileSizes.failed()) return false;
+    fileSizes.reset();
+
+    QVector<LargestItem> children;
+    subdirs.bind(1, dir.id);
+    while (subdirs.next()) children.append({ TYPE_DIR, subdirs.int64(0), dir.id, 0, subdirs.text(1) });
+    if (subdirs.failed()) return false;
+
+    for (LargestItem& child : children)
+    {
+        if (abortNow) return true;
+        if (!addUpSubtree(subdirs, fileSizes, child)) return false;
+        dir.size += child.size;
+    }
+
+    offer(dir);
+    return true;
+}
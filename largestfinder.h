@@ -0,0 +1,88 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LARGESTFINDER_H
+#define LARGESTFINDER_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+struct sqlite3;
+class SqlStatement;
+
+struct LargestItem
+{
+    int type;     // TYPE_FILE or TYPE_DIR
+    qint64 id;
+    qint64 dirID; // The parent directory
+    qint64 size;
+    QString name;
+};
+
+/* Finds the biggest files, or directories by the size of everything under
+ * them, below a set of directories: one directory, a disk's root, or the roots
+ * of every disk in a catalogue.
+ *
+ * The walk goes down the tree keeping the best so far in a heap bounded to the
+ * number wanted. Each directory's subtree total (see Cataloguer::finishDirectories)
+ * is an upper bound on anything inside it, so once the heap is full a subtree
+ * whose total is no bigger than the smallest kept is never opened. The biggest
+ * subtrees are taken first, so the heap fills with good candidates early and
+ * most of the tree is cut off. Disks catalogued before totals were kept have
+ * none, and are walked in full. Looking for directories, their totals are
+ * added up on the way instead.
+ *
+ * For files across the whole database it is cheaper still to read the size
+ * index from the top and stop after the number wanted.
+ */
+
+class LargestFinder : public QObject
+{
+    Q_OBJECT
+
+public:
+    LargestFinder(const QVector<qint64>& rootDirIDs, bool wholeDatabase, bool directories, int limit);
+
+    void abort();
+    const QVector<LargestItem>& getItems() const { return items; } // Biggest first, once finished
+
+public slots:
+    void go();
+
+signals:
+    void finished(bool ok);
+
+private:
+    bool walkSizeIndex(sqlite3* handle);
+    bool walkTree(sqlite3* handle);
+    bool addUpSubtree(SqlStatement& subdirs, SqlStatement& fileSizes, LargestItem& dir);
+    void offer(const LargestItem& item);
+    bool cannotMakeIt(qint64 size) const;
+
+    QVector<qint64> rootDirIDs;
+    bool wholeDatabase;
+    bool directories;
+    int limit;
+    bool abortNow = false;
+
+    QVector<LargestItem> heap; // Smallest at the front once full
+    QVector<LargestItem> items;
+};
+
+#endif // LARGESTFINDER_H
@@ -0,0 +1,139 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <QDebug>
+
+#include "globals.h"
+#include "searchresult.h"
+
+#include "largestmodel.h"
+
+LargestModel::LargestModel(QObject* parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+LargestModel::~LargestModel()
+{
+    for (Row& row : rows) delete row.sr;
+}
+
+QVariant LargestModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal) return QVariant();
+    if (role != Qt::DisplayRole) return QVariant();
+
+    switch(section)
+    {
+        case 0:
+            return "Name";
+        case 1:
+            return "Location";
+        case 2:
+            return "Size";
+    }
+
+    return QVariant();
+}
+
+int LargestModel::rowCount(const QModelIndex& /*parent*/) const
+{
+    return rows.size();
+}
+
+int LargestModel::columnCount(const QModelIndex& /*parent*/) const
+{
+    return 3;
+}
+
+QVariant LargestModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid()) return QVariant();
+    const Row& row = rows[index.row()];
+
+    if (role == Qt::DisplayRole)
+    {
+        switch(index.column())
+        {
+            case 0:
+                return row.sr->getName();
+            case 1:
+                return getLocated(index.row())->getLocation();
+            case 2:
+                return fileSizeToHR(row.size);
+        }
+    }
+    else if (role == Qt::DecorationRole)
+    {
+        if (index.column() == 0) return (row.type == TYPE_DIR) ? dirIcon : fileIcon;
+    }
+    else if (role == Qt::TextAlignmentRole)
+    {
+        if (index.column() == 2) return QVariant(Qt::AlignRight | Qt::AlignVCenter);
+    }
+    else if (role == ROLE_ID)
+    {
+        return row.sr->getID();
+    }
+    else if (role == ROLE_TYPE)
+    {
+        return row.type;
+    }
+
+    return QVariant();
+}
+
+SearchResult* LargestModel::getLocated(int rowNum) const
+{
+    Row& row = rows[rowNum];
+    if (!row.located)
+    {
+        row.sr->calcLocation();
+        row.located = true;
+    }
+    return row.sr;
+}
+
+void LargestModel::setItems(const QVector<LargestItem>& items)
+{
+    clear();
+    if (items.isEmpty()) return;
+
+    beginInsertRows(QModelIndex(), 0, items.size() - 1);
+    for (const LargestItem& item : items)
+    {
+        SearchResult* sr = new SearchResult();
+        sr->setType(item.type);
+        sr->setID(item.id);
+        QString name = item.name;
+        sr->setName(name);
+        sr->setParentDirID(item.dirID);
+        rows.append({ item.type, item.size, sr, false });
+        totalSize += item.size;
+    }
+    endInsertRows();
+}
+
+void LargestModel::clear()
+{
+    beginResetModel();
+    for (Row& row : rows) delete row.sr;
+    rows.clear();
+    totalSize = 0;
+    endResetModel();
+}
@@ -15,29 +15,71 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QScopedPointer>
+#include <QSettings>
 
 #include "globals.h"
 #include "mainwindow.h"
+#include "backup.h"
+
+namespace
+{
+// Looked for before the parser runs, which needs the application object already made
+bool isBackupRun(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if ((std::strncmp(argv[i], "--backup", 8) == 0) || (std::strncmp(argv[i], "-backup", 7) == 0)) return true;
+    }
+    return false;
+}
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    // A backup from the command line needs no GUI, so it runs where there is no display too
+    QScopedPointer<QCoreApplication> a(isBackupRun(argc, argv) ? new QCoreApplication(argc, argv) : new QApplication(argc, argv));
 
     // Command line options
 
-    a.setApplicationName("EZ Cat");
-    a.setApplicationVersion(QString("5." + QString::number(APP_VERSION)));
+    a->setApplicationName("EZ Cat");
+    a->setApplicationVersion(QString("5." + QString::number(APP_VERSION)));
     QCommandLineParser qcp;
     qcp.setApplicationDescription("EZ Cat - Disk Cataloguer");
     qcp.addHelpOption();
     qcp.addVersionOption();
     QCommandLineOption openFileOption("f", "Open database file <file>.", "file");
     qcp.addOption(openFileOption);
-    qcp.process(a);
+    QCommandLineOption backupOption("backup", "Back up the database (given with -f, or the last one opened) to <file> and exit. "
+                                              "A name ending in .gz is compressed. Safe while EZ Cat is running.", "file");
+    qcp.addOption(backupOption);
+    QCommandLineOption resumeOption("resume", "Carry on cataloguing the partly catalogued disk called <disk>.", "disk");
+    qcp.addOption(resumeOption);
+    qcp.process(*a);
     QString cliDBFile = qcp.value(openFileOption);
 
+    if (qcp.isSet(backupOption))
+    {
+        QString sourceFile = cliDBFile.isEmpty() ? settings.value("dbfile").toString() : cliDBFile;
+        if (sourceFile.isEmpty())
+        {
+            qCritical("No database to back up, use -f <file>");
+            return 1;
+        }
+
+        Backup backup(sourceFile, qcp.value(backupOption));
+        if (!backup.run())
+        {
+            qCritical("Backup failed");
+            return 1;
+        }
+        return 0;
+    }
+
     // Set up globals
 
     if (!db.initLib()) return -1;
@@ -45,8 +87,8 @@ int main(int argc, char *argv[])
 
     // Run
 
-    MainWindow w(NULL, cliDBFile);
+    MainWindow w(NULL, cliDBFile, qcp.value(resumeOption));
     w.show();
 
-    return a.exec();
+    return a->exec();
 }
@@ -15,17 +15,21 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <cstdio>
 #include <QSettings>
 #include <QDebug>
 #include <QMessageBox>
 #include <QFileDialog>
+#include <QFile>
+#include <QFileInfo>
 #include <QList>
 #include <QInputDialog>
 #include <QDateTime>
 #include <QProgressDialog>
-#include <QThread>
 #include <QSortFilterProxyModel>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QSqlQuery>
 
 #include "globals.h"
 #include "locsearch.h"
@@ -34,8 +38,9 @@
 #include "tablemodel.h"
 #include "tablesorter.h"
 #include "dlgnewdisk.h"
+#include "dlgscanprogress.h"
 #include "cataloguer.h"
-#include "backgroundtask.h"
+#include "reclaimer.h"
 #include "nodecatalogue.h"
 #include "dlgdbinfo.h"
 #include "noderoot.h"
@@ -51,15 +56,25 @@
 #include "dlgabout.h"
 #include "dlgaccessdenieds.h"
 #include "nodedir.h"
+#include "dlgduplicates.h"
+#include "dlglargest.h"
+#include "disktransfer.h"
+#include "catimage.h"
+#include "backgroundtask.h"
+#include "backup.h"
+#include "dbpool.h"
+#include "taskscheduler.h"
+#include "dbwriter.h"
 #include "utils.h"
 
 #include "mainwindow.h"
 
 QWidget* MainWindow::mainwindow = NULL;
 
-MainWindow::MainWindow(QWidget *parent, const QString& cliDBFile) :
+MainWindow::MainWindow(QWidget *parent, const QString& cliDBFile, const QString& t_cliResumeDisk) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow)
+    ui(new Ui::MainWindow),
+    cliResumeDisk(t_cliResumeDisk)
 {
     mainwindow = this;
     ui->setupUi(this);
@@ -74,9 +89,20 @@ MainWindow::MainWindow(QWidget *parent, const QString& cliDBFile) :
     ui->tableView->setShowGrid(false);
 
     ui->statusBar->addWidget(&statusLabel);
+    ui->statusBar->addPermanentWidget(&reclaimLabel);
+    reclaimLabel.hide();
+    ui->statusBar->addPermanentWidget(&jobsPanel);
+
+    // Action states that depend on the file system are refreshed as probe answers arrive
+    connect(&reachability, SIGNAL(updated()), this, SLOT(reachabilityUpdated()));
+
+    connect(&dbWriter, SIGNAL(finished(quint64,int,qint64,bool)), this, SLOT(writeFinished(quint64,int,qint64,bool)));
 
     connect(qApp, SIGNAL(focusChanged(QWidget*,QWidget*)), this, SLOT(focusChanged(QWidget*,QWidget*)));
 
+    connect(&snapshotTimer, SIGNAL(timeout()), this, SLOT(takeSnapshot()));
+    connect(&reindexTimer, SIGNAL(timeout()), this, SLOT(showReindexProgress()));
+
     // set up tree view
 
     // FIXME - seems like there should be a better way to do this
@@ -88,7 +114,6 @@ MainWindow::MainWindow(QWidget *parent, const QString& cliDBFile) :
 
 
     ui->treeView->setEditTriggers(QAbstractItemView::EditKeyPressed);
-    ui->treeView->sortByColumn(0, Qt::AscendingOrder);
     connect(ui->treeView, SIGNAL(collapsed(const QModelIndex&)), this, SLOT(treeView_collapsed(const QModelIndex&)));
 
     // set up table view
@@ -134,10 +159,16 @@ MainWindow::MainWindow(QWidget *parent, const QString& cliDBFile) :
         if (clickedButton == newButton) on_actionDatabaseNew_triggered();
         if (clickedButton == loadButton) on_actionDatabaseLoad_triggered();
     }
+
+    if (!cliResumeDisk.isEmpty()) QTimer::singleShot(0, this, SLOT(resumeNamedDisk())); // Once the window is up
 }
 
 MainWindow::~MainWindow()
 {
+    stopBackup();
+    stopReclaimer();
+    dbWriter.flush();
+    scheduler.shutdown();
     mainwindow = NULL;
     if (tableSelectedFile) delete tableSelectedFile;
     if (tableSelectedDir) delete tableSelectedDir;
@@ -147,6 +178,7 @@ MainWindow::~MainWindow()
     delete tm;
     delete fms;
     delete fm;
+    CatImage::detach();
     db.closeDB();
 }
 
@@ -205,11 +237,295 @@ void MainWindow::on_actionSearch_triggered()
 void MainWindow::on_actionDatabaseProperties_triggered()
 {
     DlgDBInfo dbid(this);
+    connect(&dbid, SIGNAL(compactionStarting()), this, SLOT(compactionStarting()));
+    connect(&dbid, SIGNAL(compactionFinished(QString)), this, SLOT(compactionFinished(QString)));
+
+    // The dialog is modal, so nothing the user starts can get going while it is open
+    QString blocker = compactionBlocker();
+    if (!blocker.isEmpty()) dbid.refuseCompaction(blocker);
+
     dbid.exec();
 }
 
+// Work the user asked for and is waiting on isn't stopped for a compaction, it holds it off instead
+QString MainWindow::compactionBlocker() const
+{
+    if (DB::isReadOnly()) return "Can't compact a database opened read-only";
+    if (runningCataloguer) return "Can't compact while a disk is being catalogued";
+    if (runningTransfer) return "Can't compact during an export or import";
+    if (runningBackup && !backupIsSnapshot) return "Can't compact while a backup is running";
+    if (runningImageBuild) return "Can't compact while the browsing image is being built";
+    return QString();
+}
+
+void MainWindow::compactionStarting()
+{
+    // Anything written from here on would be lost with the old file, and nothing
+    // else may be reading it when it is swapped. What's left running is unattended
+    // or can be run again: queued edits, the reclaimer, a snapshot and the finders
+    snapshotTimer.stop();
+    stopBackup();
+    if (dlgDuplicates) delete dlgDuplicates;
+    if (dlgLargest) delete dlgLargest;
+    dbWriter.flush();
+    stopReclaimer();
+}
+
+void MainWindow::compactionFinished(const QString& tempFileName)
+{
+    if (tempFileName.isEmpty()) // Cancelled or failed, the old file is still the database
+    {
+        setupSnapshotTimer();
+        startReclaimer();
+        return;
+    }
+
+    // Every connection to the old file has to go (idle scheduler threads have
+    // already let go of theirs), so this is a full close and reopen. The rename is atomic, so a crash
+    // leaves either the old file or the new one. Row IDs survive a vacuum, so the
+    // browsing image stays valid
+    QString dbFileName = DB::getFileName();
+
+    // Whatever is still in the WAL has to be in the main file first, otherwise a
+    // WAL left beside the compacted copy would be replayed into it on the next open
+    bool checkpointed = false;
+    {
+        QSqlQuery query(db.getqdb());
+        checkpointed = query.exec("pragma wal_checkpoint(truncate)") && query.next() && (query.value(0).toInt() == 0);
+    }
+    DBPool::invalidate();
+    on_actionDatabaseClose_triggered();
+
+    QString walFileName = dbFileName + "-wal";
+    if (!checkpointed || (QFileInfo::exists(walFileName) && (QFileInfo(walFileName).size() > 0)))
+    {
+        QFile::remove(tempFileName);
+        Utils::errorMessageBoxNonBlocking("The database is still in use elsewhere, so the compacted copy can't replace it. The database has not been changed.");
+    }
+    else if (std::rename(QFile::encodeName(tempFileName).constData(), QFile::encodeName(dbFileName).constData()) != 0)
+    {
+        QFile::remove(tempFileName);
+        Utils::errorMessageBoxNonBlocking("Failed to replace the database with the compacted copy. The database has not been changed.");
+    }
+
+    if (db.openDB(dbFileName)) databaseJustOpened();
+}
+
+void MainWindow::on_actionDatabaseDuplicates_triggered()
+{
+    if (dlgDuplicates)
+    {
+        dlgDuplicates->raise();
+        dlgDuplicates->activateWindow();
+        return;
+    }
+
+    dlgDuplicates = new DlgDuplicates(this);
+    dlgDuplicates->setAttribute(Qt::WA_DeleteOnClose);
+    connect(dlgDuplicates, SIGNAL(locationRequested(QList<QPair<qint64,qint64>>)), this, SLOT(showLocation(QList<QPair<qint64,qint64>>)));
+    dlgDuplicates->show();
+}
+
+// For the current tree item, or the whole database with none. One at a time, a new scope replaces the old
+void MainWindow::on_actionLargest_triggered()
+{
+    Node* scope = getCurrentTreeItem();
+    if (!scope) scope = Node::getRootNode();
+
+    if (dlgLargest) delete dlgLargest;
+    dlgLargest = new DlgLargest(this, scope);
+    dlgLargest->setAttribute(Qt::WA_DeleteOnClose);
+    connect(dlgLargest, SIGNAL(locationRequested(QList<QPair<qint64,qint64>>)), this, SLOT(showLocation(QList<QPair<qint64,qint64>>)));
+    dlgLargest->show();
+}
+
+void MainWindow::on_actionDatabaseBuildImage_triggered()
+{
+    Q_ASSERT(runningImageBuild == NULL);
+    Q_ASSERT(progressDialog == NULL);
+
+    progressDialog = new QProgressDialog("Building browsing image...", QString(), 0, 0, this);
+    progressDialog->setWindowFlag(Qt::WindowContextHelpButtonHint, false);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+    progressDialog->setValue(0);
+
+    CatImage::detach(); // Let go of the old mapping before the file is replaced
+    imageBuildOK = false;
+    QString imageFileName = CatImage::fileNameFor(DB::getFileName());
+
+    runningImageBuild = new BackgroundTask( [this, imageFileName]
+    {
+        DB* idb = DBPool::connection();
+        if (idb) imageBuildOK = CatImage::build(*idb, imageFileName);
+    } );
+
+    connect(runningImageBuild, SIGNAL(finished()), this, SLOT(imageBuildFinished()));
+    imageBuildJob = scheduler.submitWorker(TaskScheduler::LANE_BULK, runningImageBuild, "Building browsing image");
+}
+
+void MainWindow::imageBuildFinished()
+{
+    scheduler.wait(imageBuildJob);
+    delete runningImageBuild;
+    delete progressDialog;
+    runningImageBuild = NULL;
+    progressDialog = NULL;
+    imageBuildJob = 0;
+
+    if (!imageBuildOK)
+    {
+        Utils::errorMessageBoxNonBlocking("Failed to build the browsing image");
+        return;
+    }
+
+    CatImage::attach();
+}
+
+void MainWindow::on_actionDatabaseBackup_triggered()
+{
+    if (runningBackup)
+    {
+        Utils::errorMessageBox("A snapshot is being taken. Please try again in a moment.");
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, "Backup Database", "", "Compressed EZ Cat Database (*.db.gz);;EZ Cat Database (*.db)");
+    if (fileName.isEmpty()) return;
+
+    Q_ASSERT(progressDialog == NULL);
+    progressDialog = new QProgressDialog("Backing up database...", "Cancel", 0, 100, this);
+    progressDialog->setWindowFlag(Qt::WindowContextHelpButtonHint, false);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(0);
+    progressDialog->setValue(0);
+    connect(progressDialog, SIGNAL(canceled()), this, SLOT(backupAbort()));
+
+    startBackup(fileName, false);
+}
+
+void MainWindow::on_actionDatabaseSnapshots_triggered()
+{
+    QInputDialog qid(this);
+    qid.setWindowFlag(Qt::WindowContextHelpButtonHint, false);
+    qid.setWindowTitle("Scheduled Snapshots");
+    qid.setLabelText("Hours between snapshots (0 to turn them off):");
+    qid.setInputMode(QInputDialog::IntInput);
+    qid.setIntRange(0, 168);
+    qid.setIntValue(settings.value("snapshothours", 0).toInt());
+    if (qid.exec() != QDialog::Accepted) return;
+
+    int hours = qid.intValue();
+    if (hours > 0)
+    {
+        QString dir = QFileDialog::getExistingDirectory(this, "Snapshot Folder",
+                          settings.value("snapshotdir", QFileInfo(DB::getFileName()).absolutePath()).toString());
+        if (dir.isEmpty()) return;
+        settings.setValue("snapshotdir", dir);
+    }
+    settings.setValue("snapshothours", hours);
+    setupSnapshotTimer();
+
+    if (hours > 0) statusLabel.setText(QString("A snapshot will be taken every %1 hour(s). The newest %2 are kept.")
+                                       .arg(hours).arg(settings.value("snapshotkeep", SNAPSHOTS_KEPT).toInt()));
+    else statusLabel.setText("Scheduled snapshots turned off");
+}
+
+void MainWindow::setupSnapshotTimer()
+{
+    int hours = settings.value("snapshothours", 0).toInt();
+    if ((hours <= 0) || !db.getDBisOpen())
+    {
+        snapshotTimer.stop();
+        return;
+    }
+    snapshotTimer.start(hours * 60 * 60 * 1000);
+}
+
+void MainWindow::takeSnapshot()
+{
+    if (runningBackup || !db.getDBisOpen()) return; // Try again next time round
+    QString dir = settings.value("snapshotdir").toString();
+    if (dir.isEmpty()) return;
+    startBackup(Backup::snapshotFileName(dir, DB::getFileName()), true);
+}
+
+void MainWindow::startBackup(const QString& destFileName, bool snapshot)
+{
+    Q_ASSERT(runningBackup == NULL);
+    backupIsSnapshot = snapshot;
+
+    runningBackup = new Backup(DB::getFileName(), destFileName);
+
+    connect(runningBackup, SIGNAL(progress(int)), this, SLOT(backupProgress(int)));
+    connect(runningBackup, SIGNAL(finished(bool)), this, SLOT(backupFinished(bool)));
+
+    // Snapshots happen unattended, so they keep out of the way
+    backupJob = scheduler.submitWorker(snapshot ? TaskScheduler::LANE_BACKGROUND : TaskScheduler::LANE_BULK, runningBackup,
+                                       snapshot ? "Taking snapshot" : "Backing up", [this] { backupAbort(); });
+}
+
+void MainWindow::stopBackup()
+{
+    // Used when closing. The backup's own temporary files are removed, the destination is untouched
+    if (!runningBackup) return;
+
+    disconnect(runningBackup, NULL, this, NULL);
+    runningBackup->abort();
+    scheduler.wait(backupJob);
+    delete runningBackup;
+    runningBackup = NULL;
+    backupJob = 0;
+}
+
+void MainWindow::backupProgress(int percent)
+{
+    scheduler.setProgress(backupJob, percent);
+    if (!backupIsSnapshot && progressDialog) progressDialog->setValue(percent);
+}
+
+void MainWindow::backupAbort()
+{
+    // Runs in the GUI thread, as does backupFinished, so no race
+    if (runningBackup) runningBackup->abort();
+}
+
+void MainWindow::backupFinished(bool ok)
+{
+    if (!runningBackup) return;
+
+    bool aborted = runningBackup->wasAborted();
+    QString destFileName = runningBackup->getDestFileName();
+    QString sourceFileName = runningBackup->getSourceFileName();
+    scheduler.wait(backupJob);
+    delete runningBackup;
+    runningBackup = NULL;
+    backupJob = 0;
+
+    if (backupIsSnapshot)
+    {
+        if (!ok)
+        {
+            statusLabel.setText("Scheduled snapshot failed: " + destFileName);
+            return;
+        }
+        statusLabel.setText("Snapshot saved to " + destFileName);
+        Backup::pruneSnapshots(QFileInfo(destFileName).absolutePath(), sourceFileName, settings.value("snapshotkeep", SNAPSHOTS_KEPT).toInt());
+        return;
+    }
+
+    delete progressDialog;
+    progressDialog = NULL;
+
+    if (ok) statusLabel.setText("Database backed up to " + destFileName);
+    else if (!aborted) Utils::errorMessageBoxNonBlocking("Backup failed. Nothing has been written to " + destFileName);
+}
+
 void MainWindow::on_actionDatabaseClose_triggered()
 {
+    if (dlgDuplicates) delete dlgDuplicates;
+    if (dlgLargest) delete dlgLargest;
+
     if (tableSelectedFile) { delete tableSelectedFile; tableSelectedFile = NULL; }
     if (tableSelectedDir) { delete tableSelectedDir; tableSelectedDir = NULL; }
     if (treeSelectedDir) { delete treeSelectedDir; treeSelectedDir = NULL; }
@@ -225,17 +541,29 @@ void MainWindow::on_actionDatabaseClose_triggered()
     delete tm;
     delete fms;
     delete fm;
+    Node::destroyRoot();
     tms = NULL;
     tm = NULL;
     fms = NULL;
     fm = NULL;
+    dbWriter.flush();
+    stopReclaimer();
+    snapshotTimer.stop(); // A snapshot already under way has its own connection and finishes regardless
+    CatImage::detach();
     db.closeDB();
     ui->locSearch->setLocationText();
     ui->actionDatabaseClose->setEnabled(false);
     ui->actionDatabaseProperties->setEnabled(false);
+    ui->actionDatabaseDuplicates->setEnabled(false);
+    ui->actionLargest->setEnabled(false);
+    ui->actionDatabaseBuildImage->setEnabled(false);
     ui->actionSearch->setEnabled(false);
     ui->actionCatalogueNew->setEnabled(false);
     ui->actionDiskNew->setEnabled(false);
+    ui->actionDiskImport->setEnabled(false);
+    ui->actionDatabaseMerge->setEnabled(false);
+    ui->actionDatabaseBackup->setEnabled(false);
+    ui->actionDatabaseSnapshots->setEnabled(false);
     treeView_current_changed(QModelIndex(), QModelIndex()); // Not really, but it will disable all the right GUI parts
 }
 
@@ -289,24 +617,9 @@ void MainWindow::on_actionCatalogueDelete_triggered()
     msgBox.setDefaultButton(QMessageBox::Cancel);
     if (msgBox.exec() == QMessageBox::Ok)
     {
-        progressDialog = new QProgressDialog("Deleting catalogue...", QString(), 0, 0, this);
-        progressDialog->setWindowFlag(Qt::WindowContextHelpButtonHint, false);
-        progressDialog->setWindowModality(Qt::WindowModal);
-        progressDialog->setMinimumDuration(500);
-        progressDialog->setValue(0);
-
         NodeCatalogue* catToDel = static_cast<NodeCatalogue*>(n);
-        connect(catToDel, SIGNAL(deleteFinished(NodeCatalogue*,bool)), this, SLOT(catalogueDeleteFinsihed(NodeCatalogue*,bool)));
-
-        QThread* thread = new QThread;
-        backgroundTask = new BackgroundTask( [=] { catToDel->removeFromDB(); } );
-        backgroundTask->moveToThread(thread);
-
-        connect(thread, SIGNAL(started()), backgroundTask, SLOT(go()));
-        connect(backgroundTask, SIGNAL(finished()), this, SLOT(backgroundTaskFinished()));
-        connect(backgroundTask, SIGNAL(finished()), thread, SLOT(quit()));
-        connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
-        thread->start();
+        if (!catToDel->removeFromDB()) return;
+        catalogueDeleted(catToDel); // The reclaimer is started once the writer has tombstoned its disks
     }
 }
 
@@ -325,76 +638,243 @@ void MainWindow::on_actionDiskNew_triggered(bool updateMode)
     }
     else
     {
-        QModelIndex current_usQmi = tms->mapToSource(ui->treeView->currentIndex());
-        if (current_usQmi.isValid())
-        {
-            Node* walkUp = static_cast<Node*>(current_usQmi.internalPointer());
-
-            while(true)
-            {
-                if (walkUp->getType() == TYPE_CAT)
-                {
-                    cat = static_cast<NodeCatalogue*>(walkUp);
-                    break;
-                }
-                else if (walkUp->getType() == TYPE_DISK)
-                {
-                    if (walkUp->getParent() == Node::getRootNode()) break;
-                    cat = static_cast<NodeCatalogue*>(walkUp->getParent());
-                    break;
-                }
-                else
-                {
-                    walkUp = walkUp->getParent();
-                }
-            }
-        }
+        cat = getCurrentCatalogue();
     }
 
 
     DlgNewDisk* ndd = new DlgNewDisk(this, (cat == NULL ? 0 : cat->getID()));
-    if (updateMode) ndd->updateMode(disk->getName(), disk->getCatPath());
+    if (updateMode) ndd->updateMode(disk->getName(), disk->getCatPath(), disk->getHashContents(),
+                                    disk->getExcludes(), disk->getMountPolicy());
     if (ndd->exec() != QDialog::Accepted) return;
 
     qint64 targetCatID = ndd->getSelectedCatalogue();
     QString newDiskName = ndd->getNewDiskName();
     QString newLocation = ndd->getScanLocation();
+    bool hashContents = ndd->getHashContents();
+    QString excludes = ndd->getExcludes();
+    int mountPolicy = ndd->getMountPolicy();
+
+    // The throttle is a preference rather than part of the disk, so it is remembered for next time
+    settings.setValue("scanpriority", ndd->getPriority());
+    settings.setValue("scanmaxobjects", ndd->getMaxObjects());
+    settings.setValue("scanmaxmb", ndd->getMaxMB());
+
+    Cataloguer* cataloguer = new Cataloguer(targetCatID, newDiskName, newLocation);
+    cataloguer->hashMode(hashContents);
+    cataloguer->scanRules(excludes, mountPolicy);
+    cataloguer->throttleMode(ndd->getPriority(), ndd->getMaxObjects(), ndd->getMaxMB() * 1024 * 1024);
+    if (updateMode) cataloguer->updateMode(disk);
+    startCataloguer(cataloguer, updateMode ? disk : NULL, disk_usQmi);
+}
+
+void MainWindow::on_actionDiskResume_triggered()
+{
+    QModelIndex disk_usQmi;
+    NodeDisk* disk = getCurrentDisk(&disk_usQmi);
+    if (!disk || !(disk->isPartial() || disk->getUpdateID())) return;
 
+    qint64 catID = disk->getCatID();
+    QString name = disk->getName();
+    QString catPath = disk->getCatPath();
+    bool hashContents = disk->getHashContents();
+    QString excludes = disk->getExcludes();
+    int mountPolicy = disk->getMountPolicy();
+
+    if (disk->getUpdateID()) // An update keeps its own settings on the row it scans into, see Cataloguer
+    {
+        QSqlQuery query;
+        if (!query.exec(QString("select catid, name, catpath, hashcontents, excludes, mountpolicy from disks where id = %1").arg(disk->getUpdateID()))
+            || !query.next())
+        {
+            Utils::errorMessageBox("Failed to read the settings of the unfinished update");
+            return;
+        }
+        catID = query.value(0).toLongLong();
+        name = query.value(1).toString();
+        catPath = query.value(2).toString();
+        hashContents = (query.value(3).toInt() > 0);
+        excludes = query.value(4).toString();
+        mountPolicy = query.value(5).toInt();
+    }
+
+    QDir location(catPath);
+    if (!location.exists() || location.isEmpty())
+    {
+        Utils::errorMessageBox(QString("Location %1 is not available. Please mount the disk to carry on cataloguing it").arg(catPath));
+        return;
+    }
+
+    Cataloguer* cataloguer = new Cataloguer(catID, name, catPath);
+    cataloguer->hashMode(hashContents);
+    cataloguer->scanRules(excludes, mountPolicy);
+    cataloguer->resumeMode(disk);
+    cataloguer->throttleMode(settings.value("scanpriority", 0).toInt(),
+                             settings.value("scanmaxobjects", 0).toLongLong(),
+                             settings.value("scanmaxmb", 0).toLongLong() * 1024 * 1024);
+    startCataloguer(cataloguer, disk, disk_usQmi);
+}
+
+// For --resume. Picks out the partial disk of that name, then resumes it as if from the menu
+void MainWindow::resumeNamedDisk()
+{
+    QString diskName = cliResumeDisk;
+    cliResumeDisk.clear();
+    if (!db.getDBisOpen()) return;
+
+    tm->ensureChildrenLoaded(QModelIndex()); // Root loads every disk
+
+    NodeDisk* found = NULL;
+    QSqlQuery query;
+    query.prepare("select id from disks where deleted = 0 and (partial = 1 or updateid <> 0) and name = :name");
+    query.bindValue(":name", diskName);
+    if (query.exec() && query.next()) found = static_cast<NodeDisk*>(Node::findNode(TYPE_DISK, query.value(0).toLongLong()));
+
+    if (!found)
+    {
+        Utils::errorMessageBox(QString("There is no partly catalogued or updated disk called '%1'").arg(diskName));
+        return;
+    }
+
+    ui->treeView->setCurrentIndex(tms->mapFromSource(tm->indexFor(TYPE_DISK, found->getID())));
+    on_actionDiskResume_triggered();
+}
+
+// Takes ownership of the cataloguer. A disk being updated or resumed comes out of the tree
+// until the cataloguer hands it back
+void MainWindow::startCataloguer(Cataloguer* cataloguer, NodeDisk* disk, QModelIndex disk_usQmi)
+{
     Q_ASSERT(runningCataloguer == NULL);
+    Q_ASSERT(scanProgress == NULL);
+
+    scanProgress = new DlgScanProgress(this, settings.value("scanmaxobjects", 0).toLongLong(),
+                                       settings.value("scanmaxmb", 0).toLongLong());
+    scanProgress->show();
+
+    runningCataloguer = cataloguer;
+
+    connect(scanProgress, SIGNAL(canceled()), this, SLOT(cataloguerAbort()));
+    connect(scanProgress, SIGNAL(limitsChanged(qint64,qint64)), this, SLOT(cataloguerLimitsChanged(qint64,qint64)));
+    connect(runningCataloguer, SIGNAL(finished(NodeDisk*)), this, SLOT(cataloguerFinished(NodeDisk*)));
+    connect(runningCataloguer, SIGNAL(estimate(qint64,qint64,qint64,qint64)), this, SLOT(cataloguerEstimate(qint64,qint64,qint64,qint64)));
+    connect(runningCataloguer, SIGNAL(numObjectsFound(qint64,qint64)), this, SLOT(updateCataloguerProgress(qint64,qint64)));
+    connect(runningCataloguer, SIGNAL(reindexing(qint64)), this, SLOT(updateCataloguerReindexing(qint64)));
+    connect(runningCataloguer, SIGNAL(reindexProgress(qint64)), this, SLOT(updateCataloguerReindexProgress(qint64)));
+    connect(runningCataloguer, SIGNAL(hashing(qint64,qint64,qint64)), this, SLOT(updateCataloguerHashing(qint64,qint64,qint64)));
+
+    if (disk)
+    {
+        tm->removeNode(disk_usQmi, [&]
+        {
+            Node* diskParent = disk->getParent();
+            diskParent->removeChild(disk);
+        });
+        disk->clearChildren(); // Done here, the tree nodes and their index belong to the GUI thread
+    }
+
+    cataloguerJob = scheduler.submitWorker(TaskScheduler::LANE_BULK, runningCataloguer, "Cataloguing", [this] { cataloguerAbort(); });
+}
+
+void MainWindow::on_actionDiskExport_triggered()
+{
+    NodeDisk* disk = getCurrentDisk(NULL);
+    if (!disk) return;
+
+    if (disk->isPartial())
+    {
+        Utils::errorMessageBox("This disk is only partly catalogued. Please resume cataloguing it before exporting");
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, "Export Disk", disk->getName() + ".ezsnap",
+                                                    "EZ Cat Disk Snapshot (*.ezsnap);;All Files (*)");
+    if (fileName.isEmpty()) return;
+
+    startDiskTransfer(new DiskTransfer(DiskTransfer::MODE_EXPORT, fileName, disk->getID()), "Exporting...");
+}
+
+void MainWindow::on_actionDiskImport_triggered()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, "Import Disk", "", "EZ Cat Disk Snapshot (*.ezsnap);;All Files (*)");
+    if (fileName.isEmpty()) return;
+
+    NodeCatalogue* cat = getCurrentCatalogue();
+    startDiskTransfer(new DiskTransfer(DiskTransfer::MODE_IMPORT, fileName, (cat == NULL ? 0 : cat->getID())), "Importing...");
+}
+
+void MainWindow::on_actionDatabaseMerge_triggered()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, "Merge Database File", "", "EZ Cat Database (*.db);;All Files (*)");
+    if (fileName.isEmpty()) return;
+
+    NodeCatalogue* cat = getCurrentCatalogue();
+    QString target = (cat == NULL ? QString("the root") : QString("catalogue '%1'").arg(cat->getName()));
+    if (QMessageBox::question(this, "Merge Database",
+                              QString("Copy every disk in %1 into %2?").arg(QFileInfo(fileName).fileName(), target))
+        != QMessageBox::Yes) return;
+
+    startDiskTransfer(new DiskTransfer(DiskTransfer::MODE_MERGE, fileName, (cat == NULL ? 0 : cat->getID())), "Merging...");
+}
+
+void MainWindow::startDiskTransfer(DiskTransfer* transfer, const QString& title)
+{
+    Q_ASSERT(runningTransfer == NULL);
     Q_ASSERT(progressDialog == NULL);
 
-    progressDialog = new QProgressDialog("Cataloguing...", "Cancel", 0, 0, this);
-    progressDialog->setWindowTitle("Cataloguing Progress");
+    progressDialog = new QProgressDialog(title, "Cancel", 0, 0, this);
+    progressDialog->setWindowTitle("Transfer Progress");
     progressDialog->setMinimumWidth(300);
-    progressDialog->setLabelText(QString("Initialising..."));
+    progressDialog->setLabelText(title);
     progressDialog->setWindowFlag(Qt::WindowContextHelpButtonHint, false);
     progressDialog->setWindowModality(Qt::WindowModal);
     progressDialog->setMinimumDuration(0);
     progressDialog->setValue(0);
 
-    QThread* thread = new QThread;
-    runningCataloguer = new Cataloguer(targetCatID, newDiskName, newLocation);
-    runningCataloguer->moveToThread(thread);
+    runningTransfer = transfer;
 
-    connect(progressDialog, SIGNAL(canceled()), this, SLOT(cataloguerAbort()));
-    connect(thread, SIGNAL(started()), runningCataloguer, SLOT(go()));
-    connect(runningCataloguer, SIGNAL(finished(NodeDisk*)), this, SLOT(cataloguerFinished(NodeDisk*)));
-    connect(runningCataloguer, SIGNAL(finished(NodeDisk*)), thread, SLOT(quit()));
-    connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
-    connect(runningCataloguer, SIGNAL(numObjectsFound(qint64)), this, SLOT(updateCataloguerProgress(qint64)));
-    connect(runningCataloguer, SIGNAL(reindexing()), this, SLOT(updateCataloguerReindexing()));
+    connect(progressDialog, SIGNAL(canceled()), this, SLOT(diskTransferAbort()));
+    connect(runningTransfer, SIGNAL(finished(bool)), this, SLOT(diskTransferFinished(bool)));
+    connect(runningTransfer, SIGNAL(progress(qint64)), this, SLOT(diskTransferProgress(qint64)));
 
-    if (updateMode)
+    transferJob = scheduler.submitWorker(TaskScheduler::LANE_BULK, runningTransfer, title, [this] { diskTransferAbort(); });
+}
+
+void MainWindow::diskTransferProgress(qint64 numObjects)
+{
+    if (progressDialog) progressDialog->setLabelText(QString("%1 objects").arg(QLocale(QLocale::English).toString(numObjects)));
+}
+
+void MainWindow::diskTransferAbort()
+{
+    // Runs in the GUI thread, as does diskTransferFinished, so no race
+    if (runningTransfer) runningTransfer->abort();
+}
+
+void MainWindow::diskTransferFinished(bool ok)
+{
+    scheduler.wait(transferJob);
+    transferJob = 0;
+
+    if (ok && !runningTransfer->getNewDiskIDs().isEmpty())
     {
-        tm->removeNode(disk_usQmi, [&]
+        QStringList ids;
+        for (qint64 newDiskID : runningTransfer->getNewDiskIDs()) ids.append(QString::number(newDiskID));
+
+        if (!Node::eachDisk(QString("disks.id in (%1)").arg(ids.join(",")), [&] (NodeDisk* newDisk) { addNewDiskToAll(newDisk); }))
         {
-            Node* diskParent = disk->getParent();
-            diskParent->removeChild(disk);
-        });
-        runningCataloguer->updateMode(disk);
+            Utils::errorMessageBoxNonBlocking("Database Error:\nFailed to load the new disks");
+        }
     }
 
-    thread->start();
+    int e = runningTransfer->getError();
+    if (e == DiskTransfer::ERROR_VERSION)
+        Utils::errorMessageBoxNonBlocking("That database is from a different version of EZ Cat. Open it once in this version to bring it up to date, then merge again.");
+    else if (e && (e != 210)) // 210 is a cancel, which leaves everything as it was
+        Utils::errorMessageBoxNonBlocking(QString("Disk transfer failed. Error = %1").arg(e));
+
+    delete runningTransfer;
+    delete progressDialog;
+    runningTransfer = NULL;
+    progressDialog = NULL;
 }
 
 void MainWindow::on_actionDiskRename_triggered()
@@ -460,23 +940,8 @@ void MainWindow::on_actionDiskDelete_triggered()
     msgBox.setDefaultButton(QMessageBox::Cancel);
     if (msgBox.exec() == QMessageBox::Ok)
     {
-        progressDialog = new QProgressDialog("Deleting disk...", QString(), 0, 0, this);
-        progressDialog->setWindowFlag(Qt::WindowContextHelpButtonHint, false);
-        progressDialog->setWindowModality(Qt::WindowModal);
-        progressDialog->setMinimumDuration(500);
-        progressDialog->setValue(0);
-
-        connect(diskToDel, SIGNAL(deleteFinished(NodeDisk*,bool)), this, SLOT(diskDeleteFinsihed(NodeDisk*,bool)));
-
-        QThread* thread = new QThread;
-        backgroundTask = new BackgroundTask( [=] { diskToDel->removeFromDB(); } );
-        backgroundTask->moveToThread(thread);
-
-        connect(thread, SIGNAL(started()), backgroundTask, SLOT(go()));
-        connect(backgroundTask, SIGNAL(finished()), this, SLOT(backgroundTaskFinished()));
-        connect(backgroundTask, SIGNAL(finished()), thread, SLOT(quit()));
-        connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
-        thread->start();
+        if (!diskToDel->removeFromDB()) return;
+        diskDeleted(diskToDel); // The reclaimer is started once the writer has tombstoned it
     }
 }
 
@@ -490,7 +955,7 @@ void MainWindow::on_actionDiskProperties_triggered()
 {
     NodeDisk* n = getCurrentDisk(NULL);
     if (!n) return;
-    DlgDiskDirProperties ddp(this, n);
+    DlgDiskDirProperties ddp(this, n, &reachability);
     ddp.exec();
     setActions();
 }
@@ -502,6 +967,7 @@ void MainWindow::on_actionDiskMount_triggered()
 
     if (disk->mount())
     {
+        reachability.invalidate();
         setActions();
         statusLabel.setText("Mount command returned success");
     }
@@ -518,6 +984,7 @@ void MainWindow::on_actionDiskUnmount_triggered()
 
     if (disk->unmount())
     {
+        reachability.invalidate();
         setActions();
         statusLabel.setText("Un-mount command returned success");
     }
@@ -552,13 +1019,13 @@ void MainWindow::on_actionDirProperties_triggered()
     if (ui->treeView->hasFocus())
     {
         Q_ASSERT(treeSelectedDir);
-        DlgDirProperties pd(this, treeSelectedDir);
+        DlgDirProperties pd(this, treeSelectedDir, &reachability);
         pd.exec();
     }
     else if (ui->tableView->hasFocus())
     {
         Q_ASSERT(tableSelectedDir);
-        DlgDirProperties pd(this, tableSelectedDir);
+        DlgDirProperties pd(this, tableSelectedDir, &reachability);
         pd.exec();
     }
     else Q_ASSERT(false);
@@ -578,7 +1045,7 @@ void MainWindow::on_actionFileOpenContaining_triggered()
 void MainWindow::on_actionFileProperties_triggered()
 {
     Q_ASSERT(tableSelectedFile);
-    DlgFileProperties pd(this, tableSelectedFile);
+    DlgFileProperties pd(this, tableSelectedFile, &reachability);
     pd.exec();
 }
 
@@ -673,18 +1140,18 @@ void MainWindow::on_actionCxtSearchResultProperties_triggered()
 
     if (sr->getType() == TYPE_DISK)
     {
-        DlgDiskDirProperties ddp(this, sr->getNodeDisk());
+        DlgDiskDirProperties ddp(this, sr->getNodeDisk(), &reachability);
         ddp.exec();
         setActions();
     }
     else if (sr->getType() == TYPE_DIR)
     {
-        DlgDirProperties pd(this, sr->getDDir());
+        DlgDirProperties pd(this, sr->getDDir(), &reachability);
         pd.exec();
     }
     else if (sr->getType() >= TYPE_FILE)
     {
-        DlgFileProperties pd(this, sr->getDFile());
+        DlgFileProperties pd(this, sr->getDFile(), &reachability);
         pd.exec();
     }
 }
@@ -709,14 +1176,10 @@ void MainWindow::on_tableView_activated(const QModelIndex &index)
 
         if (targetType == TYPE_DISK)
         {
-            // Treeview is at the root or a catalogue
-            // Search the treeview starting at its currently selected item
-            // and search its children non-recursively for a disk
+            // Treeview is at the root or a catalogue, the disk is one of its children
 
-            QModelIndex firstDiskInCurrent = tms->index(0, 0, ui->treeView->currentIndex());
-            QModelIndexList treeNewCSIList = tms->match(firstDiskInCurrent, ROLE_ID, targetID, -1, Qt::MatchExactly);
-            Q_ASSERT(treeNewCSIList.count() == 1);
-            QModelIndex newTarget = treeNewCSIList[0];
+            QModelIndex newTarget = tms->mapFromSource(tm->indexFor(TYPE_DISK, targetID));
+            Q_ASSERT(newTarget.isValid());
 
             ui->treeView->scrollTo(newTarget);
             ui->treeView->expand(newTarget);
@@ -757,13 +1220,17 @@ bool MainWindow::getConfigDatabase()
 
 void MainWindow::databaseJustOpened()
 {
+    QElapsedTimer loadTimer;
+    loadTimer.start();
+
+    CatImage::attach();
     Node::createRoot();
 
     // load tree
     tm = new TreeModel(this, Node::getRootNode());
+    // The tree model keeps every level in name order itself, tms no longer sorts and only passes through
     tms = new QSortFilterProxyModel();
     tms->setSourceModel(tm);
-    tms->setSortCaseSensitivity(Qt::CaseInsensitive);
     QItemSelectionModel *m = ui->treeView->selectionModel();    // http://doc.qt.io/qt-5/qabstractitemview.html#setModel
     ui->treeView->setModel(tms);
     delete m;
@@ -784,52 +1251,205 @@ void MainWindow::databaseJustOpened()
 
     ui->actionDatabaseClose->setEnabled(true);
     ui->actionDatabaseProperties->setEnabled(true);
+    ui->actionDatabaseDuplicates->setEnabled(true);
+    ui->actionLargest->setEnabled(true);
+    ui->actionDatabaseBuildImage->setEnabled(true);
     ui->actionSearch->setEnabled(true);
-    ui->actionCatalogueNew->setEnabled(true);
-    ui->actionDiskNew->setEnabled(true);
+    ui->actionCatalogueNew->setEnabled(!DB::isReadOnly()); // A read-only database can still be browsed, searched and backed up
+    ui->actionDiskNew->setEnabled(!DB::isReadOnly());
+    ui->actionDiskImport->setEnabled(!DB::isReadOnly());
+    ui->actionDatabaseMerge->setEnabled(!DB::isReadOnly());
+    ui->actionDatabaseBackup->setEnabled(true);
+    ui->actionDatabaseSnapshots->setEnabled(true);
 
     ui->treeView->expandToDepth(0);
 
     tableToFilesDirs();
 
+    qint64 loadTime = loadTimer.elapsed();
+    qDebug() << "Tree loaded in" << loadTime << "ms";
+
     DBStats dbstats = db.getStats();
     QString allStats("Database opened. ");
     allStats += QLocale(QLocale::English).toString(dbstats.numCats) + " catalogues, ";
     allStats += QLocale(QLocale::English).toString(dbstats.numDisks) + " disks, ";
     allStats += QLocale(QLocale::English).toString(dbstats.numDirs) + " directories, ";
     allStats += QLocale(QLocale::English).toString(dbstats.numFiles) + " files. ";
-    allStats += "Database size: " + fileSizeToHR(dbstats.size) + ".";
+    allStats += "Database size: " + fileSizeToHR(dbstats.size) + ". ";
+    allStats += "Loaded in " + QLocale(QLocale::English).toString(loadTime) + " ms.";
+    if (DB::isReadOnly()) allStats += " Opened read-only, the file or its folder can't be written to.";
     statusLabel.setText(allStats);
     statusLabelHold = true;
     QTimer::singleShot(4000, [&] { statusLabelHold = false; } );
+
+    if (!DB::isReadOnly()) startReclaimer(); // Finish off any deletes left over from last time
+    setupSnapshotTimer();
 }
 
-void MainWindow::backgroundTaskFinished()
+void MainWindow::startReclaimer()
 {
-    Q_ASSERT(backgroundTask);
-    Q_ASSERT(progressDialog);
-    delete backgroundTask;
-    delete progressDialog;
-    backgroundTask = NULL;
-    progressDialog = NULL;
+    if (runningReclaimer)
+    {
+        // It may have already looked for tombstoned disks for the last time, so make sure it goes round again
+        reclaimPending = true;
+        return;
+    }
+
+    reclaimPending = false;
+
+    runningReclaimer = new Reclaimer();
+
+    connect(runningReclaimer, SIGNAL(objectsReclaimed(qint64)), this, SLOT(reclaimerProgress(qint64)));
+    connect(runningReclaimer, SIGNAL(finished()), this, SLOT(reclaimerFinished()));
+
+    // Cancelling leaves the rest tombstoned, it is picked up again next time the database is opened
+    Reclaimer* reclaimer = runningReclaimer;
+    reclaimerJob = scheduler.submitWorker(TaskScheduler::LANE_BACKGROUND, runningReclaimer, "Removing deleted disks",
+                                          [reclaimer] { reclaimer->abort(); });
+}
+
+void MainWindow::stopReclaimer()
+{
+    // Used when closing the database. Unfinished work stays tombstoned and is resumed next time
+    if (!runningReclaimer) return;
+
+    disconnect(runningReclaimer, NULL, this, NULL);
+    runningReclaimer->abort();
+    scheduler.wait(reclaimerJob);
+    delete runningReclaimer;
+    runningReclaimer = NULL;
+    reclaimerJob = 0;
+    reclaimPending = false;
+    reclaimLabel.hide();
+}
+
+void MainWindow::reclaimerProgress(qint64 numObjects)
+{
+    reclaimLabel.setText(QString("Removing deleted disks: %1 objects reclaimed").arg(QLocale(QLocale::English).toString(numObjects)));
+    reclaimLabel.show();
 }
 
-void MainWindow::updateCataloguerProgress(qint64 numObjects)
+void MainWindow::reclaimerFinished()
 {
-    progressDialog->setLabelText(QString("Cataloguing: %1 objects found...").arg(QLocale(QLocale::English).toString(numObjects)));
+    if (!runningReclaimer) return;
+
+    scheduler.wait(reclaimerJob);
+    delete runningReclaimer;
+    runningReclaimer = NULL;
+    reclaimerJob = 0;
+    reclaimLabel.hide();
+
+    if (reclaimPending) startReclaimer();
 }
 
-void MainWindow::updateCataloguerReindexing()
+void MainWindow::writeFinished(quint64 /*ticket*/, int op, qint64 id, bool ok)
 {
-    progressDialog->setLabelText(QString("Re-indexing..."));
+    if (!ok)
+    {
+        // The node was changed when the edit was made. Put it back as the database still has it
+        if (tm)
+        {
+            bool cat = (op == DBWriter::OP_RENAME_CATALOGUE) || (op == DBWriter::OP_DELETE_CATALOGUE);
+            tm->revertNode(cat ? TYPE_CAT : TYPE_DISK, id);
+            if (fm->reloadCat())
+            {
+                if (tableSelectedFile) { delete tableSelectedFile; tableSelectedFile = NULL; }
+                if (tableSelectedDir) { delete tableSelectedDir; tableSelectedDir = NULL; }
+                if (tableSelectedDisk) { tableSelectedDisk = NULL; }
+            }
+            setActions();
+        }
+
+        Utils::errorMessageBoxNonBlocking(QString("Database Error:\nFailed to %1. It has been put back as it was.")
+                                          .arg(DBWriter::describe(op)));
+        return;
+    }
+
+    if (((op == DBWriter::OP_DELETE_DISK) || (op == DBWriter::OP_DELETE_CATALOGUE)) && db.getDBisOpen()) startReclaimer();
+}
+
+void MainWindow::cataloguerEstimate(qint64 numObjects, qint64 numBytes, qint64 objectsDone, qint64 bytesDone)
+{
+    // Objects track the scan more closely than bytes (a few big files go by quickly), so bytes are the fallback
+    catEstimateBytes = (numObjects == 0) && (numBytes > 0);
+    catEstimate.start(catEstimateBytes ? numBytes : numObjects, 0, catEstimateBytes ? bytesDone : objectsDone);
+}
+
+void MainWindow::updateCataloguerProgress(qint64 numObjects, qint64 numBytes)
+{
+    QLocale locale(QLocale::English);
+    catEstimate.update(catEstimateBytes ? numBytes : numObjects);
+
+    QString text;
+    if (!catEstimate.hasEstimate())
+        text = QString("Cataloguing: %1 objects found").arg(locale.toString(numObjects));
+    else if (catEstimateBytes)
+        text = QString("Cataloguing: %1 objects, %2 of about %3").arg(locale.toString(numObjects),
+                                                                      fileSizeToHR(numBytes), fileSizeToHR(catEstimate.getExpectedTotal()));
+    else
+        text = QString("Cataloguing: %1 of about %2 objects").arg(locale.toString(numObjects), locale.toString(catEstimate.getExpectedTotal()));
+
+    if (catEstimate.getRate() > 0)
+    {
+        if (catEstimateBytes) text += QString("\n%1/s").arg(fileSizeToHR(static_cast<qint64>(catEstimate.getRate())));
+        else text += QString("\n%1 objects/s").arg(locale.toString(static_cast<qint64>(catEstimate.getRate())));
+        if (catEstimate.secondsLeft() >= 0) text += ", " + ProgressEstimator::durationText(catEstimate.secondsLeft()) + " left";
+    }
+
+    scanProgress->setLabelText(text);
+    scanProgress->setPercent(catEstimate.percent());
+    scheduler.setProgress(cataloguerJob, catEstimate.percent());
+}
+
+void MainWindow::updateCataloguerReindexing(qint64 rowsToIndex)
+{
+    // Progress comes every thousand directories, which can be far apart, so a timer keeps the
+    // display moving. The first guess at the speed is the one measured last time
+    catEstimate.start(rowsToIndex, settings.value("reindexrate", REINDEX_ROWS_PER_SEC).toDouble());
+    showReindexProgress();
+    reindexTimer.start(1000);
+}
+
+void MainWindow::updateCataloguerReindexProgress(qint64 rowsIndexed)
+{
+    catEstimate.update(rowsIndexed);
+    if (catEstimate.getRate() > 0) settings.setValue("reindexrate", catEstimate.getRate());
+    showReindexProgress();
+}
+
+void MainWindow::showReindexProgress()
+{
+    if (!scanProgress) return;
+    QString text("Finishing directories...");
+    if (catEstimate.secondsLeft() >= 0) text += "\n" + ProgressEstimator::durationText(catEstimate.secondsLeft()) + " left";
+    scanProgress->setLabelText(text);
+    scanProgress->setPercent(catEstimate.percent());
+    scheduler.setProgress(cataloguerJob, catEstimate.percent());
+}
+
+void MainWindow::updateCataloguerHashing(qint64 bytesDone, qint64 bytesTotal, qint64 bytesPerSec)
+{
+    reindexTimer.stop();
+
+    QString text = QString("Hashing: %1 of %2 (%3 MB/s)")
+                   .arg(fileSizeToHR(bytesDone), fileSizeToHR(bytesTotal))
+                   .arg(QLocale(QLocale::English).toString(static_cast<double>(bytesPerSec) / (1024 * 1024), 'f', 1));
+    if (bytesPerSec > 0) text += "\n" + ProgressEstimator::durationText((bytesTotal - bytesDone) / bytesPerSec) + " left";
+    int percent = bytesTotal ? static_cast<int>(qMin(bytesDone * 100 / bytesTotal, static_cast<qint64>(99))) : -1;
+    scanProgress->setLabelText(text);
+    scanProgress->setPercent(percent);
+    scheduler.setProgress(cataloguerJob, percent);
 }
 
 void MainWindow::cataloguerFinished(NodeDisk* newDisk)
 {
+    reindexTimer.stop();
+
+    int e = runningCataloguer->getError();
     if (newDisk)
     {
         const QStringList& accessDeniedPaths = runningCataloguer->getAccessDeniedPaths();
-        if (accessDeniedPaths.size() > 0)
+        if ((accessDeniedPaths.size() > 0) && (!e || newDisk->isPartial())) // Not for an update that was rolled back
         {
             DlgAccessDenieds d(this, accessDeniedPaths);
             d.exec();
@@ -838,13 +1458,32 @@ void MainWindow::cataloguerFinished(NodeDisk* newDisk)
         addNewDiskToAll(newDisk);
     }
 
-    int e = runningCataloguer->getError();
-    if (e) Utils::errorMessageBoxNonBlocking(QString("Failed to catalogue the disk. Error = %1").arg(e));
+    if (newDisk && newDisk->isPartial())
+    {
+        QString text = (e == 210) ? QString("Cataloguing stopped.") : QString("Cataloguing failed. Error = %1.").arg(e);
+        text += " What was found up to the last checkpoint has been kept. Use Disk / Resume Cataloguing to carry on.";
+        Utils::errorMessageBoxNonBlocking(text);
+    }
+    else if (newDisk && e) // An update, the disk still has its old contents
+    {
+        QString text = (e == 210) ? QString("Cataloguing stopped.") : QString("Cataloguing failed. Error = %1.").arg(e);
+        if (newDisk->getUpdateID()) text += " The disk keeps its previous catalogue for now. Use Disk / Resume Cataloguing to finish the update.";
+        else text += " The disk has been left as it was before the update.";
+        Utils::errorMessageBoxNonBlocking(text);
+    }
+    else if (e)
+    {
+        Utils::errorMessageBoxNonBlocking(QString("Failed to catalogue the disk. Error = %1").arg(e));
+    }
 
+    if (runningCataloguer->isUpdate()) startReclaimer(); // For the old contents, or an earlier update that was given up
+
+    scheduler.wait(cataloguerJob);
     delete runningCataloguer;
-    delete progressDialog;
+    delete scanProgress;
     runningCataloguer = NULL;
-    progressDialog = NULL;
+    scanProgress = NULL;
+    cataloguerJob = 0;
 }
 
 void MainWindow::cataloguerAbort()
@@ -853,14 +1492,15 @@ void MainWindow::cataloguerAbort()
     if (runningCataloguer) runningCataloguer->abort();
 }
 
-void MainWindow::catalogueDeleteFinsihed(NodeCatalogue* catToDel, bool success)
+void MainWindow::cataloguerLimitsChanged(qint64 maxObjectsPerSec, qint64 maxMBPerSec)
 {
-    if (!success)
-    {
-        Utils::errorMessageBoxNonBlocking("Error deleting catalogue from database");
-        return;
-    }
+    settings.setValue("scanmaxobjects", maxObjectsPerSec);
+    settings.setValue("scanmaxmb", maxMBPerSec);
+    if (runningCataloguer) runningCataloguer->setLimits(maxObjectsPerSec, maxMBPerSec * 1024 * 1024);
+}
 
+void MainWindow::catalogueDeleted(NodeCatalogue* catToDel)
+{
     QModelIndex catQmi = tm->getQmiForCatID(catToDel->getID());
     tm->removeNode(catQmi, [&] { Node::getRootNode()->removeChild(catToDel); } );
     delete catToDel;
@@ -868,32 +1508,10 @@ void MainWindow::catalogueDeleteFinsihed(NodeCatalogue* catToDel, bool success)
     clearDataIfLast();
 }
 
-void MainWindow::diskDeleteFinsihed(NodeDisk* diskToDel, bool success)
+void MainWindow::diskDeleted(NodeDisk* diskToDel)
 {
-    if (!success)
-    {
-        Utils::errorMessageBoxNonBlocking("Error deleting disk from database");
-        return;
-    }
-
     // Get usQmi for Disk
-    QModelIndex qmiCat = QModelIndex();
-    if (diskToDel->getCatID()) qmiCat = tm->getQmiForCatID(diskToDel->getCatID());
-
-    //qmiCat is now at root (invalid) or a catalogue
-
-    QModelIndex diskQmi = QModelIndex();
-    QModelIndexList matches = tm->match(tm->index(0, 0, qmiCat), ROLE_ID, diskToDel->getID(), -1, Qt::MatchExactly);
-    foreach(QModelIndex matchQmi, matches)
-    {
-        Node* n = static_cast<Node*>(matchQmi.internalPointer());
-        if (n->getType() == TYPE_DISK)
-        {
-            diskQmi = matchQmi;
-            break;
-        }
-    }
-
+    QModelIndex diskQmi = tm->indexFor(TYPE_DISK, diskToDel->getID());
     Q_ASSERT(diskQmi.isValid());
 
     // diskQmi is now at the disk to remove, or QModelIndex() in the case of logic error...
@@ -925,8 +1543,7 @@ void MainWindow::clearDataIfLast()
 void MainWindow::requestRenameDisk(qint64 diskID, QString newName)
 {
     // This comes from the TableModel. The current index in the tree model must be the parent catalogue, so...
-    QModelIndex usQmi = tms->mapToSource(ui->treeView->currentIndex());
-    bool result = tm->renameDisk(usQmi, diskID, newName);
+    bool result = tm->renameDisk(diskID, newName);
     if (result)
     {
         // Need to reload fm completely because it has no memory of its data apart from the DB
@@ -939,6 +1556,39 @@ void MainWindow::requestRenameDisk(qint64 diskID, QString newName)
     }
 }
 
+void MainWindow::showLocation(QList<QPair<qint64,qint64>> fullIDLocation)
+{
+    if (!tm || fullIDLocation.isEmpty()) return;
+    if (searchModel) returnFromSearch();
+    navigateToLocation(fullIDLocation);
+}
+
+NodeCatalogue* MainWindow::getCurrentCatalogue() const
+{
+    // The catalogue the tree's current item is in, or NULL for the root
+    QModelIndex current_usQmi = tms->mapToSource(ui->treeView->currentIndex());
+    if (!current_usQmi.isValid()) return NULL;
+
+    Node* walkUp = static_cast<Node*>(current_usQmi.internalPointer());
+
+    while(true)
+    {
+        if (walkUp->getType() == TYPE_CAT)
+        {
+            return static_cast<NodeCatalogue*>(walkUp);
+        }
+        else if (walkUp->getType() == TYPE_DISK)
+        {
+            if (walkUp->getParent() == Node::getRootNode()) return NULL;
+            return static_cast<NodeCatalogue*>(walkUp->getParent());
+        }
+        else
+        {
+            walkUp = walkUp->getParent();
+        }
+    }
+}
+
 Node *MainWindow::getCurrentTreeItem() const
 {
     QModelIndex sQmi = ui->treeView->currentIndex();
@@ -964,10 +1614,7 @@ NodeDisk* MainWindow::getCurrentDisk(QModelIndex* p_usQmi) const
         // Tree is at a cat
         if (!tableSelectedDisk) return NULL;
 
-        QModelIndexList matches = tm->match(tm->index(0, 0, usQmi), ROLE_ID, tableSelectedDisk->getID(), -1, Qt::MatchExactly);
-        Q_ASSERT(matches.size() == 1);
-
-        if (p_usQmi) *p_usQmi = matches[0];
+        if (p_usQmi) *p_usQmi = tm->indexFor(TYPE_DISK, tableSelectedDisk->getID());
         return tableSelectedDisk;
     }
     else if (node->getType() == TYPE_DISK)
@@ -993,9 +1640,7 @@ NodeDisk* MainWindow::getCurrentDisk(QModelIndex* p_usQmi) const
 
 void MainWindow::addNewDiskToAll(NodeDisk* disk)
 {
-    Node* addTo = Node::getRootNode()->catFromID(disk->getCatID());
-    if (!addTo) addTo = Node::getRootNode();
-    QModelIndex qmi = tm->addDisk(disk, [&] { addTo->addChild(disk); } );
+    QModelIndex qmi = tm->addDisk(disk);
     ui->treeView->setCurrentIndex(tms->mapFromSource(qmi));
 }
 
@@ -1089,9 +1734,13 @@ void MainWindow::navigateToSearchResult()
 {
     SearchResult* sr = static_cast<SearchResult*>(ui->tableView->currentIndex().internalPointer());
     QList<QPair<qint64,qint64>> fullIDLocation = sr->getFullIDLocation();
-    // Now need to walk down the tree ensuring each level is expanded
     returnFromSearch();
+    navigateToLocation(fullIDLocation);
+}
 
+void MainWindow::navigateToLocation(const QList<QPair<qint64,qint64>>& fullIDLocation)
+{
+    // Walk down the tree ensuring each level is expanded
     QModelIndex qmi = QModelIndex();
     QModelIndex sqmi;
     qint64 highlightFileID = -1;
@@ -1100,36 +1749,21 @@ void MainWindow::navigateToSearchResult()
     // Handle first pair, the catalogue
     if ((*it).second != 0) // there is a catalogue
     {
-        QModelIndexList matches = tm->match(tm->index(0, 0, qmi), ROLE_ID, (*it).second, -1, Qt::MatchExactly);
-        // Found: catalogue (and possibly disk) with that ID
-        foreach(qmi, matches)
-        {
-            if (tm->data(qmi, ROLE_TYPE).toInt() == TYPE_CAT)
-            {
-                sqmi = tms->mapFromSource(qmi);
-                ui->treeView->scrollTo(sqmi);
-                ui->treeView->expand(sqmi);
-                break;
-            }
-        }
+        qmi = tm->indexFor(TYPE_CAT, (*it).second);
+        sqmi = tms->mapFromSource(qmi);
+        ui->treeView->scrollTo(sqmi);
+        ui->treeView->expand(sqmi);
     }
     it++;
 
     if (it != fullIDLocation.end())
     {
         // Handle second pair, the disk
-        QModelIndexList matches = tm->match(tm->index(0, 0, qmi), ROLE_ID, (*it).second, -1, Qt::MatchExactly);
-        // Found: disk (and possibly catalogue) with that ID
-        foreach(qmi, matches)
-        {
-            if (tm->data(qmi, ROLE_TYPE).toInt() == TYPE_DISK)
-            {
-                sqmi = tms->mapFromSource(qmi);
-                ui->treeView->scrollTo(sqmi);
-                ui->treeView->expand(sqmi);
-                break;
-            }
-        }
+        tm->ensureChildrenLoaded(qmi);
+        qmi = tm->indexFor(TYPE_DISK, (*it).second);
+        sqmi = tms->mapFromSource(qmi);
+        ui->treeView->scrollTo(sqmi);
+        ui->treeView->expand(sqmi);
         it++; // Advance from disk to rootdir
 
         if (it != fullIDLocation.end())
@@ -1142,9 +1776,9 @@ void MainWindow::navigateToSearchResult()
             {
                 if ((*it).first >= TYPE_FILE) { highlightFileID = (*it).second; break; } // Got to a file, break
 
-                QModelIndexList matches2 = tm->match(tm->index(0, 0, qmi), ROLE_ID, (*it).second, -1, Qt::MatchExactly);
-                Q_ASSERT(matches2.size() == 1);
-                qmi = matches2[0];
+                tm->ensureChildrenLoaded(qmi);
+                qmi = tm->indexFor(TYPE_DIR, (*it).second);
+                Q_ASSERT(qmi.isValid());
                 sqmi = tms->mapFromSource(qmi);
                 ui->treeView->scrollTo(sqmi);
                 ui->treeView->expand(sqmi);
@@ -1265,15 +1899,19 @@ void MainWindow::treeViewContextMenu(QPoint qp)
         contextMenu.addAction(ui->actionCatalogueRename);
         contextMenu.addAction(ui->actionCatalogueDelete);
         contextMenu.addAction(ui->actionDiskNew);
+        contextMenu.addAction(ui->actionLargest);
     }
     else if (currentTreeNode->getType() == TYPE_DISK)
     {
         contextMenu.addAction(ui->actionDiskRename);
         contextMenu.addAction(ui->actionDiskMove);
         contextMenu.addAction(ui->actionDiskUpdate);
+        NodeDisk* nd = static_cast<NodeDisk*>(currentTreeNode);
+        if (nd->isPartial() || nd->getUpdateID()) contextMenu.addAction(ui->actionDiskResume);
         contextMenu.addAction(ui->actionDiskDelete);
         contextMenu.addAction(ui->actionDiskOpen);
         contextMenu.addAction(ui->actionDiskProperties);
+        contextMenu.addAction(ui->actionLargest);
         contextMenu.addSeparator();
         contextMenu.addAction(ui->actionDiskMount);
         contextMenu.addAction(ui->actionDiskUnmount);
@@ -1282,6 +1920,7 @@ void MainWindow::treeViewContextMenu(QPoint qp)
     {
         contextMenu.addAction(ui->actionDirOpen);
         contextMenu.addAction(ui->actionDirProperties);
+        contextMenu.addAction(ui->actionLargest);
     }
     else
     {
@@ -1332,6 +1971,7 @@ void MainWindow::tableViewContextMenu(QPoint qp)
             contextMenu.addAction(ui->actionDiskRename);
             contextMenu.addAction(ui->actionDiskMove);
             contextMenu.addAction(ui->actionDiskUpdate);
+            if (tableSelectedDisk->isPartial() || tableSelectedDisk->getUpdateID()) contextMenu.addAction(ui->actionDiskResume);
             contextMenu.addAction(ui->actionDiskDelete);
             contextMenu.addAction(ui->actionDiskOpen);
             contextMenu.addAction(ui->actionDiskProperties);
@@ -1401,10 +2041,9 @@ void MainWindow::dfDirGo(qint64 targetID)
     // dir at current
     // TreeView column 0 role UserRole is the int id of the dir
 
-    QModelIndex firstChild = tms->index(0, 0, ui->treeView->currentIndex());
-    QModelIndexList treeNewCSIList = tms->match(firstChild, ROLE_ID, targetID, 1, Qt::MatchExactly);
-    Q_ASSERT(treeNewCSIList.count() == 1);
-    QModelIndex newTarget = treeNewCSIList[0];
+    tm->ensureChildrenLoaded(tms->mapToSource(ui->treeView->currentIndex()));
+    QModelIndex newTarget = tms->mapFromSource(tm->indexFor(TYPE_DIR, targetID));
+    Q_ASSERT(newTarget.isValid());
     ui->treeView->scrollTo(newTarget);
     ui->treeView->expand(newTarget);
     ui->treeView->setCurrentIndex(newTarget);
@@ -1485,8 +2124,34 @@ void MainWindow::tableView_s_current_changed(const QModelIndex& current, const Q
 {
     SearchResult* sr = static_cast<SearchResult*>(current.internalPointer());
     sr->loadDObject();
-    ui->actionCxtSearchResultOpen->setEnabled(sr->isReachable());
-    ui->actionCxtSearchResultOpenContaining->setEnabled(sr->isContainerReachable());
+    setSearchResultActions(sr);
+}
+
+void MainWindow::setSearchResultActions(SearchResult* sr)
+{
+    QString rootPath, path, containerPath;
+    if (!sr->getPaths(rootPath, path, containerPath))
+    {
+        ui->actionCxtSearchResultOpen->setEnabled(false);
+        ui->actionCxtSearchResultOpenContaining->setEnabled(false);
+        return;
+    }
+
+    ui->actionCxtSearchResultOpen->setEnabled(reachability.query(rootPath, path).exists);
+    ui->actionCxtSearchResultOpenContaining->setEnabled(!containerPath.isEmpty() && reachability.query(rootPath, containerPath).isDir);
+}
+
+void MainWindow::reachabilityUpdated()
+{
+    if (!db.getDBisOpen()) return;
+
+    setActions();
+
+    if (searchModel && (ui->tableView->model() == searchModel))
+    {
+        QModelIndex current = ui->tableView->currentIndex();
+        if (current.isValid()) setSearchResultActions(static_cast<SearchResult*>(current.internalPointer()));
+    }
 }
 
 void MainWindow::setActions()
@@ -1536,6 +2201,7 @@ void MainWindow::setActions()
         ui->actionDiskDelete->setEnabled(false);
         ui->actionDiskOpen->setEnabled(false);
         ui->actionDiskProperties->setEnabled(false);
+        ui->actionDiskExport->setEnabled(false);
         ui->actionDiskMount->setEnabled(false);
         ui->actionDiskUnmount->setEnabled(false);
         ui->actionCXONLYDiskGo->setEnabled(false);
@@ -1564,6 +2230,7 @@ void MainWindow::setActions()
             ui->actionDiskDelete->setEnabled(false);
             ui->actionDiskOpen->setEnabled(allowDiskOpen());
             ui->actionDiskProperties->setEnabled(true);
+            ui->actionDiskExport->setEnabled(true);
             ui->actionDiskMount->setEnabled(allowDiskMount());
             ui->actionDiskUnmount->setEnabled(allowDiskUnmount());
             ui->actionCXONLYDiskGo->setEnabled(true);
@@ -1576,6 +2243,7 @@ void MainWindow::setActions()
             ui->actionDiskDelete->setEnabled(false);
             ui->actionDiskOpen->setEnabled(false);
             ui->actionDiskProperties->setEnabled(false);
+            ui->actionDiskExport->setEnabled(false);
             ui->actionDiskMount->setEnabled(false);
             ui->actionDiskUnmount->setEnabled(false);
             ui->actionCXONLYDiskGo->setEnabled(false);
@@ -1603,6 +2271,7 @@ void MainWindow::setActions()
         ui->actionDiskDelete->setEnabled(true);
         ui->actionDiskOpen->setEnabled(allowDiskOpen());
         ui->actionDiskProperties->setEnabled(true);
+        ui->actionDiskExport->setEnabled(true);
         ui->actionDiskMount->setEnabled(allowDiskMount());
         ui->actionDiskUnmount->setEnabled(allowDiskUnmount());
         ui->actionCXONLYDiskGo->setEnabled(true);
@@ -1629,6 +2298,7 @@ void MainWindow::setActions()
         ui->actionDiskDelete->setEnabled(true);
         ui->actionDiskOpen->setEnabled(allowDiskOpen());
         ui->actionDiskProperties->setEnabled(true);
+        ui->actionDiskExport->setEnabled(true);
         ui->actionDiskMount->setEnabled(allowDiskMount());
         ui->actionDiskUnmount->setEnabled(allowDiskUnmount());
         ui->actionCXONLYDiskGo->setEnabled(false);
@@ -1655,6 +2325,7 @@ void MainWindow::setActions()
         ui->actionDiskDelete->setEnabled(true);
         ui->actionDiskOpen->setEnabled(allowDiskOpen());
         ui->actionDiskProperties->setEnabled(true);
+        ui->actionDiskExport->setEnabled(true);
         ui->actionDiskMount->setEnabled(allowDiskMount());
         ui->actionDiskUnmount->setEnabled(allowDiskUnmount());
         ui->actionCXONLYDiskGo->setEnabled(false);
@@ -1681,6 +2352,7 @@ void MainWindow::setActions()
         ui->actionDiskDelete->setEnabled(true);
         ui->actionDiskOpen->setEnabled(allowDiskOpen());
         ui->actionDiskProperties->setEnabled(true);
+        ui->actionDiskExport->setEnabled(true);
         ui->actionDiskMount->setEnabled(allowDiskMount());
         ui->actionDiskUnmount->setEnabled(allowDiskUnmount());
         ui->actionCXONLYDiskGo->setEnabled(false);
@@ -1696,6 +2368,22 @@ void MainWindow::setActions()
         ui->actionRename->setEnabled(false);
         ui->actionDelete->setEnabled(false);
     }
+
+    NodeDisk* currentDisk = (typeSelected == TYPE_INVALID) ? NULL : getCurrentDisk(NULL);
+    ui->actionDiskResume->setEnabled(currentDisk && (currentDisk->isPartial() || currentDisk->getUpdateID()));
+
+    if (DB::isReadOnly()) // Browsing, searching and exporting still work, nothing that writes does
+    {
+        ui->actionCatalogueRename->setEnabled(false);
+        ui->actionCatalogueDelete->setEnabled(false);
+        ui->actionDiskRename->setEnabled(false);
+        ui->actionDiskMove->setEnabled(false);
+        ui->actionDiskUpdate->setEnabled(false);
+        ui->actionDiskDelete->setEnabled(false);
+        ui->actionDiskResume->setEnabled(false);
+        ui->actionRename->setEnabled(false);
+        ui->actionDelete->setEnabled(false);
+    }
 }
 
 bool MainWindow::allowDiskMove()
@@ -1703,43 +2391,47 @@ bool MainWindow::allowDiskMove()
     return (Node::getRootNode()->numCatalogues() > 0);
 }
 
+// The allow functions below only read the reachability cache. Anything not yet
+// known is treated as unavailable until the probe answers and setActions runs again
+
 bool MainWindow::allowDiskMount()
 {
     NodeDisk* disk = getCurrentDisk(NULL);
-    if (!disk) return false;
-    if (disk->hasMountCommand() && disk->catPathLocationEmpty())
-        return true;
-    return false;
+    if (!disk || !disk->hasMountCommand()) return false;
+    ReachabilityMonitor::PathState ps = reachability.query(disk->getCatPath(), disk->getCatPath());
+    return (ps.isDir && ps.isEmpty);
 }
 
 bool MainWindow::allowDiskUnmount()
 {
     NodeDisk* disk = getCurrentDisk(NULL);
-    if (!disk) return false;
-    if (disk->hasUnmountCommand() && disk->catPathLocationFull()) return true;
-    return false;
+    if (!disk || !disk->hasUnmountCommand()) return false;
+    ReachabilityMonitor::PathState ps = reachability.query(disk->getCatPath(), disk->getCatPath());
+    return (ps.isDir && !ps.isEmpty);
 }
 
 bool MainWindow::allowDiskOpen()
 {
     NodeDisk* dn = getCurrentDisk(NULL);
-    if (dn) return dn->isReachable();
+    if (dn) return reachability.query(dn->getCatPath(), dn->getCatPath()).isDir;
     return false;
 }
 
 bool MainWindow::allowDirOpen(int uiSource)
 {
-    if (uiSource == 1) return treeSelectedDir->isReachable();
-    if (uiSource == 2) return tableSelectedDir->isReachable();
-    return false;
+    DDir* dir = NULL;
+    if (uiSource == 1) dir = treeSelectedDir;
+    if (uiSource == 2) dir = tableSelectedDir;
+    if (!dir) return false;
+    return reachability.query(dir->getRootPath(), dir->getFullPath()).isDir;
 }
 
 bool MainWindow::allowFileOpen()
 {
-    return tableSelectedFile->isReachable();
+    return reachability.query(tableSelectedFile->getRootPath(), tableSelectedFile->getFullPath()).exists;
 }
 
 bool MainWindow::allowFileOpenContaining()
 {
-     return tableSelectedFile->isContainerReachable();
+    return reachability.query(tableSelectedFile->getRootPath(), tableSelectedFile->getContainerPath()).isDir;
 }
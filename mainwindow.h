@@ -22,6 +22,14 @@
 #include <QMainWindow>
 #include <QIcon>
 #include <QLabel>
+#include <QList>
+#include <QPair>
+#include <QPointer>
+#include <QTimer>
+
+#include "reachabilitymonitor.h"
+#include "progressestimator.h"
+#include "jobspanel.h"
 
 namespace Ui {
 class MainWindow;
@@ -35,25 +43,34 @@ class DFile;
 class DDir;
 class TableModel;
 class Cataloguer;
+class Reclaimer;
+class DiskTransfer;
 class BackgroundTask;
+class Backup;
 class QProgressDialog;
+class DlgScanProgress;
 class QSortFilterProxyModel;
 class SearchModel;
 class SearchResult;
+class DlgDuplicates;
+class DlgLargest;
 
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 
 public:
-    explicit MainWindow(QWidget *parent, const QString& cliDBFile);
+    explicit MainWindow(QWidget *parent, const QString& cliDBFile, const QString& cliResumeDisk);
     ~MainWindow();
     static QWidget* msgboxParent();
 
 public slots:
-    void updateCataloguerProgress(qint64 numObjects);
+    void cataloguerEstimate(qint64 numObjects, qint64 numBytes, qint64 objectsDone, qint64 bytesDone);
+    void updateCataloguerProgress(qint64 numObjects, qint64 numBytes);
     void cataloguerFinished(NodeDisk* newDisk);
-    void updateCataloguerReindexing();
+    void updateCataloguerReindexing(qint64 rowsToIndex);
+    void updateCataloguerReindexProgress(qint64 rowsIndexed);
+    void updateCataloguerHashing(qint64 bytesDone, qint64 bytesTotal, qint64 bytesPerSec);
 
 private slots:
     void on_actionQuit_triggered();
@@ -65,6 +82,9 @@ private slots:
     void on_actionDatabaseLoad_triggered();
     void on_actionDatabaseClose_triggered();
     void on_actionDatabaseProperties_triggered();
+    void on_actionDatabaseDuplicates_triggered();
+    void on_actionLargest_triggered();
+    void on_actionDatabaseBuildImage_triggered();
     void on_actionCatalogueNew_triggered();
     void on_actionCatalogueDelete_triggered();
     void on_actionCatalogueRename_triggered();
@@ -72,10 +92,16 @@ private slots:
     void on_actionDiskMount_triggered();
     void on_actionDiskUnmount_triggered();
     void on_actionDiskUpdate_triggered();
+    void on_actionDiskResume_triggered();
     void on_actionDiskRename_triggered();
     void on_actionDiskMove_triggered();
     void on_actionDiskProperties_triggered();
     void on_actionDiskDelete_triggered();
+    void on_actionDiskExport_triggered();
+    void on_actionDiskImport_triggered();
+    void on_actionDatabaseMerge_triggered();
+    void on_actionDatabaseBackup_triggered();
+    void on_actionDatabaseSnapshots_triggered();
     void on_actionFileOpen_triggered();
     void on_actionDirOpen_triggered();
     void on_actionFileOpenContaining_triggered();
@@ -103,14 +129,29 @@ private slots:
     void tableView_s_current_changed(const QModelIndex&, const QModelIndex&);
     void focusChanged(QWidget* old, QWidget* now);
     void cataloguerAbort();
+    void cataloguerLimitsChanged(qint64 maxObjectsPerSec, qint64 maxMBPerSec);
+    void resumeNamedDisk();
     void handleDoSearch(QString);
     void handleLocSearchGotFocus();
     void handleLocSearchLostFocus();
     void handleLocSearchEsc();
-    void backgroundTaskFinished();
-    void catalogueDeleteFinsihed(NodeCatalogue*, bool);
-    void diskDeleteFinsihed(NodeDisk*, bool);
+    void imageBuildFinished();
+    void compactionStarting();
+    void compactionFinished(const QString& tempFileName);
+    void takeSnapshot();
+    void showReindexProgress();
+    void backupProgress(int percent);
+    void backupAbort();
+    void backupFinished(bool ok);
+    void diskTransferProgress(qint64 numObjects);
+    void diskTransferAbort();
+    void diskTransferFinished(bool ok);
+    void reclaimerProgress(qint64 numObjects);
+    void reclaimerFinished();
+    void writeFinished(quint64 ticket, int op, qint64 id, bool ok);
+    void reachabilityUpdated();
     void requestRenameDisk(qint64 diskID, QString newName);
+    void showLocation(QList<QPair<qint64,qint64>> fullIDLocation);
 
 private:
     static QWidget* mainwindow;
@@ -123,8 +164,27 @@ private:
     TableModel* fm = NULL;
     QSortFilterProxyModel* fms = NULL;
     Cataloguer* runningCataloguer = NULL;
+    quint64 cataloguerJob = 0;
+    QString cliResumeDisk;
+    ProgressEstimator catEstimate;
+    bool catEstimateBytes = false;
+    QTimer reindexTimer;
     QProgressDialog* progressDialog = NULL;
-    BackgroundTask* backgroundTask = NULL;
+    DlgScanProgress* scanProgress = NULL;
+    DiskTransfer* runningTransfer = NULL;
+    quint64 transferJob = 0;
+    BackgroundTask* runningImageBuild = NULL;
+    quint64 imageBuildJob = 0;
+    bool imageBuildOK = false;
+    Backup* runningBackup = NULL;
+    quint64 backupJob = 0;
+    bool backupIsSnapshot = false;
+    QTimer snapshotTimer;
+    Reclaimer* runningReclaimer = NULL;
+    quint64 reclaimerJob = 0;
+    bool reclaimPending = false;
+    QLabel reclaimLabel;
+    JobsPanel jobsPanel;
     SearchModel* searchModel = NULL;
     QLabel statusLabel;
     bool statusLabelHold = false;
@@ -133,11 +193,15 @@ private:
     DDir* treeSelectedDir = NULL;
     NodeDisk* tableSelectedDisk = NULL;
     SearchResult* searchCurrentResult = NULL;
+    ReachabilityMonitor reachability;
+    QPointer<DlgDuplicates> dlgDuplicates;
+    QPointer<DlgLargest> dlgLargest;
 
     bool getConfigDatabase();
     void tableToFilesDirs();
     void setLocationText();
     Node* getCurrentTreeItem() const;
+    NodeCatalogue* getCurrentCatalogue() const;
     void databaseJustOpened();
     void returnFromSearch();
     void addNewDiskToAll(NodeDisk *disk);
@@ -150,10 +214,25 @@ private:
     bool allowFileOpen();
     bool allowFileOpenContaining();
     bool allowDiskOpen();
+    void setSearchResultActions(SearchResult* sr);
     NodeDisk* getCurrentDisk(QModelIndex* usQmi) const;
     void navigateToSearchResult();
+    void navigateToLocation(const QList<QPair<qint64,qint64>>& fullIDLocation);
     bool dfSelectedDirAccessCheck();
     void clearDataIfLast();
+    void catalogueDeleted(NodeCatalogue* catToDel);
+    void diskDeleted(NodeDisk* diskToDel);
+    void startCataloguer(Cataloguer* cataloguer, NodeDisk* disk, QModelIndex disk_usQmi);
+    void startDiskTransfer(DiskTransfer* transfer, const QString& title);
+    void startReclaimer();
+    void stopReclaimer();
+    void startBackup(const QString& destFileName, bool snapshot);
+    void stopBackup();
+    void setupSnapshotTimer();
+    QString compactionBlocker() const;
+
+    const static int SNAPSHOTS_KEPT = 10; // Unless overridden by the snapshotkeep setting
+    const static int REINDEX_ROWS_PER_SEC = 1000000; // First guess, until a real figure has been measured
 
 protected:
     virtual void closeEvent(QCloseEvent *event);
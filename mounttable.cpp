@@ -0,0 +1,114 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSet>
+#include <QStringList>
+
+#include "mounttable.h"
+
+void MountTable::load(const QString& startPath)
+{
+    byPoint.clear();
+    startSource.clear();
+
+    QFile mountInfo("/proc/self/mountinfo");
+    if (!mountInfo.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qDebug() << "MountTable: can't read /proc/self/mountinfo, mount points will only be found by device";
+        return;
+    }
+
+    // Fields: id parent major:minor root mountpoint options [optional...] - fstype source superoptions
+    while (!mountInfo.atEnd())
+    {
+        QStringList fields = QString::fromUtf8(mountInfo.readLine()).trimmed().split(' ');
+        int dash = fields.indexOf("-");
+        if ((dash < 5) || ((dash + 2) >= fields.size())) continue;
+
+        Mount m;
+        m.fsType = fields[dash + 1];
+        m.source = unescape(fields[dash + 2]);
+        byPoint.insert(unescape(fields[4]), m); // Later lines are mounted over earlier ones
+    }
+
+    // The start is on the mount with the longest mount point above it
+    QString start = QDir(startPath).canonicalPath();
+    int bestLength = -1;
+    for (QHash<QString, Mount>::const_iterator it = byPoint.constBegin(); it != byPoint.constEnd(); ++it)
+    {
+        const QString& point = it.key();
+        bool above = (point == "/") || (start == point) || start.startsWith(point + "/");
+        if (above && (point.size() > bestLength))
+        {
+            bestLength = point.size();
+            startSource = it.value().source;
+        }
+    }
+}
+
+bool MountTable::mayEnter(const QString& canonicalPath, quint64 dev, quint64 parentDev, int policy) const
+{
+    QHash<QString, Mount>::const_iterator it = byPoint.constFind(canonicalPath);
+    bool mountPoint = (it != byPoint.constEnd());
+
+    if (!mountPoint && (dev == parentDev)) return true; // An ordinary directory
+    if (policy == POLICY_ONE_FILESYSTEM) return false;
+    if (!mountPoint) return true; // A btrfs subvolume that isn't mounted on its own, still the same filesystem
+    if (isPseudo(it.value().fsType)) return false;
+    if (policy == POLICY_ALL) return true;
+    return (it.value().source == startSource);
+}
+
+QString MountTable::unescape(const QString& field)
+{
+    // Spaces, tabs, newlines and backslashes in paths are written as \ooo octal
+    if (!field.contains('\\')) return field;
+
+    QByteArray in = field.toUtf8();
+    QByteArray out;
+    for (int i = 0; i < in.size(); i++)
+    {
+        if ((in[i] == '\\') && ((i + 3) < in.size()))
+        {
+            bool ok;
+            int c = in.mid(i + 1, 3).toInt(&ok, 8);
+            if (ok)
+            {
+                out.append(static_cast<char>(c));
+                i += 3;
+                continue;
+            }
+        }
+        out.append(in[i]);
+    }
+    return QString::fromUtf8(out);
+}
+
+bool MountTable::isPseudo(const QString& fsType)
+{
+    static const QSet<QString> pseudo =
+    {
+        "proc", "sysfs", "devtmpfs", "devpts", "tmpfs", "ramfs", "cgroup", "cgroup2", "securityfs",
+        "debugfs", "tracefs", "pstore", "bpf", "configfs", "fusectl", "mqueue", "hugetlbfs",
+        "autofs", "binfmt_misc", "efivarfs", "rpc_pipefs", "nsfs", "selinuxfs", "fuse.gvfsd-fuse",
+        "fuse.portal"
+    };
+    return pseudo.contains(fsType);
+}
@@ -0,0 +1,60 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOUNTTABLE_H
+#define MOUNTTABLE_H
+
+#include <QHash>
+#include <QString>
+
+/* Decides where the Cataloguer's walk may cross from one mount to another. The
+ * mount table (/proc/self/mountinfo) is read once per scan. After that each
+ * directory only needs the st_dev from one lstat and a hash lookup. Before this,
+ * a QStorageInfo was set up for every directory, which re-reads the mount table
+ * each time.
+ *
+ * Policies, per disk:
+ *   POLICY_ONE_FILESYSTEM  Enter no mount point and no directory on another device
+ *   POLICY_SAME_DEVICE     Also enter bind mounts and btrfs subvolumes from the same
+ *                          device as the start (the default, and the old behaviour)
+ *   POLICY_ALL             Enter any filesystem
+ * Pseudo filesystems (proc, sysfs, tmpfs, ...) are never entered.
+ */
+
+class MountTable
+{
+public:
+    enum Policy { POLICY_ONE_FILESYSTEM = 0, POLICY_SAME_DEVICE = 1, POLICY_ALL = 2 };
+
+    void load(const QString& startPath);
+    bool mayEnter(const QString& canonicalPath, quint64 dev, quint64 parentDev, int policy) const;
+
+private:
+    struct Mount
+    {
+        QString source;
+        QString fsType;
+    };
+
+    static QString unescape(const QString& field);
+    static bool isPseudo(const QString& fsType);
+
+    QHash<QString, Mount> byPoint;
+    QString startSource;
+};
+
+#endif // MOUNTTABLE_H
@@ -15,26 +15,33 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <QDebug>
 #include <QSqlQuery>
-#include <QSqlTableModel>
 
 #include "globals.h"
 #include "noderoot.h"
 #include "nodecatalogue.h"
 #include "nodedisk.h"
+#include "nodedir.h"
+#include "catimage.h"
 #include "utils.h"
 
 #include "node.h"
 
 NodeRoot* Node::rootNode = NULL;
+QSet<QString> Node::namePool;
+QHash<quint64, Node*> Node::nodeIndex;
 
 Node::Node(qint64 t_type, qint64 t_id, const QString& t_name)
-    : type(t_type), id(t_id), name(t_name)
+    : id(t_id), name(t_name), type(static_cast<qint8>(t_type))
 {}
 
 Node::~Node()
 {
+    QHash<quint64, Node*>::iterator it = nodeIndex.find(indexKey(type, id));
+    if ((it != nodeIndex.end()) && (it.value() == this)) nodeIndex.erase(it);
+
     for(auto item : children) delete item;
 }
 
@@ -44,6 +51,22 @@ void Node::createRoot()
     rootNode->loadChildren();
 }
 
+void Node::destroyRoot()
+{
+    delete rootNode;
+    rootNode = NULL;
+    namePool.clear();
+    nodeIndex.clear();
+}
+
+// Directory names repeat a lot across a big tree (src, lib, .git, ...)
+// so all NodeDirs share one copy of each name. GUI thread only
+QString Node::internName(const QString& t_name)
+{
+    if (t_name.isNull()) return t_name;
+    return *namePool.insert(t_name);
+}
+
 qint64 Node::numChildren() const
 {
     return children.size();
@@ -62,35 +85,133 @@ bool Node::hasChildren()
     return (children.size() > 0);
 }
 
+// Cheap answer for the view before the children are loaded. The default loads
+// them, which is fine for the root and catalogues (the disks table is small).
+// Disks and directories override this to answer from data they already hold
+bool Node::mayHaveChildren()
+{
+    return hasChildren();
+}
+
 void Node::addChild(Node* newChild)
 {
     Q_ASSERT(! ((type == TYPE_ROOT) && (newChild->getType() == TYPE_DIR)) );
     Q_ASSERT(! ((type == TYPE_CAT) && (newChild->getType() != TYPE_DISK)) );
     Q_ASSERT(! ((type == TYPE_DISK) && (newChild->getType() != TYPE_DIR)) );
     Q_ASSERT(! ((type == TYPE_DIR) && (newChild->getType() != TYPE_DIR)) );
-    newChild->siblingIndex = numChildren();
+    newChild->siblingIndex = static_cast<qint32>(numChildren());
     newChild->parent = this;
     children.append(newChild);
+    newChild->indexSubtree();
 }
 
-void Node::removeChild(Node* toDel)
+// Directory levels arrive in name order from the database. Catalogues and disks are few,
+// so those levels keep themselves in order here, the way the tree used to sort them
+void Node::insertChild(Node* newChild, qint64 row)
+{
+    newChild->parent = this;
+    children.insert(static_cast<int>(row), newChild);
+    renumberChildren(row, children.size() - 1);
+    newChild->indexSubtree();
+}
+
+void Node::moveChild(Node* child, qint64 row)
+{
+    qint64 from = child->siblingIndex;
+    if (from == row) return;
+    children.move(static_cast<int>(from), static_cast<int>(row));
+    renumberChildren(qMin(from, row), qMax(from, row));
+}
+
+// Where a child of this name belongs, after any others of the same name
+qint64 Node::rowForName(const QString& childName, const Node* skip) const
+{
+    qint64 row = 0;
+    for (const Node* child : children)
+    {
+        if (child == skip) continue;
+        if (QString::compare(childName, child->name, Qt::CaseInsensitive) < 0) break;
+        ++row;
+    }
+    return row;
+}
+
+void Node::sortChildren()
+{
+    std::stable_sort(children.begin(), children.end(), [] (const Node* a, const Node* b)
+    {
+        return QString::compare(a->name, b->name, Qt::CaseInsensitive) < 0;
+    });
+    renumberChildren(0, children.size() - 1);
+}
+
+void Node::renumberChildren(qint64 from, qint64 to)
+{
+    for (qint64 i = from; i <= to; i++) children[static_cast<int>(i)]->siblingIndex = static_cast<qint32>(i);
+}
+
+void Node::addDirChildren(const QVector<DirRow>& rows)
 {
-    QVector<Node*>::iterator it = children.begin();
-    QVector<Node*>::iterator after;
-    while (*it != toDel) ++it;
+    children.reserve(children.size() + rows.size());
+    for (const DirRow& row : rows)
+    {
+        addChild(new NodeDir(row.id, row.name, row.accessDenied, row.hasSubDirs));
+    }
+    childrenLoaded = true;
+}
 
-    if (it == children.end())
+bool Node::loadDirChildren(qint64 parentDirID)
+{
+    QVector<DirRow> rows;
+    QSharedPointer<const CatImage> image = CatImage::current();
+    if (!image || !image->dirChildren(parentDirID, rows))
+    {
+        if (!NodeDir::queryChildren(db.getSQLiteHandle(), parentDirID, rows)) return false;
+    }
+    addDirChildren(rows);
+    return true;
+}
+
+void Node::removeChild(Node* toDel)
+{
+    if ((toDel->parent != this) || (toDel->siblingIndex >= children.size()) || (children[toDel->siblingIndex] != toDel))
     {
         qDebug() << "Error, TreeItem::deleteChild failed to find child in vector";
         return;
     }
 
-    after = children.erase(it);
+    QVector<Node*>::iterator after = children.erase(children.begin() + toDel->siblingIndex);
 
     for (; after != children.end(); after++)
     {
         --(*after)->siblingIndex;
     }
+
+    toDel->unindexSubtree();
+}
+
+void Node::clearChildren()
+{
+    for(auto item : children) delete item;
+    children.clear();
+    childrenLoaded = false;
+}
+
+Node* Node::findNode(qint64 t_type, qint64 t_id)
+{
+    return nodeIndex.value(indexKey(t_type, t_id), NULL);
+}
+
+void Node::indexSubtree()
+{
+    nodeIndex.insert(indexKey(type, id), this);
+    for(auto item : children) item->indexSubtree();
+}
+
+void Node::unindexSubtree()
+{
+    nodeIndex.remove(indexKey(type, id));
+    for(auto item : children) item->unindexSubtree();
 }
 
 QString Node::dirStats(qint64 dirID)
@@ -129,36 +250,58 @@ bool Node::rename(const QString&)
     return false;
 }
 
-void Node::eachDiskInModel(QSqlTableModel& disksModel, std::function<void (NodeDisk*)> func)
+// Builds NodeDisks for the disks rows matching filter (columns qualified with
+// "disks."), root directory IDs included, in one query. Walking the root
+// directories by the parent index and looking each disk up by its rowid keeps
+// this linear in the number of disks (cross join stops SQLite reordering it)
+bool Node::eachDisk(const QString& filter, std::function<void (NodeDisk*)> func)
 {
-    qint64 numDisks = disksModel.rowCount();
-    for (qint64 i = 0; i < numDisks; i++)
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (!query.exec(QString("select disks.id, disks.catid, disks.name, disks.catpath, disks.cattime, disks.devname, "
+                            "disks.fslabel, disks.fstype, disks.fssize, disks.fsfree, disks.isroot, disks.mountcmd, "
+                            "disks.umountcmd, disks.uuid, disks.numdirs, disks.numfiles, disks.totalsize, "
+                            "disks.hashcontents, disks.excludes, disks.mountpolicy, disks.partial, disks.scanlast, disks.updateid, r.id "
+                            "from directories r indexed by directories_parent_idx "
+                            "cross join disks on disks.id = r.diskid "
+                            "where r.parent = 0 and %1 "
+                            "order by disks.id").arg(filter)))
+    {
+        qDebug() << "Node::eachDisk query failed:" << filter;
+        return false;
+    }
+
+    while (query.next())
     {
         NodeDisk* newDisk = new NodeDisk(
-        /*id*/                  disksModel.data(disksModel.index(i, 0), Qt::DisplayRole).toLongLong(),
-        /*catid*/               disksModel.data(disksModel.index(i, 1), Qt::DisplayRole).toLongLong(),
-        /*name*/                disksModel.data(disksModel.index(i, 2), Qt::DisplayRole).toString(),
-        /*catpath*/             disksModel.data(disksModel.index(i, 3), Qt::DisplayRole).toString(),
-        /*cattime*/             disksModel.data(disksModel.index(i, 4), Qt::DisplayRole).toLongLong(),
-        /*devname*/             disksModel.data(disksModel.index(i, 5), Qt::DisplayRole).toString(),
-        /*fslabel*/             disksModel.data(disksModel.index(i, 6), Qt::DisplayRole).toString(),
-        /*fstype*/              disksModel.data(disksModel.index(i, 7), Qt::DisplayRole).toString(),
-        /*fssize*/              disksModel.data(disksModel.index(i, 8), Qt::DisplayRole).toLongLong(),
-        /*fsfree*/              disksModel.data(disksModel.index(i, 9), Qt::DisplayRole).toLongLong(),
-        /*isroot*/              disksModel.data(disksModel.index(i, 10), Qt::DisplayRole).toInt(),
-        /*mountcmd*/            disksModel.data(disksModel.index(i, 11), Qt::DisplayRole).toString(),
-        /*umountcmd*/           disksModel.data(disksModel.index(i, 12), Qt::DisplayRole).toString(),
-        /*uuid*/                disksModel.data(disksModel.index(i, 13), Qt::DisplayRole).toString()
+        /*id*/                  query.value(0).toLongLong(),
+        /*catid*/               query.value(1).toLongLong(),
+        /*name*/                query.value(2).toString(),
+        /*catpath*/             query.value(3).toString(),
+        /*cattime*/             query.value(4).toLongLong(),
+        /*devname*/             query.value(5).toString(),
+        /*fslabel*/             query.value(6).toString(),
+        /*fstype*/              query.value(7).toString(),
+        /*fssize*/              query.value(8).toLongLong(),
+        /*fsfree*/              query.value(9).toLongLong(),
+        /*isroot*/              query.value(10).toInt(),
+        /*mountcmd*/            query.value(11).toString(),
+        /*umountcmd*/           query.value(12).toString(),
+        /*uuid*/                query.value(13).toString()
+                            );
+
+        newDisk->setCounts(
+        /*numdirs*/             query.value(14).toLongLong(),
+        /*numfiles*/            query.value(15).toLongLong(),
+        /*totalsize*/           query.value(16).toLongLong()
                             );
+        newDisk->setHashContents(query.value(17).toInt() > 0);
+        newDisk->setScanRules(query.value(18).toString(), query.value(19).toInt());
+        newDisk->setPartial(query.value(20).toInt() > 0, query.value(21).toString());
+        newDisk->setUpdateID(query.value(22).toLongLong());
+        newDisk->setRootDirID(query.value(23).toLongLong());
 
-        if (!newDisk->loadRootDirID())
-        {
-            Utils::errorMessageBox(QString("Database Error:\neachDiskInModel: Failed to load root dir ID for disk %1").arg(newDisk->getID()));
-            delete newDisk;
-        }
-        else
-        {
-            func(newDisk);
-        }
+        func(newDisk);
     }
+    return true;
 }
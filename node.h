@@ -21,11 +21,13 @@
 #include <functional>
 #include <QVector>
 #include <QString>
-#include <QSqlTableModel>
+#include <QSet>
+#include <QHash>
 
 class NodeRoot;
 class NodeCatalogue;
 class NodeDisk;
+struct DirRow;
 
 class Node
 {
@@ -41,29 +43,55 @@ public:
     qint64 numChildren() const;
     Node* getChild(qint64 index) const;
     bool hasChildren();
+    bool isChildrenLoaded() const { return childrenLoaded; }
+    virtual bool mayHaveChildren();
     void addChild(Node* newChild);
+    void insertChild(Node* newChild, qint64 row);
+    void moveChild(Node* child, qint64 row);
+    qint64 rowForName(const QString& childName, const Node* skip = NULL) const;
+    void sortChildren();
+    void addDirChildren(const QVector<DirRow>& rows);
     void removeChild(Node* toDel);
+    void clearChildren();
+    void setChildrenLoaded() { childrenLoaded = true; }
 
     virtual bool rename(const QString& value);
     virtual bool loadChildren() =0;
     virtual QString summaryText() const =0;
 
     static void createRoot();
+    static void destroyRoot();
     static NodeRoot* getRootNode() { return rootNode; }
+    static Node* findNode(qint64 type, qint64 id);
     static QString dirStats(qint64 dirID);
-    static void eachDiskInModel(QSqlTableModel& disksModel, std::function<void (NodeDisk *)> func);
+    static bool eachDisk(const QString& filter, std::function<void (NodeDisk *)> func);
 
 protected:
     Node(qint64 type, qint64 id, const QString& name);
     static NodeRoot* rootNode;
-    Node* parent;
-    bool childrenLoaded = false;
-    qint64 siblingIndex;
-    QVector<Node*> children;
+    static QString internName(const QString& name);
+    bool loadDirChildren(qint64 parentDirID);
 
-    qint64 type;
+    // Field order is deliberate: the small members at the end share one
+    // 8 byte slot (and NodeDir's flag lives in the tail padding), keeping
+    // a NodeDir at 48 bytes
+    Node* parent = NULL;
+    QVector<Node*> children;
     qint64 id;
     QString name;
+    qint32 siblingIndex = 0;
+    qint8 type;
+    bool childrenLoaded = false;
+
+private:
+    static QSet<QString> namePool;
+
+    // Every node attached under the root, by type and id. GUI thread only
+    static QHash<quint64, Node*> nodeIndex;
+    static quint64 indexKey(qint64 type, qint64 id) { return (static_cast<quint64>(type) << 56) | static_cast<quint64>(id); }
+    void indexSubtree();
+    void unindexSubtree();
+    void renumberChildren(qint64 from, qint64 to);
 };
 
 #endif // NODE_H
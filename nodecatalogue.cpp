@@ -16,14 +16,15 @@
  */
 
 #include <QDebug>
+#include <QLocale>
 #include <QSqlQuery>
-#include <QSqlTableModel>
 
 #include "globals.h"
 #include "db.h"
 #include "utils.h"
 #include "nodedisk.h"
 #include "utils.h"
+#include "dbwriter.h"
 
 #include "nodecatalogue.h"
 
@@ -36,48 +37,35 @@ bool NodeCatalogue::rename(const QString& _newName)
     QString newName = _newName.trimmed();
     if (newName.isEmpty()) return false;
 
-    if (!db.startTransaction()) { Utils::errorMessageBox("Database Error:\nrename: Transaction start error"); return false; }
+    dbWriter.submit(DBWriter::renameCatalogue(id, newName));
+    name = newName;
+    return true;
+}
 
+// The name back as the database has it. False if the catalogue has gone
+bool NodeCatalogue::reloadFromDB()
+{
     QSqlQuery query;
-    query.prepare("update catalogues set name = :newname where id = :id");
-    query.bindValue(":newname", newName);
-    query.bindValue(":id", id);
-    if (query.exec())
-    {
-        if (db.commitTransaction())
-        {
-            name = newName;
-            return true;
-        }
-        return false;
-    }
-    else
-    {
-        db.rollbackTransaction();
-        return false;
-    }
+    if (!query.exec(QString("select name from catalogues where id = %1").arg(id))) return false;
+    if (!query.next()) return false;
+
+    name = query.value(0).toString();
+    return true;
 }
 
 bool NodeCatalogue::loadChildren()
 {
-    QSqlTableModel disksModel;
-    disksModel.setTable("disks");
-    disksModel.setEditStrategy(QSqlTableModel::OnManualSubmit);
-    disksModel.setFilter(QString("catid = %1").arg(id));
-
-    if (!disksModel.select())
+    // Normally done for every catalogue at once by NodeRoot::loadChildren. This is for new catalogues
+    if (!Node::eachDisk(QString("disks.catid = %1 and disks.deleted = 0").arg(id), [&] (NodeDisk* newDisk)
+    {
+        addChild(newDisk);
+    }))
     {
         Utils::errorMessageBox("RootNode: Failed to execute disks query");
         return false;
     }
 
-    while(disksModel.canFetchMore()) disksModel.fetchMore();
-
-    Node::eachDiskInModel(disksModel, [&] (NodeDisk* newDisk)
-    {
-        addChild(newDisk);
-    });
-
+    sortChildren();
     childrenLoaded = true;
     return true;
 }
@@ -85,61 +73,28 @@ bool NodeCatalogue::loadChildren()
 
 QString NodeCatalogue::summaryText() const
 {
-    QString text = "Catalogue: " + name + ". " + QString::number(numChildren()) + " disks.";
-    return text;
-}
-
-void NodeCatalogue::removeFromDB()
-{
-    if (!db.startTransaction())
-    {
-        Utils::errorMessageBox("Database Error:\nremoveFromDB: Start transaction error");
-        deleteFinished(this, false);
-        return;
-    }
+    QString text = "Catalogue: " + name + ". ";
 
     QSqlQuery query;
-    if (!query.exec(QString("delete from files where dirid in (select id from directories where diskid in (select id from disks where catid = %1))").arg(id)))
-    {
-        Utils::errorMessageBox("Database Error:\nremoveFromDB: Query 1 fail");
-        db.rollbackTransaction();
-        deleteFinished(this, false);
-        return;
-    }
-
-    if (!query.exec(QString("delete from directories where diskid in (select id from disks where catid = %1)").arg(id)))
-    {
-        Utils::errorMessageBox("Database Error:\nremoveFromDB: Query 2 fail");
-        db.rollbackTransaction();
-        deleteFinished(this, false);
-        return;
-    }
-
-    if (!query.exec(QString("delete from disks where catid = %1").arg(id)))
-    {
-        Utils::errorMessageBox("Database Error:\nremoveFromDB: Query 3 fail");
-        db.rollbackTransaction();
-        deleteFinished(this, false);
-        return;
-    }
-
-    if (!query.exec(QString("delete from catalogues where id = %1").arg(id)))
+    if (!query.exec(QString("select count(*), ifnull(sum(numdirs), 0), ifnull(sum(numfiles), 0), ifnull(sum(totalsize), 0) "
+                            "from disks where catid = %1 and deleted = 0").arg(id)) || !query.next())
     {
-        Utils::errorMessageBox("Database Error:\nremoveFromDB: Query 4 fail");
-        db.rollbackTransaction();
-        deleteFinished(this, false);
-        return;
+        return text + QString::number(numChildren()) + " disks.";
     }
 
-    if (!db.commitTransaction())
-    {
-        Utils::errorMessageBox("Database Error:\nremoveFromDB: Commit transaction fail");
-        db.rollbackTransaction();
-        deleteFinished(this, false);
-        return;
-    }
+    QLocale locale(QLocale::English);
+    text += locale.toString(query.value(0).toLongLong()) + " disks, ";
+    text += locale.toString(query.value(1).toLongLong()) + " directories, ";
+    text += locale.toString(query.value(2).toLongLong()) + " files (";
+    text += fileSizeToHR(query.value(3).toLongLong()) + ").";
+    return text;
+}
 
-    deleteFinished(this, true);
+bool NodeCatalogue::removeFromDB()
+{
+    // Tombstones the catalogue's disks, through the writer. The Reclaimer removes their directories and files later
+    dbWriter.submit(DBWriter::deleteCatalogue(id));
+    return true;
 }
 
 NodeCatalogue* NodeCatalogue::createCatalogue(const QString& name)
@@ -159,9 +114,7 @@ NodeCatalogue* NodeCatalogue::createCatalogue(const QString& name)
 
 NodeDisk* NodeCatalogue::diskFromID(qint64 diskID) const
 {
-    for (qint64 i = 0; i < Node::children.size(); i++)
-    {
-        if (Node::children[i]->getID() == diskID) return static_cast<NodeDisk*>(Node::children[i]);
-    }
+    Node* n = findNode(TYPE_DISK, diskID);
+    if (n && (n->getParent() == this)) return static_cast<NodeDisk*>(n);
     return NULL;
 }
@@ -32,15 +32,13 @@ class NodeCatalogue : public QObject, public Node
 public:
     NodeCatalogue(qint64 id, const QString& name);
     bool rename(const QString& newName);
+    bool reloadFromDB();
     virtual bool loadChildren();
     virtual QString summaryText() const;
-    void removeFromDB();
+    bool removeFromDB();
     NodeDisk* diskFromID(qint64 id) const;
 
     static NodeCatalogue* createCatalogue(const QString &name);
-
-signals:
-    void deleteFinished(NodeCatalogue*, bool);
 };
 
 #endif // NODECATALOGUE_H
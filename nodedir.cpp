@@ -16,38 +16,87 @@
  */
 
 #include <QDebug>
-#include <QSqlTableModel>
+#include <QMutex>
 
 #include "globals.h"
+#include "sqlstatement.h"
 
 #include "nodedir.h"
 
-NodeDir::NodeDir(qint64 t_id, const QString& t_name, int t_accessDenied)
-    : Node(TYPE_DIR, t_id, t_name)
+namespace
 {
-    if (t_accessDenied > 0) accessDenied = true;
+    struct FreeSlot { FreeSlot* next; };
+    FreeSlot* freeList = NULL;
+    const int SLOTS_PER_SLAB = 1024;
+
+    // Nodes are created in the GUI thread but a disk's children can be freed by the cataloguer
+    QMutex slabMutex;
 }
 
-bool NodeDir::loadChildren()
+void* NodeDir::operator new(size_t size)
 {
-    QSqlTableModel dirsModel;
-    dirsModel.setTable("directories");
-    dirsModel.setEditStrategy(QSqlTableModel::OnManualSubmit);
-    dirsModel.setFilter(QString("parent = %1").arg(id));
-    if (!dirsModel.select()) return false;
-    while(dirsModel.canFetchMore()) dirsModel.fetchMore();
+    if (size != sizeof(NodeDir)) return ::operator new(size);
 
-    qint64 numDirs = dirsModel.rowCount();
-    for (qint64 i = 0; i < numDirs; i++)
+    QMutexLocker locker(&slabMutex);
+    if (!freeList)
     {
-        NodeDir* newDir = new NodeDir(dirsModel.data(dirsModel.index(i, 0), Qt::DisplayRole).toLongLong(),
-                                      dirsModel.data(dirsModel.index(i, 4), Qt::DisplayRole).toString(),
-                                      dirsModel.data(dirsModel.index(i, 9), Qt::DisplayRole).toInt());
-        addChild(newDir);
+        // Slabs are kept for the life of the process and their slots recycled
+        char* slab = static_cast<char*>(::operator new(sizeof(NodeDir) * SLOTS_PER_SLAB));
+        for (int i = SLOTS_PER_SLAB - 1; i >= 0; --i)
+        {
+            FreeSlot* slot = reinterpret_cast<FreeSlot*>(slab + (sizeof(NodeDir) * static_cast<size_t>(i)));
+            slot->next = freeList;
+            freeList = slot;
+        }
+    }
+
+    FreeSlot* slot = freeList;
+    freeList = slot->next;
+    return slot;
+}
+
+void NodeDir::operator delete(void* p, size_t size)
+{
+    if (!p) return;
+    if (size != sizeof(NodeDir)) { ::operator delete(p); return; }
+
+    QMutexLocker locker(&slabMutex);
+    FreeSlot* slot = static_cast<FreeSlot*>(p);
+    slot->next = freeList;
+    freeList = slot;
+}
+
+NodeDir::NodeDir(qint64 t_id, const QString& t_name, bool t_accessDenied, bool t_hasSubDirs)
+    : Node(TYPE_DIR, t_id, internName(t_name)), accessDenied(t_accessDenied), hasSubDirs(t_hasSubDirs)
+{
+}
+
+bool NodeDir::mayHaveChildren()
+{
+    return hasSubDirs;
+}
 
+bool NodeDir::loadChildren()
+{
+    return loadDirChildren(id);
+}
+
+// Each row carries whether that directory has subdirectories of its own, so the tree
+// can show expanders without loading another level. directories_parent_idx covers the
+// whole query and hands the rows back already in name order
+bool NodeDir::queryChildren(sqlite3* handle, qint64 parentDirID, QVector<DirRow>& rows)
+{
+    SqlStatement query;
+    if (!query.prepare(handle, "select id, name, accessdenied, "
+                               "exists (select 1 from directories as sub where sub.parent = directories.id) "
+                               "from directories where parent = ? order by name collate nocase")) return false;
+    query.bind(1, parentDirID);
+
+    while (query.next())
+    {
+        rows.append({ query.int64(0), query.text(1), query.integer(2) > 0, query.integer(3) > 0 });
     }
-    childrenLoaded = true;
-    return true;
+    return !query.failed();
 }
 
 QString NodeDir::summaryText() const
@@ -18,18 +18,41 @@
 #ifndef NODEDIR_H
 #define NODEDIR_H
 
+#include <QMetaType>
+
 #include "node.h"
 
+struct sqlite3;
+
+// One child directory row, as loaded on either the GUI or the child loader connection
+struct DirRow
+{
+    qint64 id;
+    QString name;
+    bool accessDenied;
+    bool hasSubDirs;
+};
+
+Q_DECLARE_METATYPE(DirRow)
+
 class NodeDir : public Node
 {
 public:
-    NodeDir(qint64 id, const QString& name, int t_accessDenied);
+    NodeDir(qint64 id, const QString& name, bool accessDenied, bool hasSubDirs);
     bool isAccessDenied() const { return accessDenied; }
+    virtual bool mayHaveChildren();
     virtual bool loadChildren();
     virtual QString summaryText() const;
 
+    static bool queryChildren(sqlite3* handle, qint64 parentDirID, QVector<DirRow>& rows);
+
+    // NodeDirs are by far the most numerous nodes, so they come from a slab pool
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+
 private:
     bool accessDenied = false;
+    bool hasSubDirs = false;
 };
 
 #endif // NODEDIR_H
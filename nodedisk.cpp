@@ -25,11 +25,13 @@
 #include <QDateTime>
 #include <QDesktopServices>
 #include <QUrl>
+#include <QLocale>
 
 #include "globals.h"
 #include "db.h"
 #include "nodedir.h"
 #include "utils.h"
+#include "dbwriter.h"
 
 #include "nodedisk.h"
 
@@ -43,32 +45,24 @@ NodeDisk::NodeDisk(qint64 t_id, qint64 t_catID, const QString& t_name, const QSt
       mountCommand(t_mountCommand), unmountCommand(t_unmountCommand), uuid(t_uuid)
 {}
 
-bool NodeDisk::loadRootDirID()
-{
-    QSqlQuery getRootDirQuery;
-    if (!getRootDirQuery.exec(QString("select id from directories where diskid = %1 and parent = 0").arg(id))) return false;
-    if (!getRootDirQuery.next()) return false;
-    rootDirID = getRootDirQuery.value(0).toLongLong();
-    return true;
-}
-
-bool NodeDisk::loadRootDirID(QSqlQuery& getRootDirQuery)
+bool NodeDisk::moveToCatalogue(qint64 newCat)
 {
-    if (!getRootDirQuery.exec(QString("select id from directories where diskid = %1 and parent = 0").arg(id))) return false;
-    if (!getRootDirQuery.next()) return false;
-    rootDirID = getRootDirQuery.value(0).toLongLong();
+    dbWriter.submit(DBWriter::moveDisk(id, newCat));
+    catID = newCat;
     return true;
 }
 
-bool NodeDisk::moveToCatalogue(qint64 newCat)
+// The edits the GUI can make, back as the database has them. False if the disk has gone
+bool NodeDisk::reloadFromDB()
 {
     QSqlQuery query;
-    if (!query.exec(QString("update disks set catid = %1 where id = %2").arg(newCat).arg(id)))
-    {
-        Utils::errorMessageBox("Database Error:\ncmoveToCatalogue: Query fail");
-        return false;
-    }
-    catID = newCat;
+    if (!query.exec(QString("select catid, name, mountcmd, umountcmd from disks where id = %1 and deleted = 0").arg(id))) return false;
+    if (!query.next()) return false;
+
+    catID = query.value(0).toLongLong();
+    name = query.value(1).toString();
+    mountCommand = query.value(2).toString();
+    unmountCommand = query.value(3).toString();
     return true;
 }
 
@@ -77,41 +71,16 @@ bool NodeDisk::rename(const QString& _newName)
     QString newName = _newName.trimmed();
     if (newName.isEmpty()) return false;
 
-    if (!db.startTransaction()) { Utils::errorMessageBox("Disk::rename: Transaction start error"); return false; }
-
-    QSqlQuery query;
-    query.prepare("update disks set name = :newname where id = :existingid");
-    query.bindValue(":newname", newName);
-    query.bindValue(":existingid", id);
-    if (query.exec())
-    {
-        if (db.commitTransaction())
-        {
-            name = newName;
-            return true;
-        }
-        return false;
-    }
-    else
-    {
-        db.rollbackTransaction();
-        return false;
-    }
+    dbWriter.submit(DBWriter::renameDisk(id, newName));
+    name = newName;
+    return true;
 }
 
 void NodeDisk::setCommands(const QString& newMountCommand, const QString& newUnmountCommand)
 {
-    QSqlQuery query;
-    query.prepare("update disks set mountcmd = :mcom, umountcmd = :umcom where id = :id");
-    query.bindValue(":mcom", newMountCommand);
-    query.bindValue(":umcom", newUnmountCommand);
-    query.bindValue(":id", id);
-
-    if (query.exec())
-    {
-        mountCommand = newMountCommand;
-        unmountCommand = newUnmountCommand;
-    }
+    dbWriter.submit(DBWriter::setDiskCommands(id, newMountCommand, newUnmountCommand));
+    mountCommand = newMountCommand;
+    unmountCommand = newUnmountCommand;
 }
 
 bool NodeDisk::hasMountCommand() const
@@ -199,97 +168,60 @@ void NodeDisk::osOpen() const
         Utils::errorMessageBox("O/S open location failed");
 }
 
+bool NodeDisk::mayHaveChildren()
+{
+    return numDirs > 1; // The root directory is counted
+}
+
 bool NodeDisk::loadChildren()
 {
-    QSqlTableModel dirsModel;
-    dirsModel.setTable("directories");
-    dirsModel.setEditStrategy(QSqlTableModel::OnManualSubmit);
-    dirsModel.setFilter(QString("parent = %1").arg(rootDirID));
-    if (!dirsModel.select()) return false;
-    while(dirsModel.canFetchMore()) dirsModel.fetchMore();
-
-    qint64 numDirs = dirsModel.rowCount();
-    for (qint64 i = 0; i < numDirs; i++)
-    {
-        NodeDir* newDir = new NodeDir(dirsModel.data(dirsModel.index(i, 0), Qt::DisplayRole).toLongLong(),
-                                      dirsModel.data(dirsModel.index(i, 4), Qt::DisplayRole).toString(),
-                                      dirsModel.data(dirsModel.index(i, 9), Qt::DisplayRole).toInt());
-        addChild(newDir);
-    }
-    childrenLoaded = true;
-    return true;
+    return loadDirChildren(rootDirID);
 }
 
 QString NodeDisk::summaryText() const
 {
-    QString text = "Disk: " + name + ". Size: " + fileSizeToHR(fsSize) + ", free: " + fileSizeToHR(fsFree) + ". " + dirStats(rootDirID);
+    QString text = "Disk: " + name + ". Size: " + fileSizeToHR(fsSize) + ", free: " + fileSizeToHR(fsFree) + ". " + dirStats(rootDirID)
+                   + ". Total: " + QLocale(QLocale::English).toString(numDirs) + " directories, "
+                   + QLocale(QLocale::English).toString(numFiles) + " files (" + fileSizeToHR(totalSize) + ").";
+    if (partial) text += " Cataloguing incomplete, stopped after '" + (scanLast.isEmpty() ? QString("/") : scanLast) + "'.";
+    if (updateID) text += " An update was stopped part way through, this is the catalogue from before it.";
     return text;
 }
 
-void NodeDisk::removeFromDB()
+bool NodeDisk::removeFromDB()
 {
-    if (!db.startTransaction())
-    {
-        Utils::errorMessageBox("Database Error:\ndelDisk: Transaction start error");
-        emit deleteFinished(this, false);
-        return;
-    }
-
-    QSqlQuery query;
-    if (!query.exec(QString("delete from files where dirid in (select id from directories where diskid = %1)").arg(id)))
-    {
-        Utils::errorMessageBox("Database Error:\ndelDisk: Query 1 fail");
-        db.rollbackTransaction();
-        emit deleteFinished(this, false);
-        return;
-    }
-
-    if (!query.exec(QString("delete from directories where diskid = %1").arg(id)))
-    {
-        Utils::errorMessageBox("Database Error:\ndelDisk: Query 2 fail");
-        db.rollbackTransaction();
-        emit deleteFinished(this, false);
-        return;
-    }
-
-    if (!query.exec(QString("delete from disks where id = %1").arg(id)))
-    {
-        Utils::errorMessageBox("Database Error:\ndelDisk: Query 4 fail");
-        db.rollbackTransaction();
-        emit deleteFinished(this, false);
-        return;
-    }
-
-    if (!db.commitTransaction())
-    {
-        Utils::errorMessageBox("Database Error:\ndelDisk: Commit fail");
-        db.rollbackTransaction();
-        emit deleteFinished(this, false);
-        return;
-    }
+    // Only tombstones the disk, through the writer. The Reclaimer removes its directories and files later
+    dbWriter.submit(DBWriter::deleteDisk(id));
+    return true;
+}
 
-    emit deleteFinished(this, true);
+void NodeDisk::setCounts(qint64 t_numDirs, qint64 t_numFiles, qint64 t_totalSize)
+{
+    numDirs = t_numDirs;
+    numFiles = t_numFiles;
+    totalSize = t_totalSize;
 }
 
-bool NodeDisk::removeContentsFromDBNT(QSqlQuery& query) const
+void NodeDisk::setHashContents(bool t_hashContents)
 {
-    // Deletes everything except the disks row
-    // Doesn't work in a transaction
-    // For use by Cataloguer in update mode, there will already be a transaction
+    hashContents = t_hashContents;
+}
 
-    if (!query.exec(QString("delete from files where dirid in (select id from directories where diskid = %1)").arg(id)))
-    {
-        Utils::errorMessageBox("Database Error:\nUdelDisk: Query 1 fail");
-        return false;
-    }
+void NodeDisk::setScanRules(const QString& t_excludes, int t_mountPolicy)
+{
+    excludes = t_excludes;
+    mountPolicy = t_mountPolicy;
+}
 
-    if (!query.exec(QString("delete from directories where diskid = %1").arg(id)))
-    {
-        Utils::errorMessageBox("Database Error:\nUdelDisk: Query 2 fail");
-        return false;
-    }
+void NodeDisk::setPartial(bool t_partial, const QString& t_scanLast)
+{
+    partial = t_partial;
+    scanLast = t_scanLast;
+}
 
-    return true;
+void NodeDisk::setUpdateID(qint64 t_updateID)
+{
+    updateID = t_updateID;
 }
 
 void NodeDisk::update(qint64 _catID, const QString& _name, const QString& _catPath,
@@ -307,10 +239,6 @@ void NodeDisk::update(qint64 _catID, const QString& _name, const QString& _catPa
     fsFree = _fsFree;
     isRoot = _isRoot;
     uuid = t_uuid;
-
-    for(auto c : Node::children) delete c; // It seems there's a children in QObject as well which this class didn't originally derive from
-    Node::children.clear();
-    childrenLoaded = false;
 }
 
 NodeDisk* NodeDisk::createDisk(QSqlQuery& query, qint64 catID, const QString& name, const QString& catPath,
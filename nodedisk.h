@@ -35,8 +35,6 @@ public:
          qint64 catTime, const QString& deviceName, const QString& fsLabel,
          const QString& fsType, qint64 fsSize, qint64 fsFree, int isRoot,
          const QString& mountCommand, const QString& unmountCommand, const QString& uuid);
-    bool loadRootDirID();
-    bool loadRootDirID(QSqlQuery& getRootDirQuery);
     virtual bool loadChildren();
 
     qint64 getCatID() const { return catID; }
@@ -51,11 +49,21 @@ public:
     const QString& getUuid() const { return uuid; }
     const QString& getDeviceName() const { return deviceName; }
     qint64 getRootDirID() const { return rootDirID; }
+    qint64 getNumDirs() const { return numDirs; }
+    qint64 getNumFiles() const { return numFiles; }
+    qint64 getTotalSize() const { return totalSize; }
+    bool getHashContents() const { return hashContents; }
+    const QString& getExcludes() const { return excludes; }
+    int getMountPolicy() const { return mountPolicy; }
+    bool isPartial() const { return partial; }
+    const QString& getScanLast() const { return scanLast; }
+    qint64 getUpdateID() const { return updateID; }
 
     virtual QString summaryText() const;
-    void removeFromDB();
-    bool removeContentsFromDBNT(QSqlQuery& query) const;
+    virtual bool mayHaveChildren();
+    bool removeFromDB();
     bool moveToCatalogue(qint64 newCat);
+    bool reloadFromDB();
     bool rename(const QString& newName);
     void setCommands(const QString &newMountCommand, const QString &newUnmountCommand);
     bool hasMountCommand() const;
@@ -66,6 +74,12 @@ public:
     bool unmount();
     bool isReachable();
     void osOpen() const;
+    void setCounts(qint64 numDirs, qint64 numFiles, qint64 totalSize);
+    void setHashContents(bool hashContents);
+    void setScanRules(const QString& excludes, int mountPolicy);
+    void setPartial(bool partial, const QString& scanLast);
+    void setUpdateID(qint64 updateID);
+    void setRootDirID(qint64 t_rootDirID) { rootDirID = t_rootDirID; }
     void update(qint64 catID, const QString& name, const QString& catPath,
              qint64 catTime, const QString& deviceName, const QString& fsLabel,
              const QString& fsType, qint64 fsSize, qint64 fsFree, int isRoot, const QString& uuid);
@@ -88,14 +102,20 @@ private:
     QString unmountCommand;
     QString uuid;
     qint64 rootDirID = -1;
+    qint64 numDirs = 0;
+    qint64 numFiles = 0;
+    qint64 totalSize = 0;
+    bool hashContents = false;
+    QString excludes;
+    int mountPolicy = 1; // MountTable::POLICY_SAME_DEVICE
+    bool partial = false; // Cataloguing was stopped part way through and can be resumed
+    QString scanLast;     // The last directory done before it stopped
+    qint64 updateID = 0;  // The hidden disks row an unfinished update is being scanned into, 0 if none
     bool fsLoaded = false;
     QDir fsQDir;
 
     bool startProcess(const QString &program, const QStringList &arguments);
     void loadFromFileSystem();
-
-signals:
-    void deleteFinished(NodeDisk*, bool);
 };
 
 #endif // NODEDISK_H
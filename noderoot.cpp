@@ -15,6 +15,8 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <QDebug>
+#include <QHash>
 #include <QSqlTableModel>
 
 #include "globals.h"
@@ -45,32 +47,49 @@ bool NodeRoot::loadChildren()
 
     numCats = catsModel.rowCount();
 
+    // All disks come in with one more query and are handed out to their
+    // catalogues here, rather than each catalogue querying for its own
+    QHash<qint64, NodeCatalogue*> catsByID;
     for (qint64 i = 0; i < numCats; i++)
     {
         NodeCatalogue* newCat = new NodeCatalogue(catsModel.data(catsModel.index(i, 0), Qt::DisplayRole).toLongLong(),
                                           catsModel.data(catsModel.index(i, 1), Qt::DisplayRole).toString());
         addChild(newCat);
+        catsByID.insert(newCat->getID(), newCat);
     }
 
+    numDisks = 0;
+    if (!Node::eachDisk("disks.deleted = 0", [&] (NodeDisk* newDisk)
+    {
+        if (newDisk->getCatID() == 0)
+        {
+            addChild(newDisk);
+            ++numDisks;
+            return;
+        }
 
-    QSqlTableModel disksModel;
-    disksModel.setTable("disks");
-    disksModel.setEditStrategy(QSqlTableModel::OnManualSubmit);
-    disksModel.setFilter(QString("catid = 0"));
-
-    if (!disksModel.select())
+        NodeCatalogue* cat = catsByID.value(newDisk->getCatID());
+        if (cat)
+        {
+            cat->addChild(newDisk);
+        }
+        else
+        {
+            qDebug() << "NodeRoot: disk" << newDisk->getID() << "is in missing catalogue" << newDisk->getCatID();
+            delete newDisk;
+        }
+    }))
     {
         Utils::errorMessageBox("Database Error:\nNodeRoot: Query 2 fail");
         return false;
     }
 
-    while(disksModel.canFetchMore()) disksModel.fetchMore();
-    numDisks = disksModel.rowCount();
-
-    Node::eachDiskInModel(disksModel, [&] (NodeDisk* newDisk)
+    sortChildren();
+    for (NodeCatalogue* cat : catsByID)
     {
-        addChild(newDisk);
-    });
+        cat->sortChildren();
+        cat->setChildrenLoaded();
+    }
 
     childrenLoaded = true;
     return true;
@@ -91,35 +110,18 @@ void NodeRoot::eachCat(std::function<void (NodeCatalogue *)> func)
 
 NodeCatalogue *NodeRoot::catFromID(qint64 catID) const
 {
-    for (qint64 i = 0; i < children.size(); i++)
-    {
-        if ((children[i]->getType() == TYPE_CAT) && (children[i]->getID() == catID)) return static_cast<NodeCatalogue*>(children[i]);
-    }
-    return NULL;
+    return static_cast<NodeCatalogue*>(findNode(TYPE_CAT, catID));
 }
 
 NodeDisk *NodeRoot::diskFromID(qint64 diskID) const
 {
-    for (qint64 i = 0; i < children.size(); i++)
-    {
-        if ((children[i]->getType() == TYPE_DISK) && (children[i]->getID() == diskID)) return static_cast<NodeDisk*>(children[i]);
-    }
+    // Disks not in a catalogue only
+    Node* n = findNode(TYPE_DISK, diskID);
+    if (n && (n->getParent() == this)) return static_cast<NodeDisk*>(n);
     return NULL;
 }
 
 NodeDisk *NodeRoot::diskFromIDRecursive(qint64 diskID) const
 {
-    NodeDisk* n = diskFromID(diskID);
-    if (!n)
-    {
-        for (qint64 i = 0; i < children.size(); i++)
-        {
-            if ((children[i])->getType() == TYPE_CAT)
-            {
-                n = static_cast<NodeCatalogue*>(children[i])->diskFromID(diskID);
-                if (n) break;
-            }
-        }
-    }
-    return n;
+    return static_cast<NodeDisk*>(findNode(TYPE_DISK, diskID));
 }
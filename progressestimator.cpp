@@ -0,0 +1,76 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "progressestimator.h"
+
+void ProgressEstimator::start(qint64 t_expectedTotal, double seedRate, qint64 startDone)
+{
+    // startDone is work done before, by an earlier run. It counts towards the total but not the rate
+    expectedTotal = t_expectedTotal;
+    rate = seedRate;
+    done = startDone;
+    doneMs = 0;
+    sampleDone = startDone;
+    sampleMs = 0;
+    timer.start();
+}
+
+void ProgressEstimator::update(qint64 t_done)
+{
+    done = t_done;
+    doneMs = timer.elapsed();
+
+    // Keep a little ahead of work that has outgrown the estimate
+    if (expectedTotal && (done >= expectedTotal)) expectedTotal = done + (done / 20) + 1;
+
+    if ((doneMs - sampleMs) < SAMPLE_MS) return;
+
+    double sampleRate = static_cast<double>(done - sampleDone) * 1000 / (doneMs - sampleMs);
+    if ((rate == 0) || (sampleDone == 0)) rate = sampleRate; // The first real sample replaces any seed
+    else rate += (sampleRate - rate) * SMOOTHING_PERCENT / 100;
+
+    sampleDone = done;
+    sampleMs = doneMs;
+}
+
+qint64 ProgressEstimator::projectedDone() const
+{
+    qint64 projected = done + static_cast<qint64>(rate * (timer.elapsed() - doneMs) / 1000);
+    if (expectedTotal && (projected >= expectedTotal)) projected = expectedTotal - 1;
+    return projected;
+}
+
+int ProgressEstimator::percent() const
+{
+    if (!expectedTotal) return -1;
+    qint64 p = projectedDone() * 100 / expectedTotal;
+    return static_cast<int>(p > 99 ? 99 : p);
+}
+
+qint64 ProgressEstimator::secondsLeft() const
+{
+    if (!expectedTotal || (rate <= 0)) return -1;
+    return static_cast<qint64>((expectedTotal - projectedDone()) / rate);
+}
+
+QString ProgressEstimator::durationText(qint64 seconds)
+{
+    if (seconds < 60) return "less than a minute";
+    qint64 minutes = (seconds + 30) / 60;
+    if (minutes < 60) return QString("about %1 min").arg(minutes);
+    return QString("about %1 h %2 min").arg(minutes / 60).arg(minutes % 60);
+}
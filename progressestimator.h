@@ -0,0 +1,63 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROGRESSESTIMATOR_H
+#define PROGRESSESTIMATOR_H
+
+#include <QElapsedTimer>
+#include <QString>
+
+/* Percent done, rate and time left for a long job whose size is only known
+ * roughly. The rate is smoothed over samples at least SAMPLE_MS apart so the
+ * time left doesn't jump about. Work that outgrows the estimate pushes the
+ * estimate up, so the percentage slows down near the end rather than sitting
+ * at 99.
+ *
+ * For jobs that report rarely (index builds) projectedDone() carries on from
+ * the last report at the current rate.
+ */
+
+class ProgressEstimator
+{
+public:
+    void start(qint64 expectedTotal, double seedRate = 0, qint64 startDone = 0); // expectedTotal 0 if unknown
+    void update(qint64 done);
+
+    bool hasEstimate() const { return (expectedTotal > 0); }
+    qint64 getDone() const { return done; }
+    qint64 getExpectedTotal() const { return expectedTotal; }
+    double getRate() const { return rate; } // per second
+    qint64 projectedDone() const;
+    int percent() const; // -1 if unknown, never 100 (that closes a QProgressDialog)
+    qint64 secondsLeft() const; // -1 if unknown
+
+    static QString durationText(qint64 seconds);
+
+private:
+    QElapsedTimer timer;
+    qint64 expectedTotal = 0;
+    qint64 done = 0;
+    qint64 doneMs = 0;
+    qint64 sampleDone = 0;
+    qint64 sampleMs = 0;
+    double rate = 0;
+
+    const static int SAMPLE_MS = 1000;
+    const static int SMOOTHING_PERCENT = 30; // Weight of each new sample
+};
+
+#endif // PROGRESSESTIMATOR_H
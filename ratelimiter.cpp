@@ -0,0 +1,49 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QThread>
+
+#include "ratelimiter.h"
+
+void RateLimiter::setRate(qint64 perSecond)
+{
+    QMutexLocker locker(&mutex);
+    rate.store(perSecond);
+    nextFreeNs = 0; // Forget any debt run up at the old rate
+}
+
+void RateLimiter::take(qint64 amount)
+{
+    if (rate.load() <= 0) return;
+
+    qint64 waitNs;
+    {
+        QMutexLocker locker(&mutex);
+        qint64 perSecond = rate.load();
+        if (perSecond <= 0) return;
+
+        if (!clock.isValid()) clock.start();
+        qint64 nowNs = clock.nsecsElapsed();
+
+        // Time not used while idle only counts up to one burst
+        if (nextFreeNs < (nowNs - (BURST_MS * 1000000))) nextFreeNs = nowNs - (BURST_MS * 1000000);
+        nextFreeNs += amount * 1000000000 / perSecond;
+        waitNs = nextFreeNs - nowNs;
+    }
+
+    if (waitNs > 0) QThread::usleep(static_cast<unsigned long>(waitNs / 1000));
+}
@@ -0,0 +1,47 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QMutex>
+
+/* Holds a job to a number of units (objects, bytes) per second by sleeping the
+ * thread that takes them. Short bursts are let through and the average is kept
+ * to. The rate can be changed from any thread while the job runs, and several
+ * threads can share one limiter.
+ */
+
+class RateLimiter
+{
+public:
+    void setRate(qint64 perSecond); // 0 for no limit
+    qint64 getRate() const { return rate.load(); }
+    void take(qint64 amount);
+
+private:
+    QAtomicInteger<qint64> rate;
+    QMutex mutex;
+    QElapsedTimer clock;
+    qint64 nextFreeNs = 0; // When everything taken so far will have been paid for
+
+    const static qint64 BURST_MS = 200;
+};
+
+#endif // RATELIMITER_H
@@ -0,0 +1,229 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QRunnable>
+#include <QSocketNotifier>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "reachabilitymonitor.h"
+
+// Shared with the probes so that a probe finishing after the monitor has gone
+// (a hung mount can outlive the app window) has nowhere to deliver to
+struct ProbeInbox
+{
+    QMutex mutex;
+    ReachabilityMonitor* target;
+};
+
+class PathProbe : public QRunnable
+{
+public:
+    PathProbe(QSharedPointer<ProbeInbox> t_inbox, quint64 t_probeID, const QString& t_path, bool t_wantEmpty)
+        : inbox(t_inbox), probeID(t_probeID), path(t_path), wantEmpty(t_wantEmpty) {}
+
+    void run() override
+    {
+        QFileInfo qfi(path);
+        bool exists = qfi.exists();
+        bool isDir = exists && qfi.isDir();
+        bool isEmpty = false;
+        if (isDir && wantEmpty) isEmpty = QDir(path).isEmpty();
+
+        QMutexLocker locker(&inbox->mutex);
+        if (!inbox->target) return;
+        QMetaObject::invokeMethod(inbox->target, "probeDone", Qt::QueuedConnection,
+                                  Q_ARG(quint64, probeID), Q_ARG(bool, exists), Q_ARG(bool, isDir), Q_ARG(bool, isEmpty));
+    }
+
+private:
+    QSharedPointer<ProbeInbox> inbox;
+    quint64 probeID;
+    QString path;
+    bool wantEmpty;
+};
+
+ReachabilityMonitor::ReachabilityMonitor(QObject* parent)
+    : QObject(parent), inbox(new ProbeInbox)
+{
+    inbox->target = this;
+
+    pool = new QThreadPool();
+    pool->setMaxThreadCount(MAX_PROBE_THREADS);
+
+    timeoutTimer = new QTimer(this);
+    timeoutTimer->setInterval(PROBE_TIMEOUT_MS / 4);
+    connect(timeoutTimer, SIGNAL(timeout()), this, SLOT(checkTimeouts()));
+
+    // The kernel flags /proc/self/mountinfo with POLLPRI whenever the mount table changes
+    mountInfoFD = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+    if (mountInfoFD >= 0)
+    {
+        drainMountInfo();
+        mountNotifier = new QSocketNotifier(mountInfoFD, QSocketNotifier::Exception, this);
+        connect(mountNotifier, SIGNAL(activated(int)), this, SLOT(mountsChanged()));
+    }
+    else
+    {
+        qDebug() << "ReachabilityMonitor: cannot watch /proc/self/mountinfo, relying on cache expiry";
+    }
+}
+
+ReachabilityMonitor::~ReachabilityMonitor()
+{
+    {
+        QMutexLocker locker(&inbox->mutex);
+        inbox->target = NULL;
+    }
+
+    if (mountNotifier) mountNotifier->setEnabled(false);
+    if (mountInfoFD >= 0) ::close(mountInfoFD);
+
+    // Don't wait on a probe stuck in a dead mount. If one is, the pool is left behind deliberately
+    pool->clear();
+    if (pool->waitForDone(100)) delete pool;
+}
+
+ReachabilityMonitor::PathState ReachabilityMonitor::query(const QString& rootPath, const QString& path)
+{
+    if (hungRoots.contains(rootPath))
+    {
+        PathState unreachable;
+        unreachable.known = true;
+        return unreachable;
+    }
+
+    if (path != rootPath)
+    {
+        // Don't risk another thread on a path until its root has answered
+        PathState rootState = query(rootPath, rootPath);
+        if (!rootState.known) return PathState();
+        if (!rootState.isDir) { rootState.isEmpty = false; return rootState; }
+    }
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QHash<QString, Entry>::iterator it = cache.find(path);
+    if (it != cache.end())
+    {
+        if (it->probeID) return it->state; // Previous answer, if any, while a new one is on its way
+        if (it->state.known && ((now - it->answeredAt) < CACHE_TTL_MS)) return it->state;
+    }
+
+    startProbe(rootPath, path);
+    return cache.value(path).state;
+}
+
+void ReachabilityMonitor::invalidate()
+{
+    // Answers are thrown away, but probes still out are kept along with the hung roots they
+    // stand for. Their threads are still stuck, asking again would only tie up another one
+    QHash<QString, Entry> outstanding;
+    for (QHash<QString, Entry>::const_iterator it = cache.constBegin(); it != cache.constEnd(); ++it)
+    {
+        if (!it->probeID) continue;
+        Entry entry;
+        entry.probeID = it->probeID;
+        outstanding.insert(it.key(), entry);
+    }
+    cache = outstanding;
+
+    for (Probe& probe : probes) probe.stale = true;
+    emit updated();
+}
+
+void ReachabilityMonitor::startProbe(const QString& rootPath, const QString& path)
+{
+    quint64 probeID = nextProbeID++;
+    probes.insert(probeID, { path, rootPath, QDateTime::currentMSecsSinceEpoch(), false });
+    cache[path].probeID = probeID;
+
+    pool->start(new PathProbe(inbox, probeID, path, path == rootPath));
+    if (!timeoutTimer->isActive()) timeoutTimer->start();
+}
+
+void ReachabilityMonitor::probeDone(quint64 probeID, bool exists, bool isDir, bool isEmpty)
+{
+    QHash<quint64, Probe>::iterator pit = probes.find(probeID);
+    if (pit == probes.end()) return;
+    Probe probe = pit.value();
+    probes.erase(pit);
+
+    // A late answer from a root that timed out means it has come back
+    hungRoots.remove(probe.rootPath);
+
+    Entry& entry = cache[probe.path];
+    if (entry.probeID == probeID) entry.probeID = 0;
+
+    // From before the mounts changed, so the path is asked again next time
+    if (probe.stale)
+    {
+        if (probes.isEmpty()) timeoutTimer->stop();
+        emit updated();
+        return;
+    }
+
+    entry.state.known = true;
+    entry.state.exists = exists;
+    entry.state.isDir = isDir;
+    entry.state.isEmpty = isEmpty;
+    entry.answeredAt = QDateTime::currentMSecsSinceEpoch();
+
+    if (probes.isEmpty()) timeoutTimer->stop();
+    emit updated();
+}
+
+void ReachabilityMonitor::checkTimeouts()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    bool changed = false;
+
+    for (QHash<quint64, Probe>::iterator it = probes.begin(); it != probes.end(); ++it)
+    {
+        if ((now - it->startedAt) < PROBE_TIMEOUT_MS) continue;
+        if (hungRoots.contains(it->rootPath)) continue;
+
+        // The probe stays in the table so that its eventual answer can revive the root
+        qDebug() << "ReachabilityMonitor: probe timed out, treating as unreachable:" << it->rootPath;
+        hungRoots.insert(it->rootPath);
+        changed = true;
+    }
+
+    if (probes.isEmpty()) timeoutTimer->stop();
+    if (changed) emit updated();
+}
+
+void ReachabilityMonitor::mountsChanged()
+{
+    drainMountInfo();
+    invalidate();
+}
+
+void ReachabilityMonitor::drainMountInfo()
+{
+    // Reading the file to the end re-arms the notification
+    char buffer[4096];
+    ::lseek(mountInfoFD, 0, SEEK_SET);
+    while (::read(mountInfoFD, buffer, sizeof(buffer)) > 0);
+}
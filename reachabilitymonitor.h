@@ -0,0 +1,107 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef REACHABILITYMONITOR_H
+#define REACHABILITYMONITOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+
+class QSocketNotifier;
+class QThreadPool;
+class QTimer;
+struct ProbeInbox;
+
+/* Answers "is this path there?" for the GUI without touching the file system
+ * on the GUI thread. A stale NFS / CIFS mount can block a stat() for minutes,
+ * so paths are probed on worker threads and a probe that does not answer in
+ * PROBE_TIMEOUT_MS marks its whole disk root as unreachable until the probe
+ * finally returns. A path never has more than one probe out, so a dead mount
+ * holds at most one pool thread per path asked about, however often the mount
+ * table changes meanwhile.
+ *
+ * query() returns whatever is cached. If nothing is cached yet it starts a probe,
+ * returns known = false and emits updated() when the answer arrives. A path is
+ * only probed once its disk root has been found reachable.
+ */
+
+class ReachabilityMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct PathState
+    {
+        bool known = false;
+        bool exists = false;
+        bool isDir = false;
+        bool isEmpty = false; // Only filled in for the root itself
+    };
+
+    ReachabilityMonitor(QObject* parent = NULL);
+    ~ReachabilityMonitor();
+
+    PathState query(const QString& rootPath, const QString& path);
+    void invalidate();
+
+signals:
+    void updated();
+
+private slots:
+    void probeDone(quint64 probeID, bool exists, bool isDir, bool isEmpty);
+    void checkTimeouts();
+    void mountsChanged();
+
+private:
+    struct Entry
+    {
+        PathState state;
+        quint64 probeID = 0; // Non zero while a probe is outstanding
+        qint64 answeredAt = 0;
+    };
+
+    struct Probe
+    {
+        QString path;
+        QString rootPath;
+        qint64 startedAt;
+        bool stale; // Started before the last invalidate(), its answer only says the thread is free again
+    };
+
+    void startProbe(const QString& rootPath, const QString& path);
+    void drainMountInfo();
+
+    QHash<QString, Entry> cache;
+    QHash<quint64, Probe> probes;
+    QSet<QString> hungRoots;
+    quint64 nextProbeID = 1;
+
+    QThreadPool* pool;
+    QSharedPointer<ProbeInbox> inbox;
+    QTimer* timeoutTimer;
+    int mountInfoFD = -1;
+    QSocketNotifier* mountNotifier = NULL;
+
+    const static int PROBE_TIMEOUT_MS = 2000;
+    const static int CACHE_TTL_MS = 10000;
+    const static int MAX_PROBE_THREADS = 4;
+};
+
+#endif // REACHABILITYMONITOR_H
@@ -0,0 +1,170 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QThread>
+
+#include "db.h"
+#include "dbpool.h"
+
+#include "reclaimer.h"
+
+Reclaimer::Reclaimer()
+{
+}
+
+void Reclaimer::abort()
+{
+    abortNow = true;
+}
+
+void Reclaimer::go()
+{
+    rdb = DBPool::connection();
+    if (!rdb)
+    {
+        emit finished();
+        return;
+    }
+
+    {
+        QSqlQuery query(rdb->getqdb());
+
+        while(!abortNow)
+        {
+            if (!execRetry(query, "select id from disks where deleted = 1 limit 1")) break;
+            if (!query.next()) break; // Nothing left to reclaim
+            qint64 diskID = query.value(0).toLongLong();
+            query.finish();
+            if (!reclaimDisk(query, diskID)) break;
+        }
+
+        if (!abortNow) releaseFreePages(query);
+    }
+
+    rdb = NULL;
+
+    emit finished();
+}
+
+bool Reclaimer::reclaimDisk(QSqlQuery& query, qint64 diskID)
+{
+    // Work through the disk's directories a handful at a time. Their files go first,
+    // in bounded batches in case one directory holds a huge number of files, then the
+    // directory rows themselves. Rows already removed are never visited again.
+
+    while(true)
+    {
+        if (!execRetry(query, QString("select id from directories where diskid = %1 limit %2").arg(diskID).arg(DIRS_PER_BATCH))) return false;
+
+        QStringList dirIDs;
+        while(query.next()) dirIDs.append(query.value(0).toString());
+        query.finish();
+        if (dirIDs.isEmpty()) break;
+        QString dirList = dirIDs.join(',');
+
+        qint64 numRows;
+        do
+        {
+            if (!runBatch(query, QString("delete from files where id in (select id from files where dirid in (%1) limit %2)")
+                                 .arg(dirList).arg(FILES_PER_BATCH), numRows)) return false;
+        } while(numRows > 0);
+
+        if (!runBatch(query, QString("delete from directories where id in (%1)").arg(dirList), numRows)) return false;
+    }
+
+    // Remembered hashes are one row per file too. The table is keyed on (diskid, path), so each batch is a range of it
+    qint64 numRows;
+    do
+    {
+        if (!runBatch(query, QString("delete from filehashes where diskid = %1 and path in "
+                                     "(select path from filehashes where diskid = %1 limit %2)")
+                             .arg(diskID).arg(FILES_PER_BATCH), numRows)) return false;
+    } while(numRows > 0);
+
+    if (!runBatch(query, QString("delete from scanfrontier where diskid = %1").arg(diskID), numRows)) return false;
+    if (!runBatch(query, QString("delete from diskstats where diskid = %1").arg(diskID), numRows)) return false;
+    return runBatch(query, QString("delete from disks where id = %1").arg(diskID), numRows);
+}
+
+void Reclaimer::releaseFreePages(QSqlQuery& query)
+{
+    // Only databases with auto_vacuum = incremental (new ones, and any that have been
+    // compacted) can shrink like this. Others keep their free pages for reuse.
+
+    if (!execRetry(query, "pragma auto_vacuum") || !query.next()) return;
+    bool incremental = (query.value(0).toInt() == 2);
+    query.finish();
+    if (!incremental) return;
+
+    while(!abortNow)
+    {
+        if (!execRetry(query, "pragma freelist_count") || !query.next()) return;
+        qint64 freePages = query.value(0).toLongLong();
+        query.finish();
+        if (freePages == 0) return;
+
+        // The pragma frees one page per row stepped, and commits when the statement is done with
+        if (!execRetry(query, QString("pragma incremental_vacuum(%1)").arg(PAGES_PER_STEP))) return;
+        while(query.next());
+        query.finish();
+
+        QThread::msleep(BATCH_PAUSE_MS);
+    }
+}
+
+bool Reclaimer::execRetry(QSqlQuery& query, const QString& sql)
+{
+    // Another connection holding the write lock (e.g. a Cataloguer mid-scan) is not an error,
+    // just wait for it to finish
+
+    while(!abortNow)
+    {
+        if (query.exec(sql)) return true;
+
+        QString sqliteError = query.lastError().nativeErrorCode();
+        if ((sqliteError != "5") && (sqliteError != "6")) // SQLITE_BUSY, SQLITE_LOCKED
+        {
+            qDebug() << "Reclaimer: query failed:" << query.lastError().text();
+            return false;
+        }
+
+        QThread::msleep(BUSY_PAUSE_MS);
+    }
+    return false;
+}
+
+bool Reclaimer::runBatch(QSqlQuery& query, const QString& sql, qint64& numRows)
+{
+    // Single statements run in auto-commit mode, so each batch is its own short transaction
+
+    numRows = 0;
+    if (!execRetry(query, sql)) return false;
+
+    numRows = query.numRowsAffected();
+    if (numRows > 0)
+    {
+        numReclaimed += numRows;
+        emit objectsReclaimed(numReclaimed);
+    }
+
+    QThread::msleep(BATCH_PAUSE_MS); // Keep out of the way of everything else
+    return true;
+}
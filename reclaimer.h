@@ -0,0 +1,68 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECLAIMER_H
+#define RECLAIMER_H
+
+#include <QObject>
+
+class QSqlQuery;
+class DB;
+
+/* Deleting a disk or catalogue only marks its disk rows as deleted (tombstoned).
+ * The Reclaimer runs afterwards as a low priority bulk job on its own connection and
+ * removes the files / directories / disks rows of tombstoned disks in small
+ * batches. Each batch commits on its own so other writers are never held up for
+ * long, and any work left over when the app closes is picked up on the next run.
+ * Then, if the database uses incremental auto vacuum, it hands the free pages
+ * back to the filesystem PAGES_PER_STEP at a time.
+ */
+
+class Reclaimer : public QObject
+{
+    Q_OBJECT
+
+public:
+    Reclaimer();
+
+    void abort();
+
+public slots:
+    void go();
+
+signals:
+    void objectsReclaimed(qint64 numObjects);
+    void finished();
+
+private:
+    bool reclaimDisk(QSqlQuery& query, qint64 diskID);
+    void releaseFreePages(QSqlQuery& query);
+    bool execRetry(QSqlQuery& query, const QString& sql);
+    bool runBatch(QSqlQuery& query, const QString& sql, qint64& numRows);
+
+    DB* rdb = NULL;
+    bool abortNow = false;
+    qint64 numReclaimed = 0;
+
+    const static int DIRS_PER_BATCH = 500;
+    const static int FILES_PER_BATCH = 5000;
+    const static int PAGES_PER_STEP = 1000;
+    const static int BATCH_PAUSE_MS = 20;
+    const static int BUSY_PAUSE_MS = 1000;
+};
+
+#endif // RECLAIMER_H
@@ -0,0 +1,59 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <QDebug>
+
+#include "scanpriority.h"
+
+namespace
+{
+    // From linux/ioprio.h. glibc has no ioprio_set wrapper
+    const int IOPRIO_CLASS_SHIFT = 13;
+    const int IOPRIO_CLASS_BE = 2;
+    const int IOPRIO_CLASS_IDLE = 3;
+    const int IOPRIO_WHO_PROCESS = 1;
+
+    thread_local bool applied = false;
+}
+
+void ScanPriority::applyToThisThread(int priority)
+{
+    if (priority == PRIORITY_NORMAL) return;
+    applied = true;
+
+    // On Linux both of these take a thread ID and change only that thread
+    pid_t tid = static_cast<pid_t>(::syscall(SYS_gettid));
+
+    int ioprio;
+    if (priority == PRIORITY_IDLE) ioprio = IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT;
+    else ioprio = (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | 7;
+
+    if (::syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, ioprio) != 0)
+        qDebug() << "ScanPriority: ioprio_set failed";
+
+    if (::setpriority(PRIO_PROCESS, static_cast<id_t>(tid), (priority == PRIORITY_IDLE) ? 19 : 10) != 0)
+        qDebug() << "ScanPriority: setpriority failed";
+}
+
+bool ScanPriority::isAppliedToThisThread()
+{
+    return applied;
+}
@@ -0,0 +1,46 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCANPRIORITY_H
+#define SCANPRIORITY_H
+
+/* Scheduling for scans of live volumes, so cataloguing doesn't get in the way
+ * of whatever else the machine is doing. Applied to one thread at a time: the
+ * Cataloguer's own thread and each content hashing thread.
+ *
+ *   PRIORITY_NORMAL  Left as it is
+ *   PRIORITY_LOW     nice 10, best-effort I/O at the lowest level
+ *   PRIORITY_IDLE    nice 19, idle I/O class: disk time only when nobody else wants it
+ *
+ * In the low and idle modes the hashing pass also drops the file contents it
+ * has read from the page cache, instead of pushing other programs' data out.
+ *
+ * Without privileges the nice value can't be put back, so a thread that has had
+ * a priority applied should not be reused for other work.
+ */
+
+class ScanPriority
+{
+public:
+    enum Priority { PRIORITY_NORMAL = 0, PRIORITY_LOW = 1, PRIORITY_IDLE = 2 };
+
+    static void applyToThisThread(int priority);
+    static bool isAppliedToThisThread();
+    static bool dropCache(int priority) { return (priority != PRIORITY_NORMAL); }
+};
+
+#endif // SCANPRIORITY_H
@@ -103,7 +103,7 @@ void SearchModel::search(QString& text)
     model = new QSqlTableModel();
     model->setTable("disks");
     model->setEditStrategy(QSqlTableModel::OnManualSubmit);
-    model->setFilter(QString("UPPER(name) like '%%1%'").arg(text.toUpper())); // FIXME DB
+    model->setFilter(QString("UPPER(name) like '%%1%' and deleted = 0").arg(text.toUpper())); // FIXME DB
     model->select();
 
     while(model->canFetchMore()) model->fetchMore();
@@ -127,7 +127,7 @@ void SearchModel::search(QString& text)
     model = new QSqlTableModel();
     model->setTable("directories");
     model->setEditStrategy(QSqlTableModel::OnManualSubmit);
-    model->setFilter(QString("UPPER(name) like '%%1%'").arg(text.toUpper())); // FIXME DB
+    model->setFilter(QString("UPPER(name) like '%%1%' and diskid not in (select id from disks where deleted <> 0)").arg(text.toUpper())); // FIXME DB
     model->select();
 
     while(model->canFetchMore()) model->fetchMore();
@@ -151,7 +151,8 @@ void SearchModel::search(QString& text)
     model = new QSqlTableModel();
     model->setTable("files");
     model->setEditStrategy(QSqlTableModel::OnManualSubmit);
-    model->setFilter(QString("UPPER(name) like '%%1%'").arg(text.toUpper())); // FIXME DB
+    model->setFilter(QString("UPPER(name) like '%%1%' and dirid not in (select directories.id from directories join disks on directories.diskid = disks.id "
+                                                                      "where disks.deleted <> 0)").arg(text.toUpper())); // FIXME DB
     model->select();
 
     while(model->canFetchMore()) model->fetchMore();
@@ -200,28 +200,34 @@ void SearchResult::loadDObject()
     }
 }
 
-bool SearchResult::isReachable()
+// File system locations for the reachability monitor. containerPath is only set for files
+bool SearchResult::getPaths(QString& rootPath, QString& path, QString& containerPath)
 {
+    if (!dObjectLoaded) return false;
+
     if (type == TYPE_DISK)
     {
-        return static_cast<NodeDisk*>(dObject)->isReachable();
+        NodeDisk* disk = static_cast<NodeDisk*>(dObject);
+        rootPath = disk->getCatPath();
+        path = rootPath;
+        containerPath.clear();
+        return true;
     }
     else if (type == TYPE_DIR)
     {
-        return static_cast<DDir*>(dObject)->isReachable();
+        DDir* dir = static_cast<DDir*>(dObject);
+        rootPath = dir->getRootPath();
+        path = dir->getFullPath();
+        containerPath.clear();
+        return true;
     }
     else if (type >= TYPE_FILE)
     {
-        return static_cast<DFile*>(dObject)->isReachable();
-    }
-    return false;
-}
-
-bool SearchResult::isContainerReachable()
-{
-    if (type >= TYPE_FILE)
-    {
-        return static_cast<DFile*>(dObject)->isContainerReachable();
+        DFile* file = static_cast<DFile*>(dObject);
+        rootPath = file->getRootPath();
+        path = file->getFullPath();
+        containerPath = file->getContainerPath();
+        return true;
     }
     return false;
 }
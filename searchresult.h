@@ -47,8 +47,7 @@ public:
     void calcLocation();
 
     void loadDObject();
-    bool isReachable();
-    bool isContainerReachable();
+    bool getPaths(QString& rootPath, QString& path, QString& containerPath);
     void osOpen();
     void osOpenContainer();
     DFile* getDFile();
@@ -0,0 +1,181 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QIODevice>
+#include <QtEndian>
+
+#include "snapshot.h"
+
+SnapshotWriter::SnapshotWriter(QIODevice* t_device)
+    : device(t_device)
+{
+    frame.reserve(FRAME_SIZE + 4096);
+}
+
+void SnapshotWriter::putUInt(quint64 value)
+{
+    while (value >= 0x80)
+    {
+        frame.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    frame.append(static_cast<char>(value));
+}
+
+void SnapshotWriter::putInt(qint64 value)
+{
+    putUInt((static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63));
+}
+
+void SnapshotWriter::putString(const QString& value)
+{
+    if (value.isNull()) { putUInt(0); return; }
+    QByteArray utf8 = value.toUtf8();
+    putUInt(static_cast<quint64>(utf8.size()) + 1);
+    frame.append(utf8);
+}
+
+void SnapshotWriter::putBytes(const QByteArray& value)
+{
+    if (value.isNull()) { putUInt(0); return; }
+    putUInt(static_cast<quint64>(value.size()) + 1);
+    frame.append(value);
+}
+
+void SnapshotWriter::putTableString(const QString& value)
+{
+    auto i = table.constFind(value);
+    if (i != table.constEnd())
+    {
+        putUInt(i.value());
+        return;
+    }
+
+    putUInt(0);
+    putString(value);
+    table.insert(value, static_cast<quint64>(table.size()) + 1);
+}
+
+void SnapshotWriter::endRecord()
+{
+    if (frame.size() >= FRAME_SIZE) flushFrame();
+}
+
+void SnapshotWriter::flushFrame()
+{
+    if (frame.isEmpty() || !good) return;
+
+    QByteArray compressed = qCompress(frame);
+    uchar length[4];
+    qToBigEndian(static_cast<quint32>(compressed.size()), length);
+
+    if ((device->write(reinterpret_cast<const char*>(length), 4) != 4) ||
+        (device->write(compressed) != compressed.size()))
+    {
+        qDebug() << "SnapshotWriter: write failed";
+        good = false;
+    }
+    frame.clear();
+}
+
+bool SnapshotWriter::finish()
+{
+    flushFrame();
+    return good;
+}
+
+SnapshotReader::SnapshotReader(QIODevice* t_device)
+    : device(t_device)
+{
+}
+
+bool SnapshotReader::need(int numBytes)
+{
+    if (!good) return false;
+    if (pos + numBytes <= frame.size()) return true;
+
+    // Values never straddle frames, so anything left over here means a bad file
+    if (pos != frame.size()) { good = false; return false; }
+
+    uchar length[4];
+    if (device->read(reinterpret_cast<char*>(length), 4) != 4) { good = false; return false; }
+    quint32 compressedSize = qFromBigEndian<quint32>(length);
+    if (compressedSize > MAX_FRAME) { good = false; return false; }
+
+    QByteArray compressed = device->read(compressedSize);
+    if (static_cast<quint32>(compressed.size()) != compressedSize) { good = false; return false; }
+
+    frame = qUncompress(compressed);
+    pos = 0;
+    if (numBytes > frame.size()) { good = false; return false; }
+    return true;
+}
+
+quint64 SnapshotReader::getUInt()
+{
+    quint64 value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (!need(1)) return 0;
+        uchar b = static_cast<uchar>(frame.at(pos++));
+        value |= static_cast<quint64>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return value;
+    }
+    good = false;
+    return 0;
+}
+
+qint64 SnapshotReader::getInt()
+{
+    quint64 raw = getUInt();
+    return static_cast<qint64>(raw >> 1) ^ -static_cast<qint64>(raw & 1);
+}
+
+QByteArray SnapshotReader::getBytes()
+{
+    quint64 length = getUInt();
+    if (length == 0) return QByteArray();
+    if (length == 1) return QByteArray(""); // Empty, as opposed to null
+    --length;
+    if ((length > MAX_FRAME) || !need(static_cast<int>(length))) { good = false; return QByteArray(); }
+
+    QByteArray value = frame.mid(pos, static_cast<int>(length));
+    pos += static_cast<int>(length);
+    return value;
+}
+
+QString SnapshotReader::getString()
+{
+    QByteArray utf8 = getBytes();
+    if (utf8.isNull()) return QString();
+    if (utf8.isEmpty()) return QString("");
+    return QString::fromUtf8(utf8);
+}
+
+QString SnapshotReader::getTableString()
+{
+    quint64 ref = getUInt();
+    if (ref == 0)
+    {
+        table.append(getString());
+        return table.last();
+    }
+
+    if (ref > static_cast<quint64>(table.size())) { good = false; return QString(); }
+    return table.at(static_cast<int>(ref - 1));
+}
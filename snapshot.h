@@ -0,0 +1,93 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+
+/* Disk snapshot streams
+ *
+ * A snapshot file is a run of frames, each a big endian quint32 length followed
+ * by a qCompress()ed block of about FRAME_SIZE bytes, so export and import both
+ * work in bounded memory. A value is never split across frames.
+ *
+ * Inside the frames everything is a varint (LEB128, signed values zigzagged
+ * first), a string or a byte array. Strings and byte arrays are a varint of
+ * length + 1 followed by the data, with 0 meaning null. Table strings are for
+ * the few values that repeat on every row, such as owner and group: 0 introduces
+ * a new string, n refers back to the nth one seen.
+ *
+ * The record layout is DiskTransfer's business. These classes only know the
+ * encodings.
+ */
+
+class SnapshotWriter
+{
+public:
+    SnapshotWriter(QIODevice* device);
+
+    void putUInt(quint64 value);
+    void putInt(qint64 value);
+    void putString(const QString& value);
+    void putBytes(const QByteArray& value);
+    void putTableString(const QString& value);
+    void endRecord();   // Call between records, lets a full frame go out
+    bool finish();
+    bool ok() const { return good; }
+
+    const static int FRAME_SIZE = 1024 * 1024;
+
+private:
+    void flushFrame();
+
+    QIODevice* device;
+    QByteArray frame;
+    QHash<QString, quint64> table;
+    bool good = true;
+};
+
+class SnapshotReader
+{
+public:
+    SnapshotReader(QIODevice* device);
+
+    quint64 getUInt();
+    qint64 getInt();
+    QString getString();
+    QByteArray getBytes();
+    QString getTableString();
+    bool ok() const { return good; }
+
+private:
+    bool need(int numBytes);
+
+    QIODevice* device;
+    QByteArray frame;
+    int pos = 0;
+    QVector<QString> table;
+    bool good = true;
+
+    const static quint32 MAX_FRAME = 64 * 1024 * 1024;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,143 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <sqlite3.h>
+
+#include <QDebug>
+
+#include "sqlstatement.h"
+
+namespace
+{
+    // SQLITE_TRANSIENT (sqlite3 takes its own copy of the value), without its C style cast
+    const sqlite3_destructor_type COPY_VALUE = reinterpret_cast<sqlite3_destructor_type>(-1);
+}
+
+SqlStatement::~SqlStatement()
+{
+    finalize();
+}
+
+bool SqlStatement::prepare(sqlite3* handle, const QByteArray& sql)
+{
+    finalize();
+    if (!handle) return false;
+
+    if (sqlite3_prepare_v2(handle, sql.constData(), sql.size(), &stmt, NULL) != SQLITE_OK)
+    {
+        qDebug() << "SqlStatement: prepare failed:" << sqlite3_errmsg(handle) << sql;
+        sqlite3_finalize(stmt);
+        stmt = NULL;
+        return false;
+    }
+    return true;
+}
+
+void SqlStatement::finalize()
+{
+    if (!stmt) return;
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+}
+
+void SqlStatement::bind(int param, qint64 value)
+{
+    sqlite3_bind_int64(stmt, param, value);
+}
+
+void SqlStatement::bind(int param, int value)
+{
+    sqlite3_bind_int(stmt, param, value);
+}
+
+// Handed over as UTF-16, sqlite3 converts it while copying it in, so there is no QByteArray in between
+void SqlStatement::bind(int param, const QString& value)
+{
+    if (value.isNull()) sqlite3_bind_null(stmt, param);
+    else sqlite3_bind_text16(stmt, param, value.utf16(), value.size() * 2, COPY_VALUE);
+}
+
+void SqlStatement::bind(int param, const QByteArray& value)
+{
+    if (value.isNull()) sqlite3_bind_null(stmt, param);
+    else sqlite3_bind_blob(stmt, param, value.constData(), value.size(), COPY_VALUE);
+}
+
+void SqlStatement::bindNull(int param)
+{
+    sqlite3_bind_null(stmt, param);
+}
+
+bool SqlStatement::exec()
+{
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    lastFailed = (rc != SQLITE_DONE) && (rc != SQLITE_ROW);
+    if (lastFailed) qDebug() << "SqlStatement: exec failed:" << errorText();
+    return !lastFailed;
+}
+
+bool SqlStatement::next()
+{
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) return true;
+    lastFailed = (rc != SQLITE_DONE);
+    if (lastFailed) qDebug() << "SqlStatement: step failed:" << errorText();
+    sqlite3_reset(stmt); // So an open read doesn't hold up a commit
+    return false;
+}
+
+void SqlStatement::reset()
+{
+    sqlite3_reset(stmt);
+    lastFailed = false;
+}
+
+qint64 SqlStatement::int64(int column) const
+{
+    return sqlite3_column_int64(stmt, column);
+}
+
+int SqlStatement::integer(int column) const
+{
+    return sqlite3_column_int(stmt, column);
+}
+
+QString SqlStatement::text(int column) const
+{
+    const char* data = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+    if (!data) return QString();
+    return QString::fromUtf8(data, sqlite3_column_bytes(stmt, column));
+}
+
+QByteArray SqlStatement::blob(int column) const
+{
+    const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, column));
+    if (!data) return QByteArray();
+    return QByteArray(data, sqlite3_column_bytes(stmt, column));
+}
+
+qint64 SqlStatement::lastInsertId() const
+{
+    return sqlite3_last_insert_rowid(sqlite3_db_handle(stmt));
+}
+
+QString SqlStatement::errorText() const
+{
+    if (!stmt) return QString();
+    return QString::fromUtf8(sqlite3_errmsg(sqlite3_db_handle(stmt)));
+}
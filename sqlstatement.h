@@ -0,0 +1,78 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SQLSTATEMENT_H
+#define SQLSTATEMENT_H
+
+#include <QByteArray>
+#include <QString>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+/* A prepared statement straight on the connection's sqlite3 handle (see
+ * DB::getSQLiteHandle), for the paths that move a lot of rows. Values are
+ * bound and read as plain types, there is no QVariant or QSqlRecord between
+ * the row and the caller. Parameters are positional (?) and count from 1,
+ * result columns count from 0, as in the sqlite3 API.
+ *
+ * The statement is finalized when this goes out of scope, which must be
+ * before the connection is closed, or the close fails.
+ */
+
+class SqlStatement
+{
+public:
+    SqlStatement() {}
+    ~SqlStatement();
+    SqlStatement(const SqlStatement&) = delete;
+    SqlStatement& operator=(const SqlStatement&) = delete;
+
+    bool prepare(sqlite3* handle, const QByteArray& sql);
+    void finalize();
+    bool isPrepared() const { return stmt != NULL; }
+
+    void bind(int param, qint64 value);
+    void bind(int param, int value);
+    void bind(int param, const QString& value); // A null QString binds NULL
+    void bind(int param, const QByteArray& value); // Blob, a null QByteArray binds NULL
+    void bindNull(int param);
+
+    bool exec(); // For statements with no result. Runs it and resets it for the next set of values
+    bool next(); // Steps to the next result row. False at the end, or on an error (see failed())
+    void reset();
+    bool failed() const { return lastFailed; }
+
+    qint64 int64(int column) const;
+    int integer(int column) const;
+    QString text(int column) const; // NULL reads as a null QString
+    QByteArray blob(int column) const;
+
+    void column(int c, qint64& value) const { value = int64(c); }
+    void column(int c, int& value) const { value = integer(c); }
+    void column(int c, QString& value) const { value = text(c); }
+    void column(int c, QByteArray& value) const { value = blob(c); }
+
+    qint64 lastInsertId() const;
+    QString errorText() const;
+
+private:
+    sqlite3_stmt* stmt = NULL;
+    bool lastFailed = false;
+};
+
+#endif // SQLSTATEMENT_H
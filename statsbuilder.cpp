@@ -0,0 +1,111 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <QDebug>
+
+#include "globals.h"
+#include "db.h"
+#include "dbpool.h"
+#include "dbwriter.h"
+#include "sqlstatement.h"
+
+#include "statsbuilder.h"
+
+StatsBuilder::StatsBuilder(const QVector<qint64>& t_diskIDs)
+    : diskIDs(t_diskIDs)
+{
+}
+
+void StatsBuilder::abort()
+{
+    abortNow = true;
+}
+
+void StatsBuilder::go()
+{
+    DB* sdb = DBPool::connection();
+    bool ok = (sdb != NULL) && (sdb->getSQLiteHandle() != NULL);
+
+    // A read-only database can't keep what is tallied, so those disks are summed here and added to the stored rows
+    QVector<qint64> storedIDs;
+    DiskStats unstored;
+    bool anyUnstored = false;
+
+    for (int i = 0; ok && !abortNow && (i < diskIDs.size()); i++)
+    {
+        if (DiskStats::isStored(sdb->getSQLiteHandle(), diskIDs[i]))
+        {
+            storedIDs.append(diskIDs[i]);
+        }
+        else if (DB::isReadOnly())
+        {
+            ok = tally(sdb, diskIDs[i], unstored);
+            anyUnstored = true;
+        }
+        else
+        {
+            DiskStats stats;
+            ok = tally(sdb, diskIDs[i], stats);
+            if (ok && !abortNow) ok = store(sdb, diskIDs[i], stats);
+            storedIDs.append(diskIDs[i]);
+        }
+    }
+
+    if (ok && !abortNow) ok = DiskStats::load(sdb->getSQLiteHandle(), storedIDs, rows);
+    if (ok && !abortNow && anyUnstored) unstored.addTo(rows);
+
+    emit finished(ok);
+}
+
+// The same walk the Cataloguer makes when it finishes a disk: its directories by the diskid index, each one's files by theirs
+bool StatsBuilder::tally(DB* sdb, qint64 diskID, DiskStats& stats)
+{
+    SqlStatement files;
+    if (!files.prepare(sdb->getSQLiteHandle(), "select f.name, f.type, f.size from directories d cross join files f on f.dirid = d.id "
+                                               "where d.diskid = ?")) return false;
+    files.bind(1, diskID);
+
+    qint64 numRead = 0;
+    while (files.next())
+    {
+        stats.addFile(files.text(0), files.integer(1), files.int64(2));
+        if ((++numRead % CHECK_ABORT_EVERY == 0) && abortNow) return true;
+    }
+    if (files.failed())
+    {
+        qDebug() << "StatsBuilder: files query failed:" << files.errorText();
+        return false;
+    }
+    return true;
+}
+
+bool StatsBuilder::store(DB* sdb, qint64 diskID, const DiskStats& stats)
+{
+    // Waits its turn with the Cataloguer's checkpoints and the GUI's edits, see DBWriter
+    dbWriter.beginBulk();
+    bool ok = sdb->startTransaction();
+    if (ok && !stats.store(sdb->getSQLiteHandle(), diskID))
+    {
+        qDebug() << "StatsBuilder: failed to store statistics for disk" << diskID;
+        sdb->rollbackTransaction();
+        ok = false;
+    }
+    if (ok) ok = sdb->commitTransaction();
+    dbWriter.endBulk();
+    return ok;
+}
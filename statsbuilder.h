@@ -0,0 +1,62 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef STATSBUILDER_H
+#define STATSBUILDER_H
+
+#include <QObject>
+#include <QVector>
+
+#include "diskstats.h"
+
+class DB;
+
+/* Fetches the combined breakdown of a set of disks for the properties dialog.
+ * Disks with no stored statistics are tallied first, each in one pass over its
+ * files, and stored so the next look is a lookup. A read-only database keeps
+ * nothing, so there they are tallied on every look.
+ */
+
+class StatsBuilder : public QObject
+{
+    Q_OBJECT
+
+public:
+    StatsBuilder(const QVector<qint64>& diskIDs);
+
+    void abort();
+    const QVector<DiskStatsRow>& getRows() const { return rows; } // Once finished
+
+public slots:
+    void go();
+
+signals:
+    void finished(bool ok);
+
+private:
+    bool tally(DB* sdb, qint64 diskID, DiskStats& stats); // Adds the disk's files to stats
+    bool store(DB* sdb, qint64 diskID, const DiskStats& stats);
+
+    QVector<qint64> diskIDs;
+    QVector<DiskStatsRow> rows;
+    bool abortNow = false;
+
+    const static int CHECK_ABORT_EVERY = 10000;
+};
+
+#endif // STATSBUILDER_H
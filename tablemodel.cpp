@@ -22,6 +22,8 @@
 #include <QFont>
 
 #include "globals.h"
+#include "catimage.h"
+#include "sqlstatement.h"
 
 #include "tablemodel.h"
 
@@ -49,7 +51,7 @@ void TableModel::loadCat(qint64 catID)
     cmodel = new QSqlTableModel();
     cmodel->setTable("disks");
     cmodel->setEditStrategy(QSqlTableModel::OnManualSubmit);
-    cmodel->setFilter(QString("catid = %1").arg(catID));
+    cmodel->setFilter(QString("catid = %1 and deleted = 0").arg(catID));
     cmodel->select();
 
     while(cmodel->canFetchMore()) cmodel->fetchMore();
@@ -66,26 +68,59 @@ void TableModel::loadDir(qint64 dirID)
 
     mode = MODE_DF;
 
-    dmodel = new QSqlTableModel();
-    dmodel->setTable("directories");
-    dmodel->setEditStrategy(QSqlTableModel::OnManualSubmit);
-    dmodel->setFilter(QString("parent = %1").arg(dirID));
-    dmodel->select();
+    image = CatImage::current();
+    if (image) imageDir = image->findDir(dirID);
+    if (imageDir >= 0)
+    {
+        numDirs = image->dirAt(imageDir).numChildren;
+        numFiles = image->dirAt(imageDir).numFiles;
+        endResetModel();
+        return;
+    }
+    image.clear();
 
-    while(dmodel->canFetchMore()) dmodel->fetchMore();
+    if (!loadDirRows(dirID))
+    {
+        qDebug() << "TableModel: failed to load directory" << dirID;
+        dirRows.clear();
+        fileRows.clear();
+    }
 
-    fmodel = new QSqlTableModel();
-    fmodel->setTable("files");
-    fmodel->setEditStrategy(QSqlTableModel::OnManualSubmit);
-    fmodel->setFilter(QString("dirid = %1").arg(dirID));
-    fmodel->select();
+    numDirs = dirRows.size();
+    numFiles = fileRows.size();
 
-    while(fmodel->canFetchMore()) fmodel->fetchMore();
+    endResetModel();
+}
 
-    numDirs = dmodel->rowCount();
-    numFiles = fmodel->rowCount();
+// Straight into typed rows, the view asks for every cell of a listing more than once.
+// Both come back in name order off the parent indexes, so the sorter starts from a sorted list
+bool TableModel::loadDirRows(qint64 dirID)
+{
+    SqlStatement query;
+    if (!query.prepare(db.getSQLiteHandle(), "select id, numitems, " + DBTable::columnList<DirectoriesTable>() +
+                                             " from directories where parent = ? order by name collate nocase")) return false;
+    query.bind(1, dirID);
+    while (query.next())
+    {
+        DirRecord dir;
+        dir.id = query.int64(0);
+        dir.numItems = query.int64(1);
+        DBTable::readRow<DirectoriesTable>(query, dir, 2);
+        dirRows.append(dir);
+    }
+    if (query.failed()) return false;
 
-    endResetModel();
+    if (!query.prepare(db.getSQLiteHandle(), "select id, " + DBTable::columnList<FilesTable>() +
+                                             " from files where dirid = ? order by name collate nocase")) return false;
+    query.bind(1, dirID);
+    while (query.next())
+    {
+        FileRecord file;
+        file.id = query.int64(0);
+        DBTable::readRow<FilesTable>(query, file, 1);
+        fileRows.append(file);
+    }
+    return !query.failed();
 }
 
 void TableModel::clear()
@@ -109,10 +144,12 @@ bool TableModel::reloadCat()
 void TableModel::clearData()
 {
     if (cmodel) delete cmodel;
-    if (dmodel) delete dmodel;
-    if (fmodel) delete fmodel;
+    cmodel = NULL;
 
-    cmodel = dmodel = fmodel = NULL;
+    dirRows.clear();
+    fileRows.clear();
+    image.clear();
+    imageDir = -1;
     numDisks = 0;
     numDirs = 0;
     numFiles = 0;
@@ -204,37 +241,35 @@ QVariant TableModel::data(const QModelIndex &index, int role) const
 
                 case ROLE_ID:
                 {
-                    QModelIndex newIndex = dmodel->index(index.row(), COL_DIRS_ID);
-                    return dmodel->data(newIndex, Qt::DisplayRole);
+                    return dirField(index.row(), COL_DIRS_ID);
                 }
 
 
                 case Qt::DisplayRole:
                 {
-                    QModelIndex newIndex = dmodel->index(index.row(), dirColumnConvert[indexCol]);
+                    QVariant qv = dirField(index.row(), dirColumnConvert[indexCol]);
                     switch(indexCol)
                     {
                         case 1:
                         {
-                            qint64 numItems = dmodel->data(newIndex, role).toLongLong();
+                            qint64 numItems = qv.toLongLong();
                             if (numItems == 1) return QString("%1 item").arg(numItems);
                             else return QString("%1 items").arg(numItems);
                         }
                         case 2:
                         {
-                            QVariant qv = dmodel->data(newIndex, role);
                             QDateTime qdt;
                             qdt.setSecsSinceEpoch(qv.toLongLong());
                             return qdt.toString(dateFormat);
                         }
                         case 5:
                         {
-                            return qPermissionsToText(dmodel->data(newIndex, role).toLongLong());
+                            return qPermissionsToText(qv.toLongLong());
                         }
                         case 0:
                         case 3:
                         case 4:
-                            return dmodel->data(newIndex, role);
+                            return qv;
                     }
                     [[fallthrough]]; // It won't. Placate the compiler.
                 }
@@ -244,8 +279,7 @@ QVariant TableModel::data(const QModelIndex &index, int role) const
 
                 case ROLE_RAW: // return raw data for sorting
                 {
-                    QModelIndex newIndex = dmodel->index(index.row(), dirColumnConvert[indexCol]);
-                    return dmodel->data(newIndex, Qt::DisplayRole);
+                    return dirField(index.row(), dirColumnConvert[indexCol]);
                 }
 
                 case Qt::TextAlignmentRole:
@@ -255,7 +289,7 @@ QVariant TableModel::data(const QModelIndex &index, int role) const
         }
         else // Asking for a file
         {
-            int type = fmodel->data(fmodel->index(index.row() - numDirs, COL_FILES_TYPE), Qt::DisplayRole).toInt();
+            int type = fileField(index.row() - numDirs, COL_FILES_TYPE).toInt();
 
             switch(role)
             {
@@ -266,14 +300,12 @@ QVariant TableModel::data(const QModelIndex &index, int role) const
 
             case ROLE_ID:
             {
-                QModelIndex newIndex = fmodel->index(index.row() - numDirs, COL_FILES_ID);
-                return fmodel->data(newIndex, Qt::DisplayRole);
+                return fileField(index.row() - numDirs, COL_FILES_ID);
             }
 
             case Qt::DisplayRole:
             {
-                QModelIndex newIndex = fmodel->index(index.row() - numDirs, fileColumnConvert[indexCol]);
-                QVariant qv = fmodel->data(newIndex, role);
+                QVariant qv = fileField(index.row() - numDirs, fileColumnConvert[indexCol]);
                 switch(indexCol)
                 {
                     case 1:
@@ -325,8 +357,7 @@ QVariant TableModel::data(const QModelIndex &index, int role) const
                 break;
 
             case ROLE_RAW: // return raw data for sorting
-                QModelIndex newIndex = fmodel->index(index.row() - numDirs, fileColumnConvert[indexCol]);
-                return fmodel->data(newIndex, Qt::DisplayRole);
+                return fileField(index.row() - numDirs, fileColumnConvert[indexCol]);
             }
         }
     }
@@ -335,9 +366,76 @@ QVariant TableModel::data(const QModelIndex &index, int role) const
 }
 
 
+QVariant TableModel::dirField(int row, int column) const
+{
+    if (!image)
+    {
+        const DirRecord& dir = dirRows.at(row);
+        switch(column)
+        {
+            case COL_DIRS_ID:       return dir.id;
+            case COL_DIRS_NUMITEMS: return dir.numItems;
+            case COL_DIRS_NAME:     return dir.name;
+            case COL_DIRS_MODTIME:  return dir.modTime;
+            case COL_DIRS_FOWNER:   return dir.owner;
+            case COL_DIRS_FGROUP:   return dir.group;
+            case COL_DIRS_QPERMS:   return dir.qPermissions;
+        }
+        return QVariant();
+    }
+
+    const CatImage::Dir& parent = image->dirAt(imageDir);
+    const CatImage::Dir& dir = image->dirAt(static_cast<int>(image->childAt(parent.firstChild + static_cast<quint32>(row))));
+    switch(column)
+    {
+        case COL_DIRS_ID:       return dir.id;
+        case COL_DIRS_NUMITEMS: return dir.numItems;
+        case COL_DIRS_NAME:     return image->string(dir.name);
+        case COL_DIRS_MODTIME:  return dir.modTime;
+        case COL_DIRS_FOWNER:   return image->string(dir.owner);
+        case COL_DIRS_FGROUP:   return image->string(dir.group);
+        case COL_DIRS_QPERMS:   return dir.qPermissions;
+    }
+    return QVariant();
+}
+
+QVariant TableModel::fileField(int row, int column) const
+{
+    if (!image)
+    {
+        const FileRecord& file = fileRows.at(row);
+        switch(column)
+        {
+            case COL_FILES_ID:      return file.id;
+            case COL_FILES_NAME:    return file.name;
+            case COL_FILES_SIZE:    return file.size;
+            case COL_FILES_TYPE:    return file.type;
+            case COL_FILES_MODTIME: return file.modTime;
+            case COL_FILES_FOWNER:  return file.owner;
+            case COL_FILES_FGROUP:  return file.group;
+            case COL_FILES_QPERMS:  return file.qPermissions;
+        }
+        return QVariant();
+    }
+
+    const CatImage::File& file = image->fileAt(image->dirAt(imageDir).firstFile + static_cast<quint32>(row));
+    switch(column)
+    {
+        case COL_FILES_ID:      return file.id;
+        case COL_FILES_NAME:    return image->string(file.name);
+        case COL_FILES_SIZE:    return file.size;
+        case COL_FILES_TYPE:    return file.type;
+        case COL_FILES_MODTIME: return file.modTime;
+        case COL_FILES_FOWNER:  return image->string(file.owner);
+        case COL_FILES_FGROUP:  return image->string(file.group);
+        case COL_FILES_QPERMS:  return file.qPermissions;
+    }
+    return QVariant();
+}
+
 Qt::ItemFlags TableModel::flags(const QModelIndex &index) const
 {
-    if (!index.isValid() || (mode != MODE_CAT)) return QAbstractItemModel::flags(index);
+    if (!index.isValid() || (mode != MODE_CAT) || DB::isReadOnly()) return QAbstractItemModel::flags(index);
     return QAbstractItemModel::flags(index) | Qt::ItemIsEditable;
 }
 
@@ -19,8 +19,13 @@
 #define TABLEMODEL_H
 
 #include <QAbstractTableModel>
+#include <QSharedPointer>
+#include <QVector>
+
+#include "dbtable.h"
 
 class QSqlTableModel;
+class CatImage;
 
 #define NUM_COLUMNS 6
 
@@ -54,8 +59,12 @@ signals:
 
 private:
     QSqlTableModel* cmodel = NULL;
-    QSqlTableModel* fmodel = NULL;
-    QSqlTableModel* dmodel = NULL;
+    QVector<DirRecord> dirRows;
+    QVector<FileRecord> fileRows;
+
+    // When a catalogue image is current, directory listings come from it instead of dirRows and fileRows
+    QSharedPointer<const CatImage> image;
+    int imageDir = -1;
 
     /* This model exposes columns:
      * 0 Name
@@ -99,6 +108,9 @@ private:
     const static QString dateFormat;
 
     void clearData();
+    bool loadDirRows(qint64 dirID);
+    QVariant dirField(int row, int column) const;
+    QVariant fileField(int row, int column) const;
 
 };
 
@@ -0,0 +1,267 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <QMetaObject>
+#include <QMutexLocker>
+
+#include "dbpool.h"
+#include "scanpriority.h"
+
+#include "taskscheduler.h"
+
+const int TaskScheduler::MAX_THREADS[NUM_LANES] = { 2, 3, 1, 2 };
+const QThread::Priority TaskScheduler::LANE_PRIORITY[NUM_LANES] = { QThread::NormalPriority, QThread::LowPriority, QThread::NormalPriority,
+                                                                    QThread::LowestPriority };
+
+class TaskScheduler::LaneThread : public QThread
+{
+public:
+    LaneThread(TaskScheduler* t_owner, Lane t_lane) : owner(t_owner), lane(t_lane) {}
+    Lane getLane() const { return lane; }
+
+protected:
+    void run() override { owner->runLane(this); }
+
+private:
+    TaskScheduler* owner;
+    Lane lane;
+};
+
+void TaskScheduler::Job::setProgress(int t_percent)
+{
+    owner->setProgress(id, t_percent);
+}
+
+TaskScheduler::TaskScheduler()
+{
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    shutdown();
+}
+
+quint64 TaskScheduler::submit(Lane lane, std::function<void(Job&)> work, const QString& title, QThread::Priority priority)
+{
+    Job* job = new Job();
+    job->lane = lane;
+    job->title = title;
+    job->work = work;
+    job->priority = priority;
+    job->cancellable = true; // The work function polls the token
+    return enqueue(job);
+}
+
+quint64 TaskScheduler::submitWorker(Lane lane, QObject* worker, const QString& title,
+                                    std::function<void()> onCancel, QThread::Priority priority)
+{
+    Job* job = new Job();
+    job->lane = lane;
+    job->title = title;
+    job->work = [worker] (Job&) { QMetaObject::invokeMethod(worker, "go", Qt::DirectConnection); };
+    job->onCancel = onCancel;
+    job->priority = priority;
+    job->cancellable = (onCancel != nullptr);
+    return enqueue(job);
+}
+
+quint64 TaskScheduler::enqueue(Job* job)
+{
+    QMutexLocker locker(&mutex);
+
+    if (stopping)
+    {
+        delete job;
+        return 0;
+    }
+
+    // Threads retired since the last submit have finished, or are about to
+    for (LaneThread* thread : retired)
+    {
+        thread->wait();
+        delete thread;
+    }
+    retired.clear();
+
+    job->owner = this;
+    job->id = nextID++;
+    quint64 id = job->id;
+    Lane lane = job->lane;
+    jobs.append(job);
+    queues[lane].append(job);
+
+    int numIdle = threads[lane].size() - numBusy[lane];
+    if ((queues[lane].size() > numIdle) && (threads[lane].size() < MAX_THREADS[lane])) startThread(lane);
+    else workAvailable[lane].wakeOne();
+
+    locker.unlock();
+    emit jobsChanged();
+    return id;
+}
+
+// Called with the mutex held
+void TaskScheduler::startThread(Lane lane)
+{
+    LaneThread* thread = new LaneThread(this, lane);
+    threads[lane].append(thread);
+    thread->start(LANE_PRIORITY[lane]);
+}
+
+void TaskScheduler::runLane(LaneThread* thread)
+{
+    Lane lane = thread->getLane();
+    QMutexLocker locker(&mutex);
+
+    while (true)
+    {
+        if (queues[lane].isEmpty())
+        {
+            if (stopping) return;
+
+            // Out of work for now, so let go of the database. The next job gets a fresh connection
+            locker.unlock();
+            DBPool::release();
+            locker.relock();
+
+            if (queues[lane].isEmpty() && !stopping) workAvailable[lane].wait(&mutex);
+            continue;
+        }
+
+        Job* job = queues[lane].takeFirst();
+        job->running = true;
+        ++numBusy[lane];
+        locker.unlock();
+        emit jobsChanged();
+
+        thread->setPriority((job->priority == QThread::InheritPriority) ? LANE_PRIORITY[lane] : job->priority);
+        job->work(*job);
+        thread->setPriority(LANE_PRIORITY[lane]);
+        bool retire = ScanPriority::isAppliedToThisThread();
+
+        locker.relock();
+        --numBusy[lane];
+        jobs.removeOne(job);
+        delete job;
+        jobDone.wakeAll();
+
+        if (retire)
+        {
+            // Its pooled connection is closed as the thread ends
+            threads[lane].removeOne(thread);
+            retired.append(thread);
+            if (!queues[lane].isEmpty() && !stopping) startThread(lane);
+        }
+
+        locker.unlock();
+        emit jobsChanged();
+        if (retire) return;
+        locker.relock();
+    }
+}
+
+void TaskScheduler::cancel(quint64 jobID)
+{
+    QMutexLocker locker(&mutex);
+    Job* job = findJob(jobID);
+    if (!job) return;
+    job->cancelled.store(1);
+    std::function<void()> onCancel = job->onCancel;
+    locker.unlock();
+
+    // Owners' abort()s are called in the GUI thread, as they always have been, so they
+    // can't race with the finished() handlers that delete the workers
+    if (onCancel) onCancel();
+}
+
+void TaskScheduler::setProgress(quint64 jobID, int percent)
+{
+    QMutexLocker locker(&mutex);
+    Job* job = findJob(jobID);
+    if (!job || (job->percent == percent)) return;
+    job->percent = percent;
+    locker.unlock();
+    emit jobsChanged();
+}
+
+// Blocks until the job has finished, or returns straight away if it already has. Used before
+// deleting a worker, whose go() may still be on its way out when its finished() signal arrives
+void TaskScheduler::wait(quint64 jobID)
+{
+    QMutexLocker locker(&mutex);
+    while (findJob(jobID)) jobDone.wait(&mutex);
+}
+
+QVector<TaskScheduler::JobInfo> TaskScheduler::getJobs() const
+{
+    QMutexLocker locker(&mutex);
+    QVector<JobInfo> infos;
+    for (Job* job : jobs)
+    {
+        JobInfo info;
+        info.id = job->id;
+        info.title = job->title;
+        info.percent = job->percent;
+        info.running = job->running;
+        info.cancellable = job->cancellable;
+        infos.append(info);
+    }
+    return infos;
+}
+
+TaskScheduler::Job* TaskScheduler::findJob(quint64 jobID) const
+{
+    for (Job* job : jobs)
+    {
+        if (job->id == jobID) return job;
+    }
+    return NULL;
+}
+
+// Called as the app closes. Jobs already running are waited for, anything still queued is dropped
+void TaskScheduler::shutdown()
+{
+    QMutexLocker locker(&mutex);
+    stopping = true;
+
+    for (int lane = 0; lane < NUM_LANES; lane++)
+    {
+        for (Job* job : queues[lane])
+        {
+            jobs.removeOne(job);
+            delete job;
+        }
+        queues[lane].clear();
+        workAvailable[lane].wakeAll();
+    }
+    jobDone.wakeAll();
+
+    QList<LaneThread*> all = retired;
+    retired.clear();
+    for (int lane = 0; lane < NUM_LANES; lane++)
+    {
+        all += threads[lane];
+        threads[lane].clear();
+    }
+    locker.unlock();
+
+    for (LaneThread* thread : all)
+    {
+        thread->wait();
+        delete thread;
+    }
+}
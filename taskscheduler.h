@@ -0,0 +1,142 @@
+/*
+ * This file is part of EZ Cat.
+ * Copyright (C) 2018 Chris Tallon
+ *
+ * This program is free software: You can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <functional>
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+/* Runs the app's background work on a few long lived threads, instead of a new
+ * QThread for every task. Work goes into a lane, each with its own threads, so
+ * however much bulk work is queued it can't hold up an interactive job, and
+ * unattended work can't take the threads a job the user started needs.
+ *
+ *   LANE_INTERACTIVE  short, and the user is waiting on it - tree listing
+ *   LANE_BULK         long running, started by the user - cataloguing, transfers,
+ *                     duplicate search, compaction, backups, image builds
+ *   LANE_WRITE        one thread, for DBWriter's batches of GUI edits
+ *   LANE_BACKGROUND   long running and unattended - reclaiming, snapshots
+ *
+ * Within a lane jobs start in the order submitted, on the first free thread.
+ * A lane thread gives up its pooled database connection whenever the lane runs
+ * out of work, so nothing is left holding the file open while it is closed or
+ * swapped. A thread that has had a ScanPriority applied is retired after the job,
+ * as an unprivileged process can't take the nice value back down.
+ *
+ * submitWorker() takes one of the existing QObject workers. Only its go() slot
+ * runs on the lane thread, the object stays with the thread that made it, so a
+ * worker must not depend on events or timers of its own. Its signals reach the
+ * GUI queued as before. Its owner deletes it when it has finished, after wait().
+ *
+ * Jobs with a title are listed in the status bar jobs panel. cancel() marks the
+ * job's token, which function jobs poll with Job::isCancelled(), and calls the
+ * onCancel given for a worker. A cancelled job is not taken off its queue, it
+ * still starts, sees it has been cancelled and finishes, so owners get their
+ * finished signals. Only shutdown() drops queued jobs, without running them.
+ */
+
+class TaskScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Lane { LANE_INTERACTIVE = 0, LANE_BULK = 1, LANE_WRITE = 2, LANE_BACKGROUND = 3 };
+    const static int NUM_LANES = 4;
+
+    class Job
+    {
+    public:
+        bool isCancelled() const { return cancelled.load() != 0; }
+        void setProgress(int percent);
+
+    private:
+        friend class TaskScheduler;
+        Job() {}
+
+        TaskScheduler* owner = NULL;
+        quint64 id = 0;
+        Lane lane = LANE_BULK;
+        QString title;
+        std::function<void(Job&)> work;
+        std::function<void()> onCancel;
+        QThread::Priority priority = QThread::InheritPriority;
+        QAtomicInt cancelled;
+        int percent = -1;
+        bool running = false;
+        bool cancellable = false;
+    };
+
+    struct JobInfo
+    {
+        quint64 id;
+        QString title;
+        int percent; // -1 if not known
+        bool running;
+        bool cancellable;
+    };
+
+    TaskScheduler();
+    ~TaskScheduler();
+
+    quint64 submit(Lane lane, std::function<void(Job&)> work, const QString& title = QString(),
+                   QThread::Priority priority = QThread::InheritPriority);
+    quint64 submitWorker(Lane lane, QObject* worker, const QString& title = QString(),
+                         std::function<void()> onCancel = nullptr, QThread::Priority priority = QThread::InheritPriority);
+    void cancel(quint64 jobID);
+    void setProgress(quint64 jobID, int percent);
+    void wait(quint64 jobID);
+    QVector<JobInfo> getJobs() const;
+    void shutdown();
+
+signals:
+    void jobsChanged();
+
+private:
+    class LaneThread;
+
+    quint64 enqueue(Job* job);
+    void startThread(Lane lane);
+    void runLane(LaneThread* thread);
+    Job* findJob(quint64 jobID) const;
+
+    mutable QMutex mutex;
+    QWaitCondition workAvailable[NUM_LANES];
+    QWaitCondition jobDone;
+    QList<Job*> queues[NUM_LANES];
+    QList<Job*> jobs;
+    QList<LaneThread*> threads[NUM_LANES];
+    QList<LaneThread*> retired;
+    int numBusy[NUM_LANES] = { 0, 0, 0, 0 };
+    quint64 nextID = 1;
+    bool stopping = false;
+
+    // The bulk lane has room for a catalogue or transfer next to a duplicate search
+    // or a backup. The open ended jobs (the reclaimer, a snapshot) have their own
+    const static int MAX_THREADS[NUM_LANES];
+    const static QThread::Priority LANE_PRIORITY[NUM_LANES];
+};
+
+#endif // TASKSCHEDULER_H
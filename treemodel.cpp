@@ -16,23 +16,34 @@
  */
 
 #include <QDebug>
-#include <QSqlQuery>
 #include <QSqlTableModel>
 
 #include "nodecatalogue.h"
 #include "nodedisk.h"
+#include "nodedir.h"
 #include "globals.h"
 #include "noderoot.h"
+#include "childloader.h"
+#include "catimage.h"
+#include "taskscheduler.h"
 
 #include "treemodel.h"
 
 TreeModel::TreeModel(QObject* parent, NodeRoot* _rootNode)
     : QAbstractItemModel(parent), rootNode(_rootNode)
 {
+    qRegisterMetaType<QVector<DirRow>>("QVector<DirRow>");
+
+    childLoader = new ChildLoader();
+
+    connect(childLoader, SIGNAL(loaded(quint64,QVector<DirRow>)), this, SLOT(childrenArrived(quint64,QVector<DirRow>)));
+    connect(childLoader, SIGNAL(loadFailed(quint64)), this, SLOT(childrenFailed(quint64)));
 }
 
 TreeModel::~TreeModel()
 {
+    for (quint64 jobID : loadJobs) scheduler.wait(jobID);
+    delete childLoader;
 }
 
 int TreeModel::rowCount(const QModelIndex& parent) const
@@ -71,11 +82,152 @@ QModelIndex TreeModel::parent(const QModelIndex &index) const
     return createIndex(parent->getSiblingIndex(), 0, parent);
 }
 
+// Answered without touching the database for disks and directories. Their
+// children are loaded in the background by fetchMore when the view expands them
 bool TreeModel::hasChildren(const QModelIndex& parent) const
 {
     Node* target = static_cast<Node*>(parent.internalPointer());
     if (!target) return rootNode->hasChildren();
-    else return target->hasChildren();
+    if (target->isChildrenLoaded()) return (target->numChildren() > 0);
+    return target->mayHaveChildren();
+}
+
+bool TreeModel::canFetchMore(const QModelIndex& parent) const
+{
+    Node* target = static_cast<Node*>(parent.internalPointer());
+    if (!target) return false;
+    return (!target->isChildrenLoaded() && !pendingByNode.contains(target));
+}
+
+void TreeModel::fetchMore(const QModelIndex& parent)
+{
+    Node* target = static_cast<Node*>(parent.internalPointer());
+    if (!target) return;
+    if (target->isChildrenLoaded() || pendingByNode.contains(target)) return;
+
+    qint64 parentDirID;
+    if (target->getType() == TYPE_DISK) parentDirID = static_cast<NodeDisk*>(target)->getRootDirID();
+    else if (target->getType() == TYPE_DIR) parentDirID = target->getID();
+    else
+    {
+        ensureChildrenLoaded(parent);
+        return;
+    }
+
+    // With a current catalogue image the children are an array slice, quicker than a trip to the loader
+    if (CatImage::current())
+    {
+        ensureChildrenLoaded(parent);
+        return;
+    }
+
+    quint64 token = nextToken++;
+    pendingFetches.insert(token, target);
+    pendingByNode.insert(target, token);
+
+    ChildLoader* loader = childLoader;
+    loadJobs.insert(token, scheduler.submit(TaskScheduler::LANE_INTERACTIVE,
+                                            [loader, token, parentDirID] (TaskScheduler::Job&) { loader->load(token, parentDirID); }));
+}
+
+void TreeModel::childrenArrived(quint64 token, QVector<DirRow> rows)
+{
+    loadJobs.remove(token);
+
+    // Not found if the node has since been removed, or was loaded synchronously
+    Node* target = pendingFetches.take(token);
+    if (!target) return;
+    pendingByNode.remove(target);
+    if (target->isChildrenLoaded()) return;
+
+    QModelIndex parentQmi = indexForNode(target);
+    if (rows.isEmpty())
+    {
+        target->addDirChildren(rows);
+        emit dataChanged(parentQmi, parentQmi); // Let the view drop the expander
+        return;
+    }
+
+    beginInsertRows(parentQmi, 0, rows.size() - 1);
+    target->addDirChildren(rows);
+    endInsertRows();
+}
+
+void TreeModel::childrenFailed(quint64 token)
+{
+    loadJobs.remove(token);
+    Node* target = pendingFetches.take(token);
+    if (!target) return;
+    pendingByNode.remove(target);
+
+    qDebug() << "TreeModel: background child load failed, loading synchronously";
+    ensureChildrenLoaded(indexForNode(target));
+}
+
+// For code that navigates the tree and needs a node's children right now
+void TreeModel::ensureChildrenLoaded(const QModelIndex& parent)
+{
+    Node* target = static_cast<Node*>(parent.internalPointer());
+    if (!target) target = rootNode;
+    if (target->isChildrenLoaded()) return;
+
+    quint64 token = pendingByNode.take(target);
+    if (token) pendingFetches.remove(token);
+
+    qint64 parentDirID;
+    if (target->getType() == TYPE_DISK) parentDirID = static_cast<NodeDisk*>(target)->getRootDirID();
+    else if (target->getType() == TYPE_DIR) parentDirID = target->getID();
+    else
+    {
+        // Root and catalogues load their children the first time the view sees them
+        target->hasChildren();
+        return;
+    }
+
+    QVector<DirRow> rows;
+    QSharedPointer<const CatImage> image = CatImage::current();
+    if (!image || !image->dirChildren(parentDirID, rows))
+    {
+        if (!NodeDir::queryChildren(db.getSQLiteHandle(), parentDirID, rows)) return;
+    }
+
+    if (rows.isEmpty())
+    {
+        target->addDirChildren(rows);
+        emit dataChanged(parent, parent); // Let the view drop the expander
+        return;
+    }
+
+    beginInsertRows(parent, 0, rows.size() - 1);
+    target->addDirChildren(rows);
+    endInsertRows();
+}
+
+QModelIndex TreeModel::indexForNode(Node* node) const
+{
+    if (node == rootNode) return QModelIndex();
+    return createIndex(static_cast<int>(node->getSiblingIndex()), 0, node);
+}
+
+// Forget outstanding background loads for a node and everything under it
+void TreeModel::dropPendingUnder(Node* node)
+{
+    QHash<quint64, Node*>::iterator it = pendingFetches.begin();
+    while (it != pendingFetches.end())
+    {
+        Node* walk = it.value();
+        while (walk && (walk != node)) walk = walk->getParent();
+
+        if (walk)
+        {
+            pendingByNode.remove(it.value());
+            it = pendingFetches.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
 }
 
 QVariant TreeModel::data(const QModelIndex &index, int role) const
@@ -83,6 +235,14 @@ QVariant TreeModel::data(const QModelIndex &index, int role) const
     Node* target = static_cast<Node*>(index.internalPointer());
 
     if (role == Qt::DisplayRole)
+    {
+        if ((target->getType() == TYPE_DISK) && static_cast<NodeDisk*>(target)->isPartial())
+            return target->getName() + " (partial)";
+        if ((target->getType() == TYPE_DISK) && static_cast<NodeDisk*>(target)->getUpdateID())
+            return target->getName() + " (update unfinished)";
+        return target->getName();
+    }
+    else if (role == Qt::EditRole)
     {
         return target->getName();
     }
@@ -116,7 +276,7 @@ Qt::ItemFlags TreeModel::flags(const QModelIndex &index) const
         return Qt::ItemIsEnabled;
 
     Node* t = static_cast<Node*>(index.internalPointer());
-    if ((t->getType() == TYPE_CAT) || (t->getType() == TYPE_DISK)) return QAbstractItemModel::flags(index) | Qt::ItemIsEditable;
+    if (!DB::isReadOnly() && ((t->getType() == TYPE_CAT) || (t->getType() == TYPE_DISK))) return QAbstractItemModel::flags(index) | Qt::ItemIsEditable;
     else return QAbstractItemModel::flags(index);
 }
 
@@ -128,6 +288,7 @@ bool TreeModel::setData(const QModelIndex &index, const QVariant &value, int rol
         if (target->rename(value.toString()))
         {
             emit dataChanged(index, index, {role});
+            placeByName(target);
             return true;
         }
     }
@@ -136,64 +297,126 @@ bool TreeModel::setData(const QModelIndex &index, const QVariant &value, int rol
 
 void TreeModel::addCatalogue(NodeCatalogue* newCat)
 {
-    beginInsertRows(QModelIndex(), rootNode->numChildren(), rootNode->numChildren());
-    rootNode->addChild(newCat);
+    qint64 newRow = rootNode->rowForName(newCat->getName());
+    beginInsertRows(QModelIndex(), newRow, newRow);
+    rootNode->insertChild(newCat, newRow);
     endInsertRows();
 }
 
-QModelIndex TreeModel::addDisk(NodeDisk* newDisk, std::function<void()> adder)
+QModelIndex TreeModel::addDisk(NodeDisk* newDisk)
 {
-    if (newDisk->getCatID() == 0)
+    QModelIndex parentQmi;
+    Node* addTo = rootNode;
+    if (newDisk->getCatID() != 0)
     {
-        qint64 newRow = rootNode->numChildren();
-        beginInsertRows(QModelIndex(), newRow, newRow);
-        adder();
-        endInsertRows();
-        return index(newRow, 0);
-    }
-    else
-    {
-        QModelIndex catQmi = getQmiForCatID(newDisk->getCatID());
-        Node* n = static_cast<Node*>(catQmi.internalPointer());
-        qint64 newRow = n->numChildren();
-        beginInsertRows(catQmi, newRow, newRow);
-        adder();
-        endInsertRows();
-        return index(newRow, 0, catQmi);
+        parentQmi = getQmiForCatID(newDisk->getCatID());
+        addTo = static_cast<Node*>(parentQmi.internalPointer());
     }
+
+    qint64 newRow = addTo->rowForName(newDisk->getName());
+    beginInsertRows(parentQmi, newRow, newRow);
+    addTo->insertChild(newDisk, newRow);
+    endInsertRows();
+    return index(newRow, 0, parentQmi);
+}
+
+// A renamed catalogue or disk moves to its new place among its siblings
+void TreeModel::placeByName(Node* node)
+{
+    Node* parentNode = node->getParent();
+    qint64 from = node->getSiblingIndex();
+    qint64 to = parentNode->rowForName(node->getName(), node);
+    if (from == to) return;
+
+    QModelIndex parentQmi = indexForNode(parentNode);
+    beginMoveRows(parentQmi, from, from, parentQmi, (to > from) ? to + 1 : to);
+    parentNode->moveChild(node, to);
+    endMoveRows();
 }
 
 void TreeModel::removeNode(QModelIndex& qmiToDel, std::function<void()> remover)
 {
     Node* toDel = static_cast<Node*>(qmiToDel.internalPointer());
+    dropPendingUnder(toDel);
     beginRemoveRows(qmiToDel.parent(), toDel->getSiblingIndex(), toDel->getSiblingIndex());
     remover();
     endRemoveRows();
 }
 
-QModelIndex TreeModel::getQmiForCatID(qint64 id)
+QModelIndex TreeModel::getQmiForCatID(qint64 id) const
+{
+    return indexFor(TYPE_CAT, id);
+}
+
+// Only finds nodes that have been loaded into the tree
+QModelIndex TreeModel::indexFor(qint64 type, qint64 id) const
 {
-    QModelIndexList matches = match(index(0, 0), ROLE_ID, id, -1, Qt::MatchExactly);
-    foreach(QModelIndex qmi, matches)
+    Node* n = Node::findNode(type, id);
+    if (!n) return QModelIndex();
+    return indexForNode(n);
+}
+
+// After an edit failed to be written, puts a catalogue or disk back the way the
+// database still has it. A delete that didn't happen brings the node back
+void TreeModel::revertNode(qint64 type, qint64 id)
+{
+    Node* node = Node::findNode(type, id);
+
+    if (type == TYPE_CAT)
     {
-        Node* n = static_cast<Node*>(qmi.internalPointer());
-        if (n->getType() == TYPE_CAT) return qmi;
+        NodeCatalogue* cat = static_cast<NodeCatalogue*>(node);
+        if (!cat)
+        {
+            cat = new NodeCatalogue(id, QString());
+            if (cat->reloadFromDB()) addCatalogue(cat);
+            else delete cat;
+            return;
+        }
+
+        if (!cat->reloadFromDB()) return;
+        QModelIndex qmi = indexForNode(cat);
+        emit dataChanged(qmi, qmi, {Qt::DisplayRole});
+        placeByName(cat);
+        return;
+    }
+
+    NodeDisk* disk = static_cast<NodeDisk*>(node);
+    if (!disk)
+    {
+        Node::eachDisk(QString("disks.id = %1 and disks.deleted = 0").arg(id), [&] (NodeDisk* found)
+        {
+            if ((found->getCatID() != 0) && !getQmiForCatID(found->getCatID()).isValid()) delete found; // Its catalogue is gone too
+            else addDisk(found);
+        });
+        return;
     }
-    return QModelIndex();
+
+    qint64 oldCatID = disk->getCatID();
+    if (!disk->reloadFromDB()) return;
+
+    QModelIndex qmi = indexForNode(disk);
+    if ((disk->getCatID() != oldCatID) && ((disk->getCatID() == 0) || getQmiForCatID(disk->getCatID()).isValid()))
+    {
+        removeNode(qmi, [&] { disk->getParent()->removeChild(disk); });
+        addDisk(disk);
+        return;
+    }
+
+    emit dataChanged(qmi, qmi, {Qt::DisplayRole});
+    placeByName(disk);
 }
 
-bool TreeModel::renameDisk(const QModelIndex& parentCatIndex, qint64 diskID, const QString& newName)
+bool TreeModel::renameDisk(qint64 diskID, const QString& newName)
 {
-    QModelIndexList matches = match(index(0, 0, parentCatIndex), ROLE_ID, diskID, -1, Qt::MatchExactly);
-    Q_ASSERT(matches.size() == 1);
-    QModelIndex diskIndex = matches[0];
-    Q_ASSERT(data(diskIndex, ROLE_TYPE) == TYPE_DISK);
+    QModelIndex diskIndex = indexFor(TYPE_DISK, diskID);
+    Q_ASSERT(diskIndex.isValid());
 
     Node* node = static_cast<Node*>(diskIndex.internalPointer());
     NodeDisk* disk = static_cast<NodeDisk*>(node);
     if (disk->rename(newName))
     {
         emit dataChanged(diskIndex, diskIndex, {Qt::DisplayRole});
+        placeByName(disk);
         return true;
     }
     return false;
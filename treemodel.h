@@ -20,11 +20,16 @@
 
 #include <functional>
 #include <QAbstractItemModel>
+#include <QHash>
+#include <QVector>
+
+#include "nodedir.h"
 
 class Node;
 class NodeRoot;
 class NodeCatalogue;
 class NodeDisk;
+class ChildLoader;
 
 class TreeModel : public QAbstractItemModel
 {
@@ -40,18 +45,36 @@ public:
     QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
     QModelIndex parent(const QModelIndex &index) const override;
     bool hasChildren(const QModelIndex &parent) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
     Qt::ItemFlags flags(const QModelIndex &index) const override;
     bool setData(const QModelIndex &index, const QVariant &value, int role) override;
 
     void addCatalogue(NodeCatalogue* newCat);
-    QModelIndex addDisk(NodeDisk* newDisk, std::function<void()> adder);
+    QModelIndex addDisk(NodeDisk* newDisk);
     void removeNode(QModelIndex &qmiToDel, std::function<void()> remover);
-    QModelIndex getQmiForCatID(qint64 id);
+    QModelIndex getQmiForCatID(qint64 id) const;
+    QModelIndex indexFor(qint64 type, qint64 id) const;
+    void ensureChildrenLoaded(const QModelIndex& parent);
+
+    bool renameDisk(qint64 diskID, const QString &newName);
+    void revertNode(qint64 type, qint64 id);
 
-    bool renameDisk(const QModelIndex &parentCatIndex, qint64 diskID, const QString &newName);
+private slots:
+    void childrenArrived(quint64 token, QVector<DirRow> rows);
+    void childrenFailed(quint64 token);
 
 private:
     NodeRoot* rootNode;
+    QModelIndex indexForNode(Node* node) const;
+    void dropPendingUnder(Node* node);
+    void placeByName(Node* node);
+
+    ChildLoader* childLoader;
+    quint64 nextToken = 1;
+    QHash<quint64, Node*> pendingFetches;
+    QHash<Node*, quint64> pendingByNode;
+    QHash<quint64, quint64> loadJobs; // token to scheduler job, until the answer is in
 };
 
 #endif // TREEMODEL_H